@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// access_pattern.c
+
+#include <string.h>
+#include "access_pattern.h"
+
+// share of the transitions a pattern needs to be called dominant
+static const double DOMINANT_SHARE = 0.6;
+
+//*****************************************************************************
+
+void access_pattern_add(struct access_pattern* pattern,
+                        struct access_stream* stream,
+                        long long offset, size_t bytes)
+{
+   const long long end = offset + (long long) bytes;
+
+   pattern->requests++;
+   histogram_add(&pattern->request_bytes, bytes);
+
+   if (!stream->active) {
+      stream->active = 1;
+      stream->gap = 0;
+      stream->run_bytes = bytes;
+   } else if (offset == stream->end) {
+      pattern->sequential++;
+      stream->gap = 0;
+      stream->run_bytes += bytes;
+   } else {
+      const long long gap = offset - stream->end;
+
+      if (end == stream->offset) {
+         pattern->reverse++;
+      } else if (gap == stream->gap) {
+         pattern->strided++;
+      } else {
+         pattern->random++;
+      }
+      stream->gap = gap;
+      histogram_add(&pattern->run_bytes, stream->run_bytes);
+      stream->run_bytes = bytes;
+   }
+
+   stream->offset = offset;
+   stream->end = end;
+}
+
+//*****************************************************************************
+
+void access_pattern_end(struct access_pattern* pattern,
+                        struct access_stream* stream)
+{
+   if (stream->active) {
+      histogram_add(&pattern->run_bytes, stream->run_bytes);
+   }
+   memset(stream, 0, sizeof(*stream));
+}
+
+//*****************************************************************************
+
+const char* access_pattern_label(const struct access_pattern* pattern)
+{
+   const unsigned long long transitions = pattern->sequential + pattern->reverse +
+                                          pattern->strided + pattern->random;
+
+   if (transitions == 0) {
+      return "single";
+   }
+   if (pattern->sequential >= DOMINANT_SHARE * transitions) {
+      return "sequential";
+   }
+   if (pattern->reverse >= DOMINANT_SHARE * transitions) {
+      return "reverse";
+   }
+   if (pattern->strided >= DOMINANT_SHARE * transitions) {
+      return "strided";
+   }
+   return "random";
+}
+
+//*****************************************************************************
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __ACCESS_PATTERN_H
+#define __ACCESS_PATTERN_H
+#include <stddef.h>
+#include "histogram.h"
+
+// streaming classification of the requests of a file by their offsets.
+// each request (after the first) of an fd is compared to the previous
+// one of the same fd and direction:
+//   sequential - starts where the previous one ended
+//   reverse    - ends where the previous one started
+//   strided    - same gap to the previous one as that one had
+//   random     - anything else
+
+struct access_pattern {
+   unsigned long long requests;
+   unsigned long long sequential;
+   unsigned long long reverse;
+   unsigned long long strided;
+   unsigned long long random;
+   struct histogram request_bytes;
+   struct histogram run_bytes;       // lengths of sequential runs
+};
+
+// position of one fd in one direction (read or write)
+struct access_stream {
+   int active;
+   long long offset;
+   long long end;
+   long long gap;
+   long long run_bytes;
+};
+
+void access_pattern_add(struct access_pattern* pattern,
+                        struct access_stream* stream,
+                        long long offset, size_t bytes);
+
+// end of a session (close of the fd): closes the current run
+void access_pattern_end(struct access_pattern* pattern,
+                        struct access_stream* stream);
+
+// dominant pattern: "sequential", "reverse", "strided", "random", or
+// "single" for files accessed by one request per session
+const char* access_pattern_label(const struct access_pattern* pattern);
+
+#endif //__ACCESS_PATTERN_H
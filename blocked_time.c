@@ -0,0 +1,297 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// blocked_time.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "domains_names.h"
+#include "ops.h"
+#include "htable.h"
+#include "blocked_time.h"
+
+static const int TOP_THREADS = 30;
+static const int TOP_DOMAINS = 3;
+
+struct blocked {
+   double domain_ms[END_DOMAINS];
+   double blocked_ms;
+   double elapsed_ms;
+   unsigned long long calls;
+};
+
+struct thread_blocked {
+   int pid;
+   int tid;
+   char name[16];
+   struct blocked total;
+   double peak_share;           // highest share of a single period
+};
+
+struct process_blocked {
+   int pid;
+   char command[40];
+   int threads;
+   int stopped;                 // total is from the STOP record
+   struct blocked total;
+};
+
+static FILE* report_output = NULL;
+static struct htable threads;     // (pid, tid) -> struct thread_blocked*
+static struct htable processes;   // pid -> struct process_blocked*
+
+//*****************************************************************************
+
+void blocked_time_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&threads);
+   htable_init(&processes);
+}
+
+//*****************************************************************************
+
+// "FILE_READ=12.500 SYNCS=3.250" and "blocked=15.750 elapsed=100.000 calls=42"
+static void parse_blocked(const struct monitor_record_t* r, struct blocked* b)
+{
+   char s1[PATH_MAX];
+   char* save = NULL;
+   char* token;
+   char* value;
+   int d;
+
+   memset(b, 0, sizeof(struct blocked));
+   snprintf(s1, sizeof(s1), "%s", r->s1);
+   for (token = strtok_r(s1, " ", &save); token != NULL; token = strtok_r(NULL, " ", &save)) {
+      value = strchr(token, '=');
+      if (value == NULL) {
+         continue;
+      }
+      *value++ = '\0';
+      for (d = 0; d < END_DOMAINS; ++d) {
+         if (!strcmp(token, domains_names[d])) {
+            b->domain_ms[d] = atof(value);
+            break;
+         }
+      }
+   }
+   sscanf(r->s2, "blocked=%lf elapsed=%lf calls=%llu", &b->blocked_ms, &b->elapsed_ms,
+          &b->calls);
+}
+
+//*****************************************************************************
+
+static void add_blocked(struct blocked* into, const struct blocked* from)
+{
+   int d;
+
+   for (d = 0; d < END_DOMAINS; ++d) {
+      into->domain_ms[d] += from->domain_ms[d];
+   }
+   into->blocked_ms += from->blocked_ms;
+   into->elapsed_ms += from->elapsed_ms;
+   into->calls += from->calls;
+}
+
+//*****************************************************************************
+
+static struct process_blocked* get_process(const struct process_info* process, int pid)
+{
+   struct process_blocked* p = htable_get_int(&processes, pid);
+
+   if (p == NULL) {
+      p = calloc(1, sizeof(struct process_blocked));
+      p->pid = pid;
+      htable_put_int(&processes, pid, p);
+   }
+   if (p->command[0] == '\0' && process != NULL && process->cmdline != NULL) {
+      snprintf(p->command, sizeof(p->command), "%s", process->cmdline);
+   }
+   return p;
+}
+
+//*****************************************************************************
+
+void blocked_time_record(const struct process_info* process,
+                         const struct monitor_record_t* r)
+{
+   const long key = ((long) r->pid << 32) | (unsigned int) r->tid;
+   struct thread_blocked* thread;
+   struct process_blocked* p;
+   struct blocked b;
+   const char* name;
+
+   if (report_output == NULL || r->dom_type != START_STOP) {
+      return;
+   }
+
+   if (r->op_type == BLOCKED) {
+      parse_blocked(r, &b);
+      thread = htable_get_int(&threads, key);
+      if (thread == NULL) {
+         thread = calloc(1, sizeof(struct thread_blocked));
+         thread->pid = r->pid;
+         thread->tid = r->tid;
+         htable_put_int(&threads, key, thread);
+         get_process(process, r->pid)->threads++;
+      }
+      name = process_thread_name(process, r->tid);
+      if (name != NULL) {
+         snprintf(thread->name, sizeof(thread->name), "%s", name);
+      }
+      add_blocked(&thread->total, &b);
+      if (b.elapsed_ms > 0.0 && b.blocked_ms / b.elapsed_ms > thread->peak_share) {
+         thread->peak_share = b.blocked_ms / b.elapsed_ms;
+      }
+      p = get_process(process, r->pid);
+      if (!p->stopped) {
+         // until STOP, the process is the sum of its threads' periods
+         add_blocked(&p->total, &b);
+         p->total.elapsed_ms = process != NULL ? process_lifetime_ms(process) : 0.0;
+      }
+   } else if (r->op_type == STOP && r->s2[0] != '\0') {
+      p = get_process(process, r->pid);
+      parse_blocked(r, &p->total);
+      sscanf(strstr(r->s2, "threads=") ? strstr(r->s2, "threads=") : "", "threads=%d",
+             &p->threads);
+      p->stopped = 1;
+   }
+}
+
+//*****************************************************************************
+
+// the domains with the most blocked time, with their share of it
+static void format_top_domains(const struct blocked* b, char* out, size_t out_len)
+{
+   int used[END_DOMAINS] = { 0 };
+   size_t len = 0;
+   int best;
+   int d;
+   int i;
+
+   out[0] = '\0';
+   for (i = 0; i < TOP_DOMAINS; ++i) {
+      best = -1;
+      for (d = 0; d < END_DOMAINS; ++d) {
+         if (!used[d] && b->domain_ms[d] > 0.0 &&
+             (best < 0 || b->domain_ms[d] > b->domain_ms[best])) {
+            best = d;
+         }
+      }
+      if (best < 0 || b->blocked_ms <= 0.0) {
+         break;
+      }
+      used[best] = 1;
+      len += snprintf(out + len, len < out_len ? out_len - len : 0, "%s%s %.0f%%",
+                      i ? ", " : "", domains_names[best],
+                      100.0 * b->domain_ms[best] / b->blocked_ms);
+   }
+}
+
+//*****************************************************************************
+
+static void collect_value(const void* key, size_t key_len, void* value, void* ctx)
+{
+   void*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static double share(const struct blocked* b)
+{
+   return b->elapsed_ms > 0.0 ? b->blocked_ms / b->elapsed_ms : 0.0;
+}
+
+static int compare_threads(const void* a, const void* b)
+{
+   const double sa = share(&(*(struct thread_blocked* const*) a)->total);
+   const double sb = share(&(*(struct thread_blocked* const*) b)->total);
+
+   return (sa < sb) - (sa > sb);
+}
+
+static int compare_processes(const void* a, const void* b)
+{
+   const double ba = (*(struct process_blocked* const*) a)->total.blocked_ms;
+   const double bb = (*(struct process_blocked* const*) b)->total.blocked_ms;
+
+   return (ba < bb) - (ba > bb);
+}
+
+//*****************************************************************************
+
+void blocked_time_report()
+{
+   struct process_blocked** process_list;
+   struct thread_blocked** thread_list;
+   void** cursor;
+   char domains[128];
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   process_list = malloc((processes.count + 1) * sizeof(struct process_blocked*));
+   cursor = (void**) process_list;
+   htable_foreach(&processes, collect_value, &cursor);
+   qsort(process_list, processes.count, sizeof(struct process_blocked*), compare_processes);
+
+   thread_list = malloc((threads.count + 1) * sizeof(struct thread_blocked*));
+   cursor = (void**) thread_list;
+   htable_foreach(&threads, collect_value, &cursor);
+   qsort(thread_list, threads.count, sizeof(struct thread_blocked*), compare_threads);
+
+   // for a process, blocked / elapsed is the mean number of its threads
+   // inside intercepted calls
+   fprintf(report_output, "\n===== blocked in I/O by process\n");
+   fprintf(report_output, "  %7s %11s %11s %8s %8s %10s  %-40s %s\n",
+           "PID", "ELAPSED(s)", "BLOCKED(s)", "THREADS", "AVG BLKD", "CALLS",
+           "TOP DOMAINS", "COMMAND");
+   for (i = 0; i < processes.count; ++i) {
+      const struct process_blocked* p = process_list[i];
+      format_top_domains(&p->total, domains, sizeof(domains));
+      fprintf(report_output, "  %7d %11.3f %11.3f %8d %8.2f %10llu  %-40s %s%s\n",
+              p->pid, p->total.elapsed_ms / 1000.0, p->total.blocked_ms / 1000.0,
+              p->threads, share(&p->total), p->total.calls, domains, p->command,
+              p->stopped ? "" : " (running)");
+   }
+
+   fprintf(report_output, "\n===== blocked in I/O: top %d threads by share of elapsed time\n",
+           TOP_THREADS);
+   fprintf(report_output, "  %7s %7s %-15s %11s %11s %8s %8s %10s  %s\n",
+           "PID", "TID", "NAME", "ELAPSED(s)", "BLOCKED(s)", "BLOCKED%", "PEAK%", "CALLS",
+           "TOP DOMAINS");
+   for (i = 0; i < threads.count && i < (size_t) TOP_THREADS; ++i) {
+      const struct thread_blocked* t = thread_list[i];
+      format_top_domains(&t->total, domains, sizeof(domains));
+      fprintf(report_output, "  %7d %7d %-15s %11.3f %11.3f %8.1f %8.1f %10llu  %s\n",
+              t->pid, t->tid, t->name[0] ? t->name : "-", t->total.elapsed_ms / 1000.0,
+              t->total.blocked_ms / 1000.0, 100.0 * share(&t->total),
+              100.0 * t->peak_share, t->total.calls, domains);
+   }
+   fflush(report_output);
+
+   free(process_list);
+   free(thread_list);
+   htable_destroy(&threads, free);
+   htable_destroy(&processes, free);
+}
+
+//*****************************************************************************
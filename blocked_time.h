@@ -0,0 +1,32 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __BLOCKED_TIME_H
+#define __BLOCKED_TIME_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// share of wall time that threads and processes spent inside intercepted
+// calls, per domain, from the BLOCKED records the shim sends for each
+// thread and the totals it sends with STOP.
+
+void blocked_time_init(FILE* output);
+void blocked_time_record(const struct process_info* process,
+                         const struct monitor_record_t* monitor_record);
+void blocked_time_report();
+
+#endif //__BLOCKED_TIME_H
@@ -0,0 +1,323 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// cache_residency.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "histogram.h"
+#include "residency.h"
+#include "cache_residency.h"
+
+static const time_t PROBE_INTERVAL_SECS = 10;
+// files probed by the listener per interval, the most read first
+static const size_t HOT_FILES = 8;
+// larger files are not probed by the listener (same limit as the shim)
+static const long long PROBE_MAX_BYTES = 1024LL * 1024 * 1024;
+// reads slower than this are counted as page cache misses
+static const double SLOW_READ_USEC = 100.0;
+// files mostly not resident with this share of slow reads want warming
+static const double WARM_MAX_RESIDENT = 0.5;
+static const double WARM_MIN_SLOW = 0.2;
+
+static const int TOP_FILES = 20;
+
+struct file_residency {
+   char* path;
+   long long size;
+   int regular;                     // opened as a regular file (size reported)
+   // probes by the shim at open
+   unsigned long long open_probes;
+   double open_resident_sum;        // sum of the resident shares
+   double open_resident_min;
+   // probes by the listener
+   unsigned long long live_probes;
+   double live_resident;            // latest resident share
+   double live_resident_min;
+   // reads
+   unsigned long long bytes_read;
+   unsigned long long interval_bytes_read;
+   unsigned long long slow_reads;
+   struct histogram read_usec;
+};
+
+static FILE* report_output = NULL;
+static struct htable files;   // path -> struct file_residency*
+static time_t last_probe = 0;
+
+//*****************************************************************************
+
+void cache_residency_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&files);
+}
+
+//*****************************************************************************
+
+static struct file_residency* get_file(const char* path)
+{
+   struct file_residency* file = htable_get_str(&files, path);
+
+   if (file == NULL) {
+      file = calloc(1, sizeof(struct file_residency));
+      file->path = strdup(path);
+      file->size = -1;
+      htable_put_str(&files, path, file);
+   }
+   return file;
+}
+
+static void free_file(void* value)
+{
+   struct file_residency* file = value;
+
+   free(file->path);
+   free(file);
+}
+
+//*****************************************************************************
+
+void cache_residency_record(const struct process_info* process,
+                            const struct monitor_record_t* r)
+{
+   struct file_residency* file;
+   const char* path;
+   double resident;
+
+   if (report_output == NULL || r->error_code != 0 || r->fd < 0) {
+      return;
+   }
+
+   if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE) {
+      if (r->file_size < 0 || r->s1[0] != '/') {
+         return;
+      }
+      file = get_file(r->s1);
+      file->regular = 1;
+      file->size = r->file_size;
+      if (r->resident_bytes < 0 || r->file_size == 0) {
+         return;
+      }
+      resident = (double) r->resident_bytes / r->file_size;
+      if (file->open_probes == 0 || resident < file->open_resident_min) {
+         file->open_resident_min = resident;
+      }
+      file->open_probes++;
+      file->open_resident_sum += resident;
+   } else if (r->op_type == READ && r->dom_type == FILE_READ) {
+      path = record_path(process, r);
+      if (path == NULL || r->bytes_transferred == 0) {
+         return;
+      }
+      file = get_file(path);
+      file->bytes_read += r->bytes_transferred;
+      file->interval_bytes_read += r->bytes_transferred;
+      histogram_add(&file->read_usec, r->elapsed_time * 1000.0);
+      if (r->elapsed_time * 1000.0 > SLOW_READ_USEC) {
+         file->slow_reads++;
+      }
+   }
+}
+
+//*****************************************************************************
+
+// share of the file in the page cache, -1 if it cannot be probed. only
+// files the shim saw open as regular files are probed, and without blocking
+// in case the path has since been replaced by a fifo or a device.
+static double probe(struct file_residency* file)
+{
+   struct stat file_stat;
+   long long resident;
+   int fd;
+
+   if (!file->regular || file->path[0] != '/') {
+      return -1.0;
+   }
+   fd = open(file->path, O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY);
+   if (fd < 0) {
+      return -1.0;
+   }
+   if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+       file_stat.st_size == 0 || file_stat.st_size > PROBE_MAX_BYTES) {
+      close(fd);
+      return -1.0;
+   }
+   // mincore would show every page of a file we neither own nor may write
+   // as resident; such files stay unknown
+   if (file_stat.st_uid != geteuid() && geteuid() != 0 && access(file->path, W_OK) != 0) {
+      close(fd);
+      return -1.0;
+   }
+   resident = residency_bytes(fd, file_stat.st_size);
+   close(fd);
+   if (resident < 0) {
+      return -1.0;
+   }
+   file->size = file_stat.st_size;
+   return (double) resident / file_stat.st_size;
+}
+
+//*****************************************************************************
+
+static void collect_file(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct file_residency*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_interval(const void* a, const void* b)
+{
+   const struct file_residency* fa = *(struct file_residency* const*) a;
+   const struct file_residency* fb = *(struct file_residency* const*) b;
+
+   return (fa->interval_bytes_read < fb->interval_bytes_read) -
+          (fa->interval_bytes_read > fb->interval_bytes_read);
+}
+
+static int compare_total(const void* a, const void* b)
+{
+   const struct file_residency* fa = *(struct file_residency* const*) a;
+   const struct file_residency* fb = *(struct file_residency* const*) b;
+
+   return (fa->bytes_read < fb->bytes_read) - (fa->bytes_read > fb->bytes_read);
+}
+
+//*****************************************************************************
+
+void cache_residency_tick(time_t now)
+{
+   struct file_residency** list;
+   struct file_residency** end;
+   struct file_residency* file;
+   double resident;
+   size_t count;
+   size_t i;
+
+   if (report_output == NULL || now - last_probe < PROBE_INTERVAL_SECS) {
+      return;
+   }
+   last_probe = now;
+
+   list = malloc((files.count + 1) * sizeof(struct file_residency*));
+   end = list;
+   htable_foreach(&files, collect_file, &end);
+   count = end - list;
+   qsort(list, count, sizeof(struct file_residency*), compare_interval);
+
+   for (i = 0; i < count && i < HOT_FILES; ++i) {
+      file = list[i];
+      if (file->interval_bytes_read == 0) {
+         break;
+      }
+      resident = probe(file);
+      if (resident >= 0.0) {
+         if (file->live_probes == 0 || resident < file->live_resident_min) {
+            file->live_resident_min = resident;
+         }
+         file->live_probes++;
+         file->live_resident = resident;
+      }
+   }
+   for (i = 0; i < count; ++i) {
+      list[i]->interval_bytes_read = 0;
+   }
+   free(list);
+}
+
+//*****************************************************************************
+
+static void format_share(char* buf, size_t len, int have_value, double share)
+{
+   if (have_value) {
+      snprintf(buf, len, "%.1f", 100.0 * share);
+   } else {
+      snprintf(buf, len, "-");
+   }
+}
+
+//*****************************************************************************
+
+void cache_residency_report()
+{
+   struct file_residency** list;
+   struct file_residency** end;
+   char open_mean[16];
+   char open_min[16];
+   char live[16];
+   char live_min[16];
+   size_t count;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((files.count + 1) * sizeof(struct file_residency*));
+   end = list;
+   htable_foreach(&files, collect_file, &end);
+   count = end - list;
+   qsort(list, count, sizeof(struct file_residency*), compare_total);
+
+   fprintf(report_output, "\n===== page cache residency: top %d files by bytes read\n",
+           TOP_FILES);
+   fprintf(report_output, "  %12s %7s %7s %7s %7s %7s %9s %14s %9s %9s %6s %-8s  %s\n",
+           "SIZE", "PROBES", "OPEN%", "MIN%", "LIVE%", "MIN%", "READS", "READ(B)",
+           "P50(us)", "P99(us)", "SLOW%", "HINT", "FILE");
+   for (i = 0; i < count && i < (size_t) TOP_FILES; ++i) {
+      const struct file_residency* f = list[i];
+      const double slow = f->read_usec.count > 0 ?
+                          (double) f->slow_reads / f->read_usec.count : 0.0;
+      double resident = -1.0;
+
+      if (f->bytes_read == 0) {
+         break;
+      }
+      if (f->open_probes > 0) {
+         resident = f->open_resident_sum / f->open_probes;
+      } else if (f->live_probes > 0) {
+         resident = f->live_resident;
+      }
+      format_share(open_mean, sizeof(open_mean), f->open_probes > 0,
+                   f->open_probes > 0 ? f->open_resident_sum / f->open_probes : 0.0);
+      format_share(open_min, sizeof(open_min), f->open_probes > 0, f->open_resident_min);
+      format_share(live, sizeof(live), f->live_probes > 0, f->live_resident);
+      format_share(live_min, sizeof(live_min), f->live_probes > 0, f->live_resident_min);
+      fprintf(report_output,
+              "  %12lld %7llu %7s %7s %7s %7s %9llu %14llu %9.1f %9.1f %6.1f %-8s  %s\n",
+              f->size, f->open_probes + f->live_probes, open_mean, open_min, live, live_min,
+              f->read_usec.count, f->bytes_read,
+              histogram_percentile(&f->read_usec, 50.0),
+              histogram_percentile(&f->read_usec, 99.0), 100.0 * slow,
+              (resident >= 0.0 && resident < WARM_MAX_RESIDENT && slow >= WARM_MIN_SLOW) ?
+              "willneed" : "-", f->path);
+   }
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&files, free_file);
+}
+
+//*****************************************************************************
@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __CACHE_RESIDENCY_H
+#define __CACHE_RESIDENCY_H
+#include <stdio.h>
+#include <time.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// share of files in the page cache (mincore): as probed by the shim at
+// open (CACHE_PROBE) and by the listener itself, periodically, for the
+// files read most since the last probe. reported next to the latency of
+// the reads of each file.
+
+void cache_residency_init(FILE* output);
+void cache_residency_record(const struct process_info* process,
+                            const struct monitor_record_t* monitor_record);
+void cache_residency_tick(time_t now);
+void cache_residency_report();
+
+#endif //__CACHE_RESIDENCY_H
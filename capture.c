@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// capture.c
+
+#include <stddef.h>
+#include <string.h>
+#include "capture.h"
+
+#define CAPTURE_MAGIC "IOMCAP"
+#define CAPTURE_VERSION 5
+
+struct capture_header {
+   char magic[8];
+   unsigned int version;
+   unsigned int record_size;
+   unsigned int path_max;
+   unsigned int str_len;
+};
+
+// the record is stored in three parts: everything up to s1, the two
+// strings (length-prefixed), and everything after s2
+static const size_t HEAD_SIZE = offsetof(struct monitor_record_t, s1);
+static const size_t TAIL_OFFSET = offsetof(struct monitor_record_t, caller);
+
+//*****************************************************************************
+
+static void init_header(struct capture_header* header)
+{
+   memset(header, 0, sizeof(struct capture_header));
+   strcpy(header->magic, CAPTURE_MAGIC);
+   header->version = CAPTURE_VERSION;
+   header->record_size = sizeof(struct monitor_record_t);
+   header->path_max = PATH_MAX;
+   header->str_len = STR_LEN;
+}
+
+//*****************************************************************************
+
+FILE* capture_create(const char* path)
+{
+   struct capture_header header;
+   FILE* capture = fopen(path, "w");
+
+   if (capture == NULL) {
+      printf("error: unable to create capture file '%s'\n", path);
+      return NULL;
+   }
+
+   init_header(&header);
+   if (fwrite(&header, sizeof(header), 1, capture) != 1) {
+      printf("error: unable to write capture file '%s'\n", path);
+      fclose(capture);
+      return NULL;
+   }
+   return capture;
+}
+
+//*****************************************************************************
+
+static int write_string(FILE* capture, const char* s, size_t max_len)
+{
+   const unsigned short len = strnlen(s, max_len - 1);
+
+   return fwrite(&len, sizeof(len), 1, capture) == 1 &&
+          fwrite(s, 1, len, capture) == len;
+}
+
+//*****************************************************************************
+
+int capture_write(FILE* capture, const struct monitor_record_t* r)
+{
+   const char* record = (const char*) r;
+
+   if (fwrite(record, HEAD_SIZE, 1, capture) != 1 ||
+       !write_string(capture, r->s1, PATH_MAX) ||
+       !write_string(capture, r->s2, STR_LEN) ||
+       fwrite(record + TAIL_OFFSET, sizeof(struct monitor_record_t) - TAIL_OFFSET,
+              1, capture) != 1) {
+      return -1;
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+FILE* capture_open(const char* path)
+{
+   struct capture_header expected;
+   struct capture_header header;
+   FILE* capture = fopen(path, "r");
+
+   if (capture == NULL) {
+      printf("error: unable to open capture file '%s'\n", path);
+      return NULL;
+   }
+
+   init_header(&expected);
+   if (fread(&header, sizeof(header), 1, capture) != 1 ||
+       memcmp(header.magic, expected.magic, sizeof(header.magic))) {
+      printf("error: '%s' is not a capture file\n", path);
+      fclose(capture);
+      return NULL;
+   }
+   if (memcmp(&header, &expected, sizeof(header))) {
+      printf("error: capture file '%s' was written with a different record layout\n",
+             path);
+      fclose(capture);
+      return NULL;
+   }
+   return capture;
+}
+
+//*****************************************************************************
+
+static int read_string(FILE* capture, char* s, size_t max_len)
+{
+   unsigned short len;
+
+   if (fread(&len, sizeof(len), 1, capture) != 1 || len >= max_len ||
+       fread(s, 1, len, capture) != len) {
+      return 0;
+   }
+   s[len] = '\0';
+   return 1;
+}
+
+//*****************************************************************************
+
+int capture_read(FILE* capture, struct monitor_record_t* r)
+{
+   char* record = (char*) r;
+   size_t n;
+
+   memset(r, 0, sizeof(struct monitor_record_t));
+   n = fread(record, 1, HEAD_SIZE, capture);
+   if (n == 0 && feof(capture)) {
+      return 0;
+   }
+   if (n != HEAD_SIZE ||
+       !read_string(capture, r->s1, PATH_MAX) ||
+       !read_string(capture, r->s2, STR_LEN) ||
+       fread(record + TAIL_OFFSET, sizeof(struct monitor_record_t) - TAIL_OFFSET,
+             1, capture) != 1) {
+      return -1;
+   }
+   return 1;
+}
+
+//*****************************************************************************
@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __CAPTURE_H
+#define __CAPTURE_H
+#include <stdio.h>
+#include "monitor_record.h"
+
+// capture files hold the raw records received by the listener, for the
+// offline tools (cache simulation, replay, ...). records are stored in
+// host byte order as the fixed part of the record with s1 and s2 cut at
+// their terminating NUL, so a capture is only readable by tools built
+// from the same monitor_record.h on the same architecture; the header
+// records the layout to detect a mismatch.
+
+FILE* capture_create(const char* path);
+int capture_write(FILE* capture, const struct monitor_record_t* monitor_record);
+
+FILE* capture_open(const char* path);
+
+// 1 if a record was read, 0 at the end of the capture, -1 on error
+int capture_read(FILE* capture, struct monitor_record_t* monitor_record);
+
+#endif //__CAPTURE_H
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// container_report.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "domains_names.h"
+#include "htable.h"
+#include "container_report.h"
+
+struct domain_totals {
+   unsigned long long ops;
+   unsigned long long bytes;
+   unsigned long long errors;
+   double time_ms;
+};
+
+struct container_stats {
+   char id[CONTAINER_ID_LEN];
+   unsigned long mnt_ns;
+   unsigned long long processes;
+   struct domain_totals total;
+   struct domain_totals domains[END_DOMAINS];
+};
+
+static FILE* report_output = NULL;
+static struct htable containers;   // container id -> struct container_stats*
+
+//*****************************************************************************
+
+void container_report_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&containers);
+}
+
+//*****************************************************************************
+
+void container_report_record(const struct monitor_record_t* r)
+{
+   char id[CONTAINER_ID_LEN];
+   struct container_stats* stats;
+   struct domain_totals* domain;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   snprintf(id, sizeof(id), "%s", r->container_id[0] ? r->container_id : "[unknown]");
+   stats = htable_get_str(&containers, id);
+   if (stats == NULL) {
+      stats = calloc(1, sizeof(struct container_stats));
+      memcpy(stats->id, id, sizeof(id));
+      stats->mnt_ns = r->mnt_ns;
+      htable_put_str(&containers, id, stats);
+   }
+
+   if (r->op_type == START) {
+      stats->processes++;
+      return;
+   }
+   if (r->dom_type == START_STOP || r->dom_type < 0 || r->dom_type >= END_DOMAINS) {
+      return;
+   }
+
+   domain = &stats->domains[r->dom_type];
+   domain->ops++;
+   domain->bytes += r->bytes_transferred;
+   domain->time_ms += r->elapsed_time;
+   stats->total.ops++;
+   stats->total.bytes += r->bytes_transferred;
+   stats->total.time_ms += r->elapsed_time;
+   if (r->error_code != 0) {
+      domain->errors++;
+      stats->total.errors++;
+   }
+}
+
+//*****************************************************************************
+
+static void collect_container(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct container_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_containers(const void* a, const void* b)
+{
+   const struct container_stats* ca = *(struct container_stats* const*) a;
+   const struct container_stats* cb = *(struct container_stats* const*) b;
+
+   return (ca->total.time_ms < cb->total.time_ms) -
+          (ca->total.time_ms > cb->total.time_ms);
+}
+
+//*****************************************************************************
+
+void container_report_report()
+{
+   struct container_stats** list;
+   struct container_stats** cursor;
+   size_t i;
+   int d;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((containers.count + 1) * sizeof(struct container_stats*));
+   cursor = list;
+   htable_foreach(&containers, collect_container, &cursor);
+   qsort(list, containers.count, sizeof(struct container_stats*), compare_containers);
+
+   fprintf(report_output, "\n===== I/O by container\n");
+   fprintf(report_output, "  %-32s %12s %8s %10s %14s %12s %8s\n",
+           "CONTAINER", "MNT_NS", "STARTS", "OPS", "BYTES", "TIME(ms)", "ERRORS");
+   for (i = 0; i < containers.count; ++i) {
+      const struct container_stats* c = list[i];
+      fprintf(report_output, "  %-32s %12lu %8llu %10llu %14llu %12.3f %8llu\n",
+              c->id, c->mnt_ns, c->processes, c->total.ops, c->total.bytes,
+              c->total.time_ms, c->total.errors);
+      for (d = 0; d < END_DOMAINS; ++d) {
+         if (c->domains[d].ops == 0) {
+            continue;
+         }
+         fprintf(report_output, "    %-30s %12s %8s %10llu %14llu %12.3f %8llu\n",
+                 domains_names[d], "", "", c->domains[d].ops, c->domains[d].bytes,
+                 c->domains[d].time_ms, c->domains[d].errors);
+      }
+   }
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&containers, free);
+}
+
+//*****************************************************************************
@@ -0,0 +1,30 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __CONTAINER_REPORT_H
+#define __CONTAINER_REPORT_H
+#include <stdio.h>
+#include "monitor_record.h"
+
+// aggregates I/O per container/cgroup id tagged by the shim, with a
+// per-domain breakdown, for hosts where many containers report into
+// one collector.
+
+void container_report_init(FILE* output);
+void container_report_record(const struct monitor_record_t* monitor_record);
+void container_report_report();
+
+#endif //__CONTAINER_REPORT_H
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// cpu_split.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "domains_names.h"
+#include "ops.h"
+#include "ops_names.h"
+#include "htable.h"
+#include "cpu_split.h"
+
+// calls at least this slow are classified: off-CPU if less than
+// OFF_CPU_SHARE of their time was on CPU, on-CPU if at least ON_CPU_SHARE
+static const double SLOW_CALL_MS = 1.0;
+static const double OFF_CPU_SHARE = 0.2;
+static const double ON_CPU_SHARE = 0.8;
+
+static const int TOP_FILES = 20;
+
+struct cpu_stats {
+   char name[64];
+   unsigned long long calls;
+   double wall_ms;
+   double cpu_ms;
+   unsigned long long slow;
+   unsigned long long slow_off_cpu;
+   unsigned long long slow_on_cpu;
+   double slow_wall_ms;
+   double slow_cpu_ms;
+};
+
+static FILE* report_output = NULL;
+static struct cpu_stats op_stats[END_DOMAINS][END_OPS];
+static struct htable files;       // path -> struct cpu_stats*
+static unsigned long long unmeasured = 0;
+
+//*****************************************************************************
+
+void cpu_split_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&files);
+}
+
+//*****************************************************************************
+
+static void add_call(struct cpu_stats* stats, const struct monitor_record_t* r)
+{
+   const double cpu_ms = r->cpu_time < r->elapsed_time ? r->cpu_time : r->elapsed_time;
+
+   stats->calls++;
+   stats->wall_ms += r->elapsed_time;
+   stats->cpu_ms += cpu_ms;
+   if (r->elapsed_time >= SLOW_CALL_MS) {
+      stats->slow++;
+      stats->slow_wall_ms += r->elapsed_time;
+      stats->slow_cpu_ms += cpu_ms;
+      if (cpu_ms < OFF_CPU_SHARE * r->elapsed_time) {
+         stats->slow_off_cpu++;
+      } else if (cpu_ms >= ON_CPU_SHARE * r->elapsed_time) {
+         stats->slow_on_cpu++;
+      }
+   }
+}
+
+//*****************************************************************************
+
+void cpu_split_record(const struct process_info* process,
+                      const struct monitor_record_t* r)
+{
+   struct cpu_stats* stats;
+   const char* path;
+   size_t len;
+
+   if (report_output == NULL || r->dom_type == START_STOP ||
+       r->dom_type < 0 || r->dom_type >= END_DOMAINS ||
+       r->op_type < 0 || r->op_type >= END_OPS) {
+      return;
+   }
+   if (r->cpu_time < 0.0) {
+      unmeasured++;
+      return;
+   }
+
+   add_call(&op_stats[r->dom_type][r->op_type], r);
+
+   path = record_path(process, r);
+   if (path == NULL) {
+      return;
+   }
+   stats = htable_get_str(&files, path);
+   if (stats == NULL) {
+      stats = calloc(1, sizeof(struct cpu_stats));
+      // keep the end of long paths
+      len = strlen(path);
+      snprintf(stats->name, sizeof(stats->name), "%s",
+               len < sizeof(stats->name) ? path : path + len - (sizeof(stats->name) - 1));
+      htable_put_str(&files, path, stats);
+   }
+   add_call(stats, r);
+}
+
+//*****************************************************************************
+
+static void print_header(const char* title, const char* name)
+{
+   fprintf(report_output, "\n===== %s\n", title);
+   fprintf(report_output, "  %10s %12s %12s %6s %8s %8s %8s %9s  %s\n",
+           "CALLS", "WALL(ms)", "CPU(ms)", "CPU%", "SLOW", "OFF-CPU", "ON-CPU",
+           "SLOW CPU%", name);
+}
+
+static void print_stats(const struct cpu_stats* s, const char* name)
+{
+   fprintf(report_output, "  %10llu %12.3f %12.3f %6.1f %8llu %8llu %8llu %9.1f  %s\n",
+           s->calls, s->wall_ms, s->cpu_ms,
+           s->wall_ms > 0.0 ? 100.0 * s->cpu_ms / s->wall_ms : 0.0,
+           s->slow, s->slow_off_cpu, s->slow_on_cpu,
+           s->slow_wall_ms > 0.0 ? 100.0 * s->slow_cpu_ms / s->slow_wall_ms : 0.0, name);
+}
+
+//*****************************************************************************
+
+static void collect_file(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct cpu_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_wall(const void* a, const void* b)
+{
+   const struct cpu_stats* sa = *(struct cpu_stats* const*) a;
+   const struct cpu_stats* sb = *(struct cpu_stats* const*) b;
+
+   return (sa->wall_ms < sb->wall_ms) - (sa->wall_ms > sb->wall_ms);
+}
+
+//*****************************************************************************
+
+void cpu_split_report()
+{
+   struct cpu_stats* op_list[END_DOMAINS * END_OPS];
+   struct cpu_stats** file_list;
+   struct cpu_stats** end;
+   size_t num_ops = 0;
+   size_t i;
+   int d;
+   int o;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   for (d = 0; d < END_DOMAINS; ++d) {
+      for (o = 0; o < END_OPS; ++o) {
+         if (op_stats[d][o].calls > 0) {
+            snprintf(op_stats[d][o].name, sizeof(op_stats[d][o].name), "%s %s",
+                     domains_names[d], ops_names[o]);
+            op_list[num_ops++] = &op_stats[d][o];
+         }
+      }
+   }
+   qsort(op_list, num_ops, sizeof(struct cpu_stats*), compare_wall);
+
+   file_list = malloc((files.count + 1) * sizeof(struct cpu_stats*));
+   end = file_list;
+   htable_foreach(&files, collect_file, &end);
+   qsort(file_list, files.count, sizeof(struct cpu_stats*), compare_wall);
+
+   print_header("on-CPU vs off-CPU time by operation", "OPERATION");
+   for (i = 0; i < num_ops; ++i) {
+      print_stats(op_list[i], op_list[i]->name);
+   }
+   print_header("on-CPU vs off-CPU time: top files by wall time", "FILE");
+   for (i = 0; i < files.count && i < (size_t) TOP_FILES; ++i) {
+      print_stats(file_list[i], file_list[i]->name);
+   }
+   if (unmeasured > 0) {
+      fprintf(report_output, "\n  %llu calls without CPU time (CPU_TIME not set)\n", unmeasured);
+   }
+   fflush(report_output);
+
+   free(file_list);
+   htable_destroy(&files, free);
+}
+
+//*****************************************************************************
@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __CPU_SPLIT_H
+#define __CPU_SPLIT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// splits the time of intercepted calls into on-CPU time (CPU_TIME) and
+// off-CPU time, per operation and per file, so that slow calls waiting on
+// a device can be told from slow calls burning CPU (copies, checksums,
+// compression).
+
+void cpu_split_init(FILE* output);
+void cpu_split_record(const struct process_info* process,
+                      const struct monitor_record_t* monitor_record);
+void cpu_split_report();
+
+#endif //__CPU_SPLIT_H
@@ -0,0 +1,322 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// device_report.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysmacros.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "histogram.h"
+#include "mounts.h"
+#include "device_report.h"
+
+struct io_stats {
+   unsigned long long ops;
+   unsigned long long bytes;
+   double ms;
+   struct histogram usec;
+};
+
+struct fs_stats {
+   unsigned long dev;
+   long fs_type;                 // statfs magic from the shim
+   unsigned long long opens;
+   struct io_stats reads;
+   struct io_stats writes;
+   struct io_stats syncs;
+};
+
+// a device holding one or more filesystems
+struct device_stats {
+   const char* device;
+   struct io_stats reads;
+   struct io_stats writes;
+   struct io_stats syncs;
+   unsigned long long filesystems;
+};
+
+// names of common filesystem magics, for filesystems not in the mount table
+static const struct {
+   long magic;
+   const char* name;
+} fs_magics[] = {
+   { 0xEF53, "ext4" },
+   { 0x58465342, "xfs" },
+   { 0x9123683E, "btrfs" },
+   { 0x01021994, "tmpfs" },
+   { 0x6969, "nfs" },
+   { 0xFE534D42, "smb2" },
+   { 0xFF534D42, "cifs" },
+   { 0x65735546, "fuse" },
+   { 0x794C7630, "overlay" },
+   { 0x2FC12FC1, "zfs" },
+   { 0x9FA0, "proc" },
+   { 0x62656572, "sysfs" },
+   { 0, NULL }
+};
+
+static FILE* report_output = NULL;
+static struct htable filesystems;   // dev -> struct fs_stats*
+static struct htable fds;           // (pid, fd) -> struct fs_stats*
+
+//*****************************************************************************
+
+void device_report_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&filesystems);
+   htable_init(&fds);
+}
+
+//*****************************************************************************
+
+static long fd_key(const struct monitor_record_t* r)
+{
+   return ((long) r->pid << 32) | (unsigned int) r->fd;
+}
+
+//*****************************************************************************
+
+static void add_io(struct io_stats* stats, const struct monitor_record_t* r)
+{
+   stats->ops++;
+   stats->bytes += r->bytes_transferred;
+   stats->ms += r->elapsed_time;
+   histogram_add(&stats->usec, r->elapsed_time * 1000.0);
+}
+
+static void merge_io(struct io_stats* into, const struct io_stats* from)
+{
+   into->ops += from->ops;
+   into->bytes += from->bytes;
+   into->ms += from->ms;
+   histogram_merge(&into->usec, &from->usec);
+}
+
+//*****************************************************************************
+
+void device_report_record(const struct process_info* process,
+                          const struct monitor_record_t* r)
+{
+   struct fs_stats* fs;
+
+   if (report_output == NULL || r->fd < 0) {
+      return;
+   }
+
+   if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE) {
+      htable_remove_int(&fds, fd_key(r));
+      if (r->error_code != 0 || r->dev == 0) {
+         return;
+      }
+      fs = htable_get_int(&filesystems, r->dev);
+      if (fs == NULL) {
+         fs = calloc(1, sizeof(struct fs_stats));
+         fs->dev = r->dev;
+         htable_put_int(&filesystems, r->dev, fs);
+      }
+      if (r->fs_type != 0) {
+         fs->fs_type = r->fs_type;
+      }
+      fs->opens++;
+      htable_put_int(&fds, fd_key(r), fs);
+      return;
+   }
+
+   fs = htable_get_int(&fds, fd_key(r));
+   if (fs == NULL) {
+      return;
+   }
+   if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE) {
+      htable_remove_int(&fds, fd_key(r));
+   } else if (r->error_code != 0) {
+      return;
+   } else if (r->op_type == READ && r->dom_type == FILE_READ) {
+      add_io(&fs->reads, r);
+   } else if (r->op_type == WRITE && r->dom_type == FILE_WRITE) {
+      add_io(&fs->writes, r);
+   } else if (r->op_type == SYNC) {
+      add_io(&fs->syncs, r);
+   }
+}
+
+//*****************************************************************************
+
+static const char* magic_name(long magic, char* buf, size_t len)
+{
+   int i;
+
+   for (i = 0; fs_magics[i].name != NULL; ++i) {
+      if (fs_magics[i].magic == magic) {
+         return fs_magics[i].name;
+      }
+   }
+   if (magic == 0) {
+      return "-";
+   }
+   snprintf(buf, len, "0x%lx", (unsigned long) magic);
+   return buf;
+}
+
+//*****************************************************************************
+
+static void collect(const void* key, size_t key_len, void* value, void* ctx)
+{
+   void*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static double total_ms(const struct io_stats* reads, const struct io_stats* writes,
+                       const struct io_stats* syncs)
+{
+   return reads->ms + writes->ms + syncs->ms;
+}
+
+static int compare_filesystems(const void* a, const void* b)
+{
+   const struct fs_stats* fa = *(struct fs_stats* const*) a;
+   const struct fs_stats* fb = *(struct fs_stats* const*) b;
+   const double ta = total_ms(&fa->reads, &fa->writes, &fa->syncs);
+   const double tb = total_ms(&fb->reads, &fb->writes, &fb->syncs);
+
+   return (ta < tb) - (ta > tb);
+}
+
+static int compare_devices(const void* a, const void* b)
+{
+   const struct device_stats* da = *(struct device_stats* const*) a;
+   const struct device_stats* db = *(struct device_stats* const*) b;
+   const double ta = total_ms(&da->reads, &da->writes, &da->syncs);
+   const double tb = total_ms(&db->reads, &db->writes, &db->syncs);
+
+   return (ta < tb) - (ta > tb);
+}
+
+//*****************************************************************************
+
+// throughput while in calls, in MiB/s
+static double call_throughput(const struct io_stats* stats)
+{
+   return stats->ms > 0.0 ? stats->bytes / (1024.0 * 1024.0) / (stats->ms / 1000.0) : 0.0;
+}
+
+static void print_io(const struct io_stats* stats)
+{
+   fprintf(report_output, " %9llu %14llu %8.1f %8.1f %9.1f", stats->ops, stats->bytes,
+           call_throughput(stats), histogram_percentile(&stats->usec, 50.0),
+           histogram_percentile(&stats->usec, 99.0));
+}
+
+static void print_header(const char* name, const char* last)
+{
+   fprintf(report_output, "  %-9s %9s %14s %8s %8s %9s %9s %14s %8s %8s %9s %7s %10s  %s\n",
+           name, "READS", "READ(B)", "MiB/s", "P50(us)", "P99(us)",
+           "WRITES", "WRITE(B)", "MiB/s", "P50(us)", "P99(us)", "SYNCS", "SYNC(ms)",
+           last);
+}
+
+//*****************************************************************************
+
+void device_report_report()
+{
+   struct fs_stats** list;
+   struct fs_stats** end;
+   struct device_stats** devices;
+   struct device_stats** devices_end;
+   struct htable by_device;   // source -> struct device_stats*
+   char dev_name[32];
+   char magic_buf[32];
+   size_t count;
+   size_t num_devices;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((filesystems.count + 1) * sizeof(struct fs_stats*));
+   end = list;
+   htable_foreach(&filesystems, collect, &end);
+   count = end - list;
+   qsort(list, count, sizeof(struct fs_stats*), compare_filesystems);
+
+   fprintf(report_output, "\n===== file I/O by filesystem (st_dev at open, STAT_ON_OPEN)\n");
+   print_header("DEV", "FS  MOUNT  SOURCE");
+   htable_init(&by_device);
+   for (i = 0; i < count; ++i) {
+      const struct fs_stats* fs = list[i];
+      const struct mount_info* mount = mounts_by_dev(fs->dev);
+      const char* source = mount != NULL ? mount->device : "-";
+      struct device_stats* device;
+
+      snprintf(dev_name, sizeof(dev_name), "%u:%u", major(fs->dev), minor(fs->dev));
+      fprintf(report_output, "  %-9s", dev_name);
+      print_io(&fs->reads);
+      print_io(&fs->writes);
+      fprintf(report_output, " %7llu %10.3f  %s  %s  %s\n", fs->syncs.ops, fs->syncs.ms,
+              mount != NULL ? mount->fs_type : magic_name(fs->fs_type, magic_buf,
+                                                          sizeof(magic_buf)),
+              mount != NULL ? mount->mount_point : "-", source);
+
+      // filesystems of unknown source are kept apart
+      if (mount == NULL) {
+         continue;
+      }
+      device = htable_get_str(&by_device, source);
+      if (device == NULL) {
+         device = calloc(1, sizeof(struct device_stats));
+         device->device = source;
+         htable_put_str(&by_device, source, device);
+      }
+      merge_io(&device->reads, &fs->reads);
+      merge_io(&device->writes, &fs->writes);
+      merge_io(&device->syncs, &fs->syncs);
+      device->filesystems++;
+   }
+
+   devices = malloc((by_device.count + 1) * sizeof(struct device_stats*));
+   devices_end = devices;
+   htable_foreach(&by_device, collect, &devices_end);
+   num_devices = devices_end - devices;
+   qsort(devices, num_devices, sizeof(struct device_stats*), compare_devices);
+
+   fprintf(report_output, "\n===== file I/O by device (mount source)\n");
+   print_header("FS", "SOURCE");
+   for (i = 0; i < num_devices; ++i) {
+      const struct device_stats* device = devices[i];
+
+      fprintf(report_output, "  %-9llu", device->filesystems);
+      print_io(&device->reads);
+      print_io(&device->writes);
+      fprintf(report_output, " %7llu %10.3f  %s\n", device->syncs.ops, device->syncs.ms,
+              device->device);
+   }
+   fflush(report_output);
+
+   free(devices);
+   free(list);
+   htable_destroy(&by_device, free);
+   htable_destroy(&fds, NULL);
+   htable_destroy(&filesystems, free);
+}
+
+//*****************************************************************************
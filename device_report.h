@@ -0,0 +1,32 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __DEVICE_REPORT_H
+#define __DEVICE_REPORT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// latency and throughput of file I/O per filesystem (st_dev recorded at
+// open, with STAT_ON_OPEN) and per device, named after the listener's
+// mount table.
+
+void device_report_init(FILE* output);
+void device_report_record(const struct process_info* process,
+                          const struct monitor_record_t* monitor_record);
+void device_report_report();
+
+#endif //__DEVICE_REPORT_H
@@ -0,0 +1,459 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// durability.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "histogram.h"
+#include "durability.h"
+
+// a sync that starts within this time after the end of the previous sync
+// of the same file could have been merged with it by a group commit
+static const long long GROUP_COMMIT_WINDOW_USEC = 1000;
+
+static const int TOP_FILES = 20;
+
+// sync latency is broken down by the bytes written since the last sync
+#define NUM_DIRTY_CLASSES 6
+static const long long dirty_class_bounds[NUM_DIRTY_CLASSES] = {
+   0, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, -1
+};
+static const char* dirty_class_names[NUM_DIRTY_CLASSES] = {
+   "0", "<= 4K", "<= 64K", "<= 1M", "<= 16M", "> 16M"
+};
+
+enum { MODE_NONE, MODE_DSYNC, MODE_SYNC };
+static const char* mode_names[] = { "-", "O_DSYNC", "O_SYNC" };
+
+struct file_stats {
+   int pid;
+   char target[RECORD_TARGET_LEN];   // path, or "[fd N]"
+   // syncs
+   unsigned long long syncs;
+   unsigned long long empty_syncs;   // nothing written since the last one
+   unsigned long long groupable;
+   double groupable_ms;
+   unsigned long long range_syncs;   // sync_file_range
+   struct histogram sync_usec;
+   struct histogram bytes_per_sync;
+   long long first_sync_usec;
+   long long last_sync_end_usec;
+   // writes since the last sync
+   long long dirty_bytes;
+   unsigned long long dirty_writes;
+   double dirty_end_sum_usec;
+   long long first_dirty_end_usec;
+   // write-to-durable: from the end of a write to the end of its sync
+   double w2d_sum_usec;
+   unsigned long long w2d_writes;
+   struct histogram w2d_max_usec;    // oldest write of each sync
+   // writes through O_SYNC/O_DSYNC fds
+   int mode;
+   unsigned long long sync_mode_writes;
+   unsigned long long sync_mode_bytes;
+   struct histogram sync_mode_usec;
+};
+
+struct process_stats {
+   int pid;
+   unsigned long long syncs;         // of files, including sync_file_range
+   unsigned long long global_syncs;  // sync, syncfs
+   double sync_ms;
+   long long current_second;
+   unsigned long long current_second_syncs;
+   unsigned long long peak_syncs_per_second;
+};
+
+static FILE* report_output = NULL;
+static struct htable files;       // (pid, target) -> struct file_stats*
+static struct htable processes;   // pid -> struct process_stats*
+static struct htable fd_modes;    // (pid, fd) -> MODE_SYNC/MODE_DSYNC
+static struct histogram sync_usec_by_dirty[NUM_DIRTY_CLASSES];
+
+//*****************************************************************************
+
+void durability_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&files);
+   htable_init(&processes);
+   htable_init(&fd_modes);
+}
+
+//*****************************************************************************
+
+static struct file_stats* get_file(const char* path, const struct monitor_record_t* r)
+{
+   char key[RECORD_TARGET_KEY_LEN];
+   struct file_stats* file;
+   const size_t key_len = record_target_key(r, path, key);
+
+   file = htable_get(&files, key, key_len);
+   if (file == NULL) {
+      file = calloc(1, sizeof(struct file_stats));
+      file->pid = r->pid;
+      memcpy(file->target, key + sizeof(int), key_len - sizeof(int));
+      htable_put(&files, key, key_len, file);
+   }
+   return file;
+}
+
+//*****************************************************************************
+
+static struct process_stats* get_process(int pid)
+{
+   struct process_stats* process = htable_get_int(&processes, pid);
+
+   if (process == NULL) {
+      process = calloc(1, sizeof(struct process_stats));
+      process->pid = pid;
+      htable_put_int(&processes, pid, process);
+   }
+   return process;
+}
+
+//*****************************************************************************
+
+// open flags are recorded in octal; fopen modes have no sync flags
+static int open_mode(const char* flags_text)
+{
+   int flags;
+
+   if (flags_text[0] < '0' || flags_text[0] > '9') {
+      return MODE_NONE;
+   }
+   flags = (int) strtol(flags_text, NULL, 8);
+   if ((flags & O_SYNC) == O_SYNC) {
+      return MODE_SYNC;
+   }
+   return (flags & O_DSYNC) ? MODE_DSYNC : MODE_NONE;
+}
+
+//*****************************************************************************
+
+static int dirty_class(long long dirty_bytes)
+{
+   int c;
+
+   for (c = 0; c < NUM_DIRTY_CLASSES - 1; ++c) {
+      if (dirty_bytes <= dirty_class_bounds[c]) {
+         return c;
+      }
+   }
+   return NUM_DIRTY_CLASSES - 1;
+}
+
+//*****************************************************************************
+
+// the writes since the last sync are durable at end_usec
+static void make_durable(struct file_stats* file, long long end_usec)
+{
+   if (file->dirty_writes > 0) {
+      file->w2d_sum_usec += file->dirty_writes * (double) end_usec - file->dirty_end_sum_usec;
+      file->w2d_writes += file->dirty_writes;
+      histogram_add(&file->w2d_max_usec, end_usec - file->first_dirty_end_usec);
+   }
+   file->dirty_bytes = 0;
+   file->dirty_writes = 0;
+   file->dirty_end_sum_usec = 0.0;
+}
+
+//*****************************************************************************
+
+struct global_sync {
+   int pid;
+   long long end_usec;
+};
+
+static void make_process_durable(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct global_sync* sync = ctx;
+   struct file_stats* file = value;
+
+   if (file->pid == sync->pid) {
+      make_durable(file, sync->end_usec);
+   }
+}
+
+//*****************************************************************************
+
+static void count_sync(struct process_stats* process, const struct monitor_record_t* r)
+{
+   const long long second = r->start_usec / 1000000;
+
+   if (second != process->current_second) {
+      process->current_second = second;
+      process->current_second_syncs = 0;
+   }
+   process->current_second_syncs++;
+   if (process->current_second_syncs > process->peak_syncs_per_second) {
+      process->peak_syncs_per_second = process->current_second_syncs;
+   }
+   process->sync_ms += r->elapsed_time;
+}
+
+//*****************************************************************************
+
+static void record_sync(const struct process_info* process_info,
+                        const struct monitor_record_t* r)
+{
+   const long long end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+   struct process_stats* process = get_process(r->pid);
+   struct file_stats* file;
+
+   count_sync(process, r);
+
+   // sync and syncfs make all data of the process durable
+   if (r->fd < 0 || !strcmp(r->s1, "syncfs")) {
+      struct global_sync sync;
+      sync.pid = r->pid;
+      sync.end_usec = end_usec;
+      process->global_syncs++;
+      htable_foreach(&files, make_process_durable, &sync);
+      return;
+   }
+
+   process->syncs++;
+   file = get_file(record_path(process_info, r), r);
+
+   // sync_file_range only starts writeback; it does not make data durable
+   if (!strcmp(r->s1, "sync_file_range")) {
+      file->range_syncs++;
+      return;
+   }
+
+   if (file->syncs == 0) {
+      file->first_sync_usec = r->start_usec;
+   } else if (r->start_usec - file->last_sync_end_usec <= GROUP_COMMIT_WINDOW_USEC) {
+      file->groupable++;
+      file->groupable_ms += r->elapsed_time;
+   }
+   file->syncs++;
+   if (file->dirty_bytes == 0) {
+      file->empty_syncs++;
+   }
+   histogram_add(&file->sync_usec, r->elapsed_time * 1000.0);
+   histogram_add(&file->bytes_per_sync, file->dirty_bytes);
+   histogram_add(&sync_usec_by_dirty[dirty_class(file->dirty_bytes)],
+                 r->elapsed_time * 1000.0);
+   make_durable(file, end_usec);
+   file->last_sync_end_usec = end_usec;
+}
+
+//*****************************************************************************
+
+void durability_record(const struct process_info* process,
+                       const struct monitor_record_t* r)
+{
+   const long fd_key = ((long) r->pid << 32) | (unsigned int) r->fd;
+   struct file_stats* file;
+   const char* path;
+   long mode;
+
+   if (report_output == NULL || r->error_code != 0) {
+      return;
+   }
+
+   if (r->op_type == SYNC && r->dom_type == SYNCS) {
+      record_sync(process, r);
+   } else if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE && r->fd >= 0) {
+      mode = open_mode(r->s2);
+      htable_remove_int(&fd_modes, fd_key);
+      if (mode != MODE_NONE) {
+         htable_put_int(&fd_modes, fd_key, (void*) mode);
+         get_file(r->s1[0] ? r->s1 : NULL, r)->mode = mode;
+      }
+   } else if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE && r->fd >= 0) {
+      htable_remove_int(&fd_modes, fd_key);
+   } else if (r->op_type == WRITE && r->dom_type == FILE_WRITE && r->fd >= 0 &&
+              r->bytes_transferred > 0) {
+      // writes to pipes and sockets (no known path) are not synced
+      path = record_path(process, r);
+      mode = (long) htable_get_int(&fd_modes, fd_key);
+      if (path == NULL && mode == MODE_NONE) {
+         return;
+      }
+      file = get_file(path, r);
+      if (mode != MODE_NONE) {
+         file->sync_mode_writes++;
+         file->sync_mode_bytes += r->bytes_transferred;
+         histogram_add(&file->sync_mode_usec, r->elapsed_time * 1000.0);
+         return;
+      }
+      if (file->dirty_writes == 0) {
+         file->first_dirty_end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+      }
+      file->dirty_bytes += r->bytes_transferred;
+      file->dirty_writes++;
+      file->dirty_end_sum_usec += r->start_usec + r->elapsed_time * 1000.0;
+   }
+}
+
+//*****************************************************************************
+
+static void collect_value(const void* key, size_t key_len, void* value, void* ctx)
+{
+   void*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_files(const void* a, const void* b)
+{
+   const struct file_stats* fa = *(struct file_stats* const*) a;
+   const struct file_stats* fb = *(struct file_stats* const*) b;
+   const double ta = fa->sync_usec.sum + fa->sync_mode_usec.sum;
+   const double tb = fb->sync_usec.sum + fb->sync_mode_usec.sum;
+
+   return (ta < tb) - (ta > tb);
+}
+
+static int compare_processes(const void* a, const void* b)
+{
+   const struct process_stats* pa = *(struct process_stats* const*) a;
+   const struct process_stats* pb = *(struct process_stats* const*) b;
+
+   return (pa->sync_ms < pb->sync_ms) - (pa->sync_ms > pb->sync_ms);
+}
+
+//*****************************************************************************
+
+static void print_files(struct file_stats** list, size_t count)
+{
+   size_t shown = 0;
+   size_t i;
+
+   fprintf(report_output, "\n===== durability: syncs by file\n");
+   fprintf(report_output, "  %7s %8s %8s %6s %6s %12s %9s %9s %9s %10s %10s %9s %10s  %s\n",
+           "PID", "SYNCS", "SYNCS/S", "EMPTY", "RANGE", "BYTES/SYNC", "AVG(ms)",
+           "P99(ms)", "MAX(ms)", "W2D(ms)", "W2D99(ms)", "GROUPABLE", "SAVED(ms)", "FILE");
+   for (i = 0; i < count && shown < (size_t) TOP_FILES; ++i) {
+      const struct file_stats* f = list[i];
+      const struct histogram* h = &f->sync_usec;
+      const double span_secs = (f->last_sync_end_usec - f->first_sync_usec) / 1e6;
+
+      if (f->syncs == 0 && f->range_syncs == 0) {
+         continue;
+      }
+      shown++;
+      fprintf(report_output,
+              "  %7d %8llu %8.1f %6llu %6llu %12.0f %9.3f %9.3f %9.3f %10.3f %10.3f %9llu %10.3f  %s\n",
+              f->pid, f->syncs, span_secs > 0.0 ? (f->syncs - 1) / span_secs : 0.0,
+              f->empty_syncs, f->range_syncs,
+              f->syncs ? f->bytes_per_sync.sum / f->syncs : 0.0,
+              h->count ? h->sum / h->count / 1000.0 : 0.0,
+              histogram_percentile(h, 99.0) / 1000.0, h->max / 1000.0,
+              f->w2d_writes ? f->w2d_sum_usec / f->w2d_writes / 1000.0 : 0.0,
+              histogram_percentile(&f->w2d_max_usec, 99.0) / 1000.0,
+              f->groupable, f->groupable_ms, f->target);
+   }
+}
+
+//*****************************************************************************
+
+static void print_sync_mode_files(struct file_stats** list, size_t count)
+{
+   size_t i;
+   int header = 0;
+
+   for (i = 0; i < count; ++i) {
+      const struct file_stats* f = list[i];
+      const struct histogram* h = &f->sync_mode_usec;
+
+      if (f->mode == MODE_NONE) {
+         continue;
+      }
+      if (!header) {
+         fprintf(report_output, "\n===== durability: files opened with O_SYNC/O_DSYNC\n");
+         fprintf(report_output, "  %7s %-8s %10s %14s %12s %9s %9s  %s\n",
+                 "PID", "MODE", "WRITES", "BYTES", "TIME(ms)", "AVG(ms)", "P99(ms)",
+                 "FILE");
+         header = 1;
+      }
+      fprintf(report_output, "  %7d %-8s %10llu %14llu %12.3f %9.3f %9.3f  %s\n",
+              f->pid, mode_names[f->mode], f->sync_mode_writes, f->sync_mode_bytes,
+              h->sum / 1000.0, h->count ? h->sum / h->count / 1000.0 : 0.0,
+              histogram_percentile(h, 99.0) / 1000.0, f->target);
+   }
+}
+
+//*****************************************************************************
+
+void durability_report()
+{
+   struct file_stats** file_list;
+   struct process_stats** process_list;
+   void** cursor;
+   size_t i;
+   int c;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   file_list = malloc((files.count + 1) * sizeof(struct file_stats*));
+   cursor = (void**) file_list;
+   htable_foreach(&files, collect_value, &cursor);
+   qsort(file_list, files.count, sizeof(struct file_stats*), compare_files);
+
+   process_list = malloc((processes.count + 1) * sizeof(struct process_stats*));
+   cursor = (void**) process_list;
+   htable_foreach(&processes, collect_value, &cursor);
+   qsort(process_list, processes.count, sizeof(struct process_stats*), compare_processes);
+
+   fprintf(report_output, "\n===== durability: syncs by process\n");
+   fprintf(report_output, "  %7s %10s %12s %12s %12s\n",
+           "PID", "SYNCS", "SYNC/SYNCFS", "TIME(ms)", "PEAK/S");
+   for (i = 0; i < processes.count; ++i) {
+      const struct process_stats* p = process_list[i];
+      fprintf(report_output, "  %7d %10llu %12llu %12.3f %12llu\n",
+              p->pid, p->syncs, p->global_syncs, p->sync_ms, p->peak_syncs_per_second);
+   }
+
+   print_files(file_list, files.count);
+
+   fprintf(report_output, "\n===== durability: sync latency by bytes written since the last sync\n");
+   fprintf(report_output, "  %-12s %10s %10s %10s %10s %10s\n",
+           "DIRTY BYTES", "SYNCS", "AVG(ms)", "P50(ms)", "P99(ms)", "MAX(ms)");
+   for (c = 0; c < NUM_DIRTY_CLASSES; ++c) {
+      const struct histogram* h = &sync_usec_by_dirty[c];
+      if (h->count == 0) {
+         continue;
+      }
+      fprintf(report_output, "  %-12s %10llu %10.3f %10.3f %10.3f %10.3f\n",
+              dirty_class_names[c], h->count, h->sum / h->count / 1000.0,
+              histogram_percentile(h, 50.0) / 1000.0,
+              histogram_percentile(h, 99.0) / 1000.0, h->max / 1000.0);
+   }
+
+   print_sync_mode_files(file_list, files.count);
+   fflush(report_output);
+
+   free(file_list);
+   free(process_list);
+   htable_destroy(&files, free);
+   htable_destroy(&processes, free);
+   htable_destroy(&fd_modes, NULL);
+}
+
+//*****************************************************************************
@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __DURABILITY_H
+#define __DURABILITY_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// relates syncs (fsync, fdatasync, sync_file_range, syncfs, sync) to the
+// writes before them, per file and process: bytes per sync, sync latency
+// by dirty bytes, sync rates, write-to-durable latency and syncs that a
+// group commit could have merged. files opened with O_SYNC/O_DSYNC are
+// listed separately, since each of their writes is a sync.
+
+void durability_init(FILE* output);
+void durability_record(const struct process_info* process,
+                       const struct monitor_record_t* monitor_record);
+void durability_report();
+
+#endif //__DURABILITY_H
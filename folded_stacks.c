@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// folded_stacks.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "ops_names.h"
+#include "htable.h"
+#include "symbolizer.h"
+#include "folded_stacks.h"
+
+#define FRAME_NAME_LEN 256
+
+static const char* output_path = NULL;
+static FOLD_WEIGHT fold_weight = FOLD_BY_LATENCY;
+static struct htable folded;   // folded stack string -> unsigned long long*
+
+//*****************************************************************************
+
+void folded_stacks_init(const char* path, FOLD_WEIGHT weight)
+{
+   output_path = path;
+   fold_weight = weight;
+   htable_init(&folded);
+   symbolizer_init();
+}
+
+//*****************************************************************************
+
+void folded_stacks_record(const struct monitor_record_t* r)
+{
+   char key[MAX_STACK_FRAMES * FRAME_NAME_LEN + STR_LEN];
+   char frame[FRAME_NAME_LEN];
+   unsigned long long* total;
+   unsigned long long weight;
+   size_t key_len = 0;
+   int i;
+
+   if (output_path == NULL) {
+      return;
+   }
+
+   if (r->op_type == START) {
+      // grab the memory map while the process is (most likely) still alive
+      symbolizer_load_pid(r->pid);
+      return;
+   } else if (r->op_type == STOP) {
+      symbolizer_forget_pid(r->pid);
+      return;
+   }
+
+   if (r->caller == 0 || r->dom_type == START_STOP) {
+      return;
+   }
+
+   // stacks are captured innermost first; folded format is root first.
+   // records without a sampled stack still attribute to their call site.
+   if (r->stack_depth > 0) {
+      for (i = r->stack_depth - 1; i >= 0; --i) {
+         symbolize(r->pid, r->stack[i], frame, sizeof(frame));
+         key_len += snprintf(key + key_len, sizeof(key) - key_len, "%s;", frame);
+      }
+   } else {
+      symbolize(r->pid, r->caller, frame, sizeof(frame));
+      key_len += snprintf(key + key_len, sizeof(key) - key_len, "%s;", frame);
+   }
+   snprintf(key + key_len, sizeof(key) - key_len, "[%s]", ops_names[r->op_type]);
+
+   if (fold_weight == FOLD_BY_BYTES) {
+      weight = r->bytes_transferred;
+   } else {
+      weight = (unsigned long long) (r->elapsed_time * 1000.0 + 0.5);
+   }
+
+   total = htable_get_str(&folded, key);
+   if (total == NULL) {
+      total = calloc(1, sizeof(*total));
+      htable_put_str(&folded, key, total);
+   }
+   *total += weight;
+}
+
+//*****************************************************************************
+
+static void write_folded_line(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const unsigned long long* total = value;
+
+   if (*total > 0) {
+      fprintf((FILE*) ctx, "%.*s %llu\n", (int) key_len, (const char*) key, *total);
+   }
+}
+
+//*****************************************************************************
+
+void folded_stacks_report()
+{
+   FILE* out;
+
+   if (output_path == NULL) {
+      return;
+   }
+
+   out = fopen(output_path, "w");
+   if (out == NULL) {
+      printf("error: unable to write folded stacks to '%s'\n", output_path);
+   } else {
+      htable_foreach(&folded, write_folded_line, out);
+      fclose(out);
+   }
+
+   htable_destroy(&folded, free);
+   symbolizer_fini();
+}
+
+//*****************************************************************************
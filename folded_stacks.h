@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __FOLDED_STACKS_H
+#define __FOLDED_STACKS_H
+#include "monitor_record.h"
+
+// aggregates call sites/stacks captured by the shim (CAPTURE_CALLER)
+// into the "folded" format consumed by flame graph tools:
+//
+//    main;do_work;write_log;[WRITE] 12345
+//
+// the weight is either total latency (microseconds) or total bytes.
+
+typedef enum {
+   FOLD_BY_LATENCY,
+   FOLD_BY_BYTES
+} FOLD_WEIGHT;
+
+void folded_stacks_init(const char* output_path, FOLD_WEIGHT weight);
+void folded_stacks_record(const struct monitor_record_t* monitor_record);
+void folded_stacks_report();
+
+#endif //__FOLDED_STACKS_H
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// histogram.c
+
+#include "histogram.h"
+
+//*****************************************************************************
+
+void histogram_add(struct histogram* h, double value)
+{
+   int bucket = 0;
+   double upper = 1.0;
+
+   while ((value > upper) && (bucket < HISTOGRAM_BUCKETS - 1)) {
+      upper *= 2.0;
+      bucket++;
+   }
+
+   h->counts[bucket]++;
+   h->count++;
+   h->sum += value;
+   if (value > h->max) {
+      h->max = value;
+   }
+}
+
+//*****************************************************************************
+
+void histogram_merge(struct histogram* into, const struct histogram* from)
+{
+   int i;
+
+   for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      into->counts[i] += from->counts[i];
+   }
+   into->count += from->count;
+   into->sum += from->sum;
+   if (from->max > into->max) {
+      into->max = from->max;
+   }
+}
+
+//*****************************************************************************
+
+double histogram_bucket_upper(int bucket)
+{
+   double upper = 1.0;
+
+   while (bucket-- > 0) {
+      upper *= 2.0;
+   }
+   return upper;
+}
+
+//*****************************************************************************
+
+double histogram_percentile(const struct histogram* h, double percentile)
+{
+   double target;
+   unsigned long long seen = 0;
+   int i;
+
+   if (h->count == 0) {
+      return 0.0;
+   }
+
+   target = h->count * percentile / 100.0;
+   for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      if (h->counts[i] > 0 && seen + h->counts[i] >= target) {
+         double lower = (i == 0) ? 0.0 : histogram_bucket_upper(i - 1);
+         double upper = histogram_bucket_upper(i);
+         double value = lower + (upper - lower) * (target - seen) / h->counts[i];
+         return (value < h->max) ? value : h->max;
+      }
+      seen += h->counts[i];
+   }
+   return h->max;
+}
+
+//*****************************************************************************
@@ -0,0 +1,41 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+// fixed-size log2 histogram. bucket 0 holds values <= 1, bucket i holds
+// values in (2^(i-1), 2^i]. the unit is up to the caller (latencies are
+// kept in microseconds, sizes in bytes).
+#define HISTOGRAM_BUCKETS 40
+
+struct histogram {
+   unsigned long long counts[HISTOGRAM_BUCKETS];
+   unsigned long long count;
+   double sum;
+   double max;
+};
+
+void histogram_add(struct histogram* h, double value);
+void histogram_merge(struct histogram* into, const struct histogram* from);
+
+// upper bound (inclusive) of bucket i
+double histogram_bucket_upper(int bucket);
+
+// estimated value at given percentile (0-100), interpolated within bucket
+double histogram_percentile(const struct histogram* h, double percentile);
+
+#endif //__HISTOGRAM_H
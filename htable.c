@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// htable.c
+
+#include <stdlib.h>
+#include <string.h>
+#include "htable.h"
+
+static const size_t INITIAL_BUCKETS = 64;
+
+//*****************************************************************************
+
+static unsigned long hash_key(const void* key, size_t key_len)
+{
+   // FNV-1a
+   const unsigned char* p = key;
+   unsigned long h = 14695981039346656037UL;
+   size_t i;
+
+   for (i = 0; i < key_len; ++i) {
+      h ^= p[i];
+      h *= 1099511628211UL;
+   }
+   return h;
+}
+
+//*****************************************************************************
+
+void htable_init(struct htable* table)
+{
+   table->num_buckets = INITIAL_BUCKETS;
+   table->count = 0;
+   table->buckets = calloc(table->num_buckets, sizeof(struct htable_entry*));
+}
+
+//*****************************************************************************
+
+void htable_destroy(struct htable* table, void (*free_value)(void*))
+{
+   size_t i;
+   struct htable_entry* entry;
+   struct htable_entry* next;
+
+   for (i = 0; i < table->num_buckets; ++i) {
+      for (entry = table->buckets[i]; entry != NULL; entry = next) {
+         next = entry->next;
+         if (free_value != NULL) {
+            free_value(entry->value);
+         }
+         free(entry);
+      }
+   }
+   free(table->buckets);
+   table->buckets = NULL;
+   table->num_buckets = 0;
+   table->count = 0;
+}
+
+//*****************************************************************************
+
+static struct htable_entry** find_slot(const struct htable* table,
+                                       const void* key, size_t key_len,
+                                       unsigned long hash)
+{
+   struct htable_entry** slot = &table->buckets[hash % table->num_buckets];
+
+   while (*slot != NULL) {
+      if ((*slot)->hash == hash && (*slot)->key_len == key_len &&
+          !memcmp((*slot)->key, key, key_len)) {
+         break;
+      }
+      slot = &(*slot)->next;
+   }
+   return slot;
+}
+
+//*****************************************************************************
+
+static void grow(struct htable* table)
+{
+   size_t new_num_buckets = table->num_buckets * 2;
+   struct htable_entry** new_buckets;
+   struct htable_entry* entry;
+   struct htable_entry* next;
+   size_t i;
+
+   new_buckets = calloc(new_num_buckets, sizeof(struct htable_entry*));
+   if (new_buckets == NULL) {
+      return;
+   }
+
+   for (i = 0; i < table->num_buckets; ++i) {
+      for (entry = table->buckets[i]; entry != NULL; entry = next) {
+         next = entry->next;
+         entry->next = new_buckets[entry->hash % new_num_buckets];
+         new_buckets[entry->hash % new_num_buckets] = entry;
+      }
+   }
+   free(table->buckets);
+   table->buckets = new_buckets;
+   table->num_buckets = new_num_buckets;
+}
+
+//*****************************************************************************
+
+void* htable_get(const struct htable* table, const void* key, size_t key_len)
+{
+   struct htable_entry** slot = find_slot(table, key, key_len,
+                                          hash_key(key, key_len));
+   return (*slot != NULL) ? (*slot)->value : NULL;
+}
+
+//*****************************************************************************
+
+void htable_put(struct htable* table, const void* key, size_t key_len, void* value)
+{
+   const unsigned long hash = hash_key(key, key_len);
+   struct htable_entry** slot = find_slot(table, key, key_len, hash);
+   struct htable_entry* entry;
+
+   if (*slot != NULL) {
+      (*slot)->value = value;
+      return;
+   }
+
+   entry = malloc(sizeof(struct htable_entry) + key_len);
+   if (entry == NULL) {
+      return;
+   }
+   entry->next = NULL;
+   entry->hash = hash;
+   entry->key_len = key_len;
+   entry->value = value;
+   memcpy(entry->key, key, key_len);
+   *slot = entry;
+
+   if (++table->count > table->num_buckets) {
+      grow(table);
+   }
+}
+
+//*****************************************************************************
+
+void* htable_remove(struct htable* table, const void* key, size_t key_len)
+{
+   struct htable_entry** slot = find_slot(table, key, key_len,
+                                          hash_key(key, key_len));
+   struct htable_entry* entry = *slot;
+   void* value;
+
+   if (entry == NULL) {
+      return NULL;
+   }
+   value = entry->value;
+   *slot = entry->next;
+   free(entry);
+   table->count--;
+   return value;
+}
+
+//*****************************************************************************
+
+void* htable_get_str(const struct htable* table, const char* key)
+{
+   return htable_get(table, key, strlen(key));
+}
+
+void htable_put_str(struct htable* table, const char* key, void* value)
+{
+   htable_put(table, key, strlen(key), value);
+}
+
+void* htable_get_int(const struct htable* table, long key)
+{
+   return htable_get(table, &key, sizeof(key));
+}
+
+void htable_put_int(struct htable* table, long key, void* value)
+{
+   htable_put(table, &key, sizeof(key), value);
+}
+
+void* htable_remove_int(struct htable* table, long key)
+{
+   return htable_remove(table, &key, sizeof(key));
+}
+
+//*****************************************************************************
+
+void htable_foreach(const struct htable* table,
+                    void (*visit)(const void* key, size_t key_len,
+                                  void* value, void* ctx),
+                    void* ctx)
+{
+   size_t i;
+   struct htable_entry* entry;
+
+   for (i = 0; i < table->num_buckets; ++i) {
+      for (entry = table->buckets[i]; entry != NULL; entry = entry->next) {
+         visit(entry->key, entry->key_len, entry->value, ctx);
+      }
+   }
+}
+
+//*****************************************************************************
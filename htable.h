@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HTABLE_H
+#define __HTABLE_H
+#include <stddef.h>
+
+// a small chained hash table used by the listener and the offline
+// tools. keys are arbitrary byte strings (copied into the table),
+// values are caller-owned pointers.
+
+struct htable_entry {
+   struct htable_entry* next;
+   unsigned long hash;
+   size_t key_len;
+   void* value;
+   char key[];
+};
+
+struct htable {
+   struct htable_entry** buckets;
+   size_t num_buckets;
+   size_t count;
+};
+
+void htable_init(struct htable* table);
+void htable_destroy(struct htable* table, void (*free_value)(void*));
+
+void* htable_get(const struct htable* table, const void* key, size_t key_len);
+void htable_put(struct htable* table, const void* key, size_t key_len, void* value);
+void* htable_remove(struct htable* table, const void* key, size_t key_len);
+
+// convenience wrappers for the common key types
+void* htable_get_str(const struct htable* table, const char* key);
+void htable_put_str(struct htable* table, const char* key, void* value);
+void* htable_get_int(const struct htable* table, long key);
+void htable_put_int(struct htable* table, long key, void* value);
+void* htable_remove_int(struct htable* table, long key);
+
+// iteration: visit every entry; the callback must not modify the table
+void htable_foreach(const struct htable* table,
+                    void (*visit)(const void* key, size_t key_len,
+                                  void* value, void* ctx),
+                    void* ctx);
+
+#endif //__HTABLE_H
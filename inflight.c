@@ -0,0 +1,517 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// inflight.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "mounts.h"
+#include "inflight.h"
+
+// records arrive when calls end, not in start order. events are held back
+// this long behind the latest end seen before they are counted; a call
+// that started earlier than that is counted from the point reached.
+static const long long REORDER_LAG_USEC = 1000000;
+
+static const long long INTERVAL_USEC = 1000000;
+
+// a second is serialized when at most one call was in flight, I/O was busy
+// for at least half of it and calls took this long on average
+static const double SERIALIZED_MIN_BUSY = 0.5;
+static const double SERIALIZED_MIN_LATENCY_MS = 1.0;
+
+// in-flight counts above this are counted as this
+#define MAX_DEPTH 64
+
+static const int TOP_FILES = 20;
+
+enum tracker_kind { KIND_PROCESS, KIND_DEVICE, KIND_FILE, NUM_KINDS };
+static const char* kind_names[NUM_KINDS] = { "process", "device", "file" };
+
+struct tracker {
+   int kind;
+   char name[64];                 // pid, device or file
+   int depth;
+   int max_depth;
+   long long last_usec;           // time the depth was counted up to
+   double depth_usec[MAX_DEPTH + 1];
+   double busy_usec;
+   unsigned long long ops;
+   double latency_ms;
+   // current interval
+   long long interval;
+   double interval_area;          // depth x usec
+   double interval_busy_usec;
+   int interval_max;
+   unsigned long long interval_ops;
+   double interval_latency_ms;
+   // serialized seconds
+   unsigned long long serialized_secs;
+   unsigned long long serialized_ops;
+   double serialized_latency_ms;
+   long long run_start;
+   long long run_secs;
+   long long longest_run_start;
+   long long longest_run_secs;
+};
+
+struct event {
+   long long usec;
+   int delta;                     // +1 start, -1 end
+   double latency_ms;             // of the call, on its end
+   struct tracker* trackers[NUM_KINDS];
+};
+
+static FILE* report_output = NULL;
+static FILE* series = NULL;
+static struct htable trackers[NUM_KINDS];
+static struct event* heap = NULL;
+static size_t heap_count = 0;
+static size_t heap_capacity = 0;
+static long long latest_end_usec = 0;
+static long long counted_usec = 0;   // events before this were counted
+
+//*****************************************************************************
+
+int inflight_init(FILE* output, const char* series_path)
+{
+   int k;
+
+   report_output = output;
+   for (k = 0; k < NUM_KINDS; ++k) {
+      htable_init(&trackers[k]);
+   }
+   if (series_path != NULL) {
+      series = fopen(series_path, "w");
+      if (series == NULL) {
+         printf("error: unable to write in-flight series to '%s'\n", series_path);
+         return -1;
+      }
+      fprintf(series, "second,kind,name,mean_inflight,max_inflight,busy_pct,ops,avg_latency_ms\n");
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+static struct tracker* get_tracker(int kind, const char* name)
+{
+   struct tracker* tracker = htable_get_str(&trackers[kind], name);
+   size_t len;
+
+   if (tracker == NULL) {
+      tracker = calloc(1, sizeof(struct tracker));
+      tracker->kind = kind;
+      tracker->last_usec = -1;
+      // keep the end of long paths
+      len = strlen(name);
+      snprintf(tracker->name, sizeof(tracker->name), "%s",
+               len < sizeof(tracker->name) ? name : name + len - (sizeof(tracker->name) - 1));
+      htable_put_str(&trackers[kind], name, tracker);
+   }
+   return tracker;
+}
+
+//*****************************************************************************
+
+static void close_interval(struct tracker* t)
+{
+   const double mean_latency_ms =
+      t->interval_ops ? t->interval_latency_ms / t->interval_ops : 0.0;
+
+   if (t->interval_busy_usec == 0.0 && t->interval_ops == 0) {
+      return;
+   }
+
+   if (series != NULL && t->kind != KIND_FILE) {
+      fprintf(series, "%lld,%s,%s,%.3f,%d,%.1f,%llu,%.3f\n",
+              t->interval, kind_names[t->kind], t->name,
+              t->interval_area / INTERVAL_USEC, t->interval_max,
+              100.0 * t->interval_busy_usec / INTERVAL_USEC,
+              t->interval_ops, mean_latency_ms);
+   }
+
+   if (t->interval_max <= 1 && t->interval_ops > 0 &&
+       t->interval_busy_usec >= SERIALIZED_MIN_BUSY * INTERVAL_USEC &&
+       mean_latency_ms >= SERIALIZED_MIN_LATENCY_MS) {
+      t->serialized_secs++;
+      t->serialized_ops += t->interval_ops;
+      t->serialized_latency_ms += t->interval_latency_ms;
+      if (t->run_secs > 0 && t->run_start + t->run_secs == t->interval) {
+         t->run_secs++;
+      } else {
+         t->run_start = t->interval;
+         t->run_secs = 1;
+      }
+      if (t->run_secs > t->longest_run_secs) {
+         t->longest_run_secs = t->run_secs;
+         t->longest_run_start = t->run_start;
+      }
+   }
+
+   t->interval_area = 0.0;
+   t->interval_busy_usec = 0.0;
+   t->interval_max = t->depth;
+   t->interval_ops = 0;
+   t->interval_latency_ms = 0.0;
+}
+
+//*****************************************************************************
+
+// counts the time from the last event of the tracker up to usec
+static void advance(struct tracker* t, long long usec)
+{
+   long long end;
+   long long duration;
+
+   if (t->last_usec < 0) {
+      t->last_usec = usec;
+      t->interval = usec / INTERVAL_USEC;
+      return;
+   }
+
+   while (t->last_usec < usec) {
+      if (t->depth == 0 && usec / INTERVAL_USEC > t->interval) {
+         // idle: skip to the interval of usec
+         close_interval(t);
+         t->interval = usec / INTERVAL_USEC;
+         t->last_usec = usec;
+         break;
+      }
+      end = (t->interval + 1) * INTERVAL_USEC;
+      if (end > usec) {
+         end = usec;
+      }
+      duration = end - t->last_usec;
+      if (t->depth > 0) {
+         t->interval_area += (double) t->depth * duration;
+         t->interval_busy_usec += duration;
+         t->busy_usec += duration;
+         t->depth_usec[t->depth < MAX_DEPTH ? t->depth : MAX_DEPTH] += duration;
+      }
+      t->last_usec = end;
+      if (end == (t->interval + 1) * INTERVAL_USEC) {
+         close_interval(t);
+         t->interval++;
+      }
+   }
+}
+
+//*****************************************************************************
+
+static void count_event(const struct event* e)
+{
+   int k;
+
+   for (k = 0; k < NUM_KINDS; ++k) {
+      struct tracker* t = e->trackers[k];
+      if (t == NULL) {
+         continue;
+      }
+      advance(t, e->usec);
+      t->depth += e->delta;
+      if (t->depth < 0) {
+         t->depth = 0;
+      }
+      if (t->depth > t->interval_max) {
+         t->interval_max = t->depth;
+      }
+      if (t->depth > t->max_depth) {
+         t->max_depth = t->depth;
+      }
+      if (e->delta < 0) {
+         t->ops++;
+         t->latency_ms += e->latency_ms;
+         t->interval_ops++;
+         t->interval_latency_ms += e->latency_ms;
+      }
+   }
+   counted_usec = e->usec;
+}
+
+//*****************************************************************************
+
+// min-heap on time; at the same time ends come before starts
+static int event_before(const struct event* a, const struct event* b)
+{
+   return a->usec < b->usec || (a->usec == b->usec && a->delta < b->delta);
+}
+
+static void heap_push(const struct event* e)
+{
+   size_t i;
+   size_t parent;
+
+   if (heap_count == heap_capacity) {
+      heap_capacity = heap_capacity ? heap_capacity * 2 : 1024;
+      heap = realloc(heap, heap_capacity * sizeof(struct event));
+   }
+   i = heap_count++;
+   while (i > 0) {
+      parent = (i - 1) / 2;
+      if (!event_before(e, &heap[parent])) {
+         break;
+      }
+      heap[i] = heap[parent];
+      i = parent;
+   }
+   heap[i] = *e;
+}
+
+static void heap_pop(struct event* e)
+{
+   const struct event last = heap[--heap_count];
+   size_t i = 0;
+   size_t child;
+
+   *e = heap[0];
+   while ((child = 2 * i + 1) < heap_count) {
+      if (child + 1 < heap_count && event_before(&heap[child + 1], &heap[child])) {
+         child++;
+      }
+      if (!event_before(&heap[child], &last)) {
+         break;
+      }
+      heap[i] = heap[child];
+      i = child;
+   }
+   heap[i] = last;
+}
+
+//*****************************************************************************
+
+static void count_events_before(long long usec)
+{
+   struct event e;
+
+   while (heap_count > 0 && heap[0].usec < usec) {
+      heap_pop(&e);
+      count_event(&e);
+   }
+}
+
+//*****************************************************************************
+
+void inflight_record(const struct process_info* process,
+                     const struct monitor_record_t* r)
+{
+   const char* path;
+   const char* device;
+   char pid_text[16];
+   struct event e;
+   long long end_usec;
+
+   if ((report_output == NULL && series == NULL) || r->fd < 0) {
+      return;
+   }
+   if (!(r->dom_type == FILE_READ && r->op_type == READ) &&
+       !(r->dom_type == FILE_WRITE && r->op_type == WRITE) &&
+       !(r->dom_type == SYNCS && (r->op_type == SYNC || r->op_type == FLUSH))) {
+      return;
+   }
+   // only files: pipes and sockets have no known path
+   path = record_path(process, r);
+   if (path == NULL) {
+      return;
+   }
+
+   snprintf(pid_text, sizeof(pid_text), "%d", r->pid);
+   device = mounts_device(path);
+   memset(&e, 0, sizeof(e));
+   e.trackers[KIND_PROCESS] = get_tracker(KIND_PROCESS, pid_text);
+   e.trackers[KIND_DEVICE] = get_tracker(KIND_DEVICE, device != NULL ? device : "-");
+   e.trackers[KIND_FILE] = get_tracker(KIND_FILE, path);
+
+   end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0 + 0.5);
+   if (end_usec <= r->start_usec) {
+      end_usec = r->start_usec + 1;
+   }
+
+   e.usec = r->start_usec > counted_usec ? r->start_usec : counted_usec;
+   e.delta = 1;
+   heap_push(&e);
+   e.usec = end_usec > counted_usec ? end_usec : counted_usec;
+   e.delta = -1;
+   e.latency_ms = r->elapsed_time;
+   heap_push(&e);
+
+   if (end_usec > latest_end_usec) {
+      latest_end_usec = end_usec;
+   }
+   count_events_before(latest_end_usec - REORDER_LAG_USEC);
+}
+
+//*****************************************************************************
+
+static void collect_tracker(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct tracker*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_trackers(const void* a, const void* b)
+{
+   const struct tracker* ta = *(struct tracker* const*) a;
+   const struct tracker* tb = *(struct tracker* const*) b;
+
+   return (ta->busy_usec < tb->busy_usec) - (ta->busy_usec > tb->busy_usec);
+}
+
+//*****************************************************************************
+
+// smallest depth d such that the given share of busy time had depth <= d
+static int depth_percentile(const struct tracker* t, double share)
+{
+   double time = 0.0;
+   int d;
+
+   for (d = 1; d <= MAX_DEPTH; ++d) {
+      time += t->depth_usec[d];
+      if (time >= share * t->busy_usec) {
+         return d;
+      }
+   }
+   return MAX_DEPTH;
+}
+
+static double depth_share(const struct tracker* t, int low, int high)
+{
+   double time = 0.0;
+   int d;
+
+   for (d = low; d <= high && d <= MAX_DEPTH; ++d) {
+      time += t->depth_usec[d];
+   }
+   return t->busy_usec > 0.0 ? 100.0 * time / t->busy_usec : 0.0;
+}
+
+//*****************************************************************************
+
+static void print_trackers(int kind, size_t limit)
+{
+   struct tracker** list = malloc((trackers[kind].count + 1) * sizeof(struct tracker*));
+   struct tracker** end = list;
+   const size_t count = trackers[kind].count;
+   double area;
+   size_t i;
+   int d;
+
+   htable_foreach(&trackers[kind], collect_tracker, &end);
+   qsort(list, count, sizeof(struct tracker*), compare_trackers);
+
+   fprintf(report_output, "\n===== in-flight I/O by %s\n", kind_names[kind]);
+   fprintf(report_output, "  %10s %10s %8s %5s %5s %5s %7s %7s %7s %7s %7s  %s\n",
+           "OPS", "BUSY(s)", "MEAN", "P50", "P99", "MAX",
+           "1(%)", "2-3(%)", "4-7(%)", "8-15(%)", "16+(%)",
+           kind == KIND_PROCESS ? "PID" : (kind == KIND_DEVICE ? "DEVICE" : "FILE"));
+   for (i = 0; i < count && i < limit; ++i) {
+      const struct tracker* t = list[i];
+      if (t->busy_usec == 0.0) {
+         break;
+      }
+      area = 0.0;
+      for (d = 1; d <= MAX_DEPTH; ++d) {
+         area += d * t->depth_usec[d];
+      }
+      fprintf(report_output, "  %10llu %10.3f %8.2f %5d %5d %5d %7.1f %7.1f %7.1f %7.1f %7.1f  %s\n",
+              t->ops, t->busy_usec / 1e6, area / t->busy_usec,
+              depth_percentile(t, 0.5), depth_percentile(t, 0.99), t->max_depth,
+              depth_share(t, 1, 1), depth_share(t, 2, 3), depth_share(t, 4, 7),
+              depth_share(t, 8, 15), depth_share(t, 16, MAX_DEPTH), t->name);
+   }
+   free(list);
+}
+
+//*****************************************************************************
+
+static void print_serialized(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct tracker* t = value;
+   int* header = ctx;
+
+   if (t->serialized_secs == 0) {
+      return;
+   }
+   if (!*header) {
+      fprintf(report_output,
+              "\n===== serialized I/O: seconds with at most 1 call in flight, "
+              ">= %.0f%% busy and >= %.1f ms per call\n",
+              SERIALIZED_MIN_BUSY * 100.0, SERIALIZED_MIN_LATENCY_MS);
+      fprintf(report_output, "  %-8s %8s %10s %9s %12s %8s  %s\n",
+              "KIND", "SECONDS", "OPS", "AVG(ms)", "LONGEST AT", "FOR(s)", "NAME");
+      *header = 1;
+   }
+   fprintf(report_output, "  %-8s %8llu %10llu %9.3f %12lld %8lld  %s\n",
+           kind_names[t->kind], t->serialized_secs, t->serialized_ops,
+           t->serialized_latency_ms / t->serialized_ops,
+           t->longest_run_start, t->longest_run_secs, t->name);
+}
+
+//*****************************************************************************
+
+static void finish_tracker(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct tracker* t = value;
+
+   close_interval(t);
+}
+
+//*****************************************************************************
+
+void inflight_report()
+{
+   int header = 0;
+   int k;
+
+   if (report_output == NULL && series == NULL) {
+      return;
+   }
+
+   count_events_before(latest_end_usec + 1);
+   for (k = 0; k < NUM_KINDS; ++k) {
+      htable_foreach(&trackers[k], finish_tracker, NULL);
+   }
+
+   if (report_output != NULL) {
+      print_trackers(KIND_PROCESS, trackers[KIND_PROCESS].count);
+      print_trackers(KIND_DEVICE, trackers[KIND_DEVICE].count);
+      print_trackers(KIND_FILE, TOP_FILES);
+      // a single file is usually accessed serially; what matters is
+      // whether the process or the device ever had more in flight
+      htable_foreach(&trackers[KIND_PROCESS], print_serialized, &header);
+      htable_foreach(&trackers[KIND_DEVICE], print_serialized, &header);
+      fflush(report_output);
+   }
+   if (series != NULL) {
+      fclose(series);
+      series = NULL;
+   }
+
+   for (k = 0; k < NUM_KINDS; ++k) {
+      htable_destroy(&trackers[k], free);
+   }
+   free(heap);
+   heap = NULL;
+   heap_count = 0;
+}
+
+//*****************************************************************************
@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __INFLIGHT_H
+#define __INFLIGHT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// number of file I/Os (reads, writes, syncs) in flight over time, per
+// process, per device and per file, from the start and end of each call.
+// the report has the distribution of the in-flight count over busy time
+// and the seconds in which a process or device had I/O serialized (never
+// more than one call in flight) while slow. the per-second time series of
+// processes and devices can be written to a CSV file.
+
+// returns -1 if the series file cannot be created
+int inflight_init(FILE* output, const char* series_path);
+void inflight_record(const struct process_info* process,
+                     const struct monitor_record_t* monitor_record);
+void inflight_report();
+
+#endif //__INFLIGHT_H
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdio_ext.h>
 #include <string.h>
 #include <limits.h>
 #include <dlfcn.h>
@@ -41,6 +42,10 @@
 #include <utime.h>
 #include <time.h>
 #include <errno.h>
+#include <execinfo.h>
+#include <sched.h>
+#include <spawn.h>
+#include <pthread.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/msg.h>
@@ -49,9 +54,13 @@
 #include <sys/types.h>
 #include <sys/xattr.h>
 #include <sys/uio.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/vfs.h>
 #include <arpa/inet.h>
 #include <endian.h>
 #include <netinet/in.h>
@@ -59,6 +68,7 @@
 #include "domains.h"
 #include "domains_names.h"
 #include "mq.h"
+#include "residency.h"
 
 
 // to build:
@@ -72,7 +82,7 @@
 
 
 // TODO and enhancements
-// - implement missing intercept calls (FILE_SPACE, PROCESSES, etc.)
+// - implement missing intercept calls (LINKS, DIRS, etc.)
 // - find a better name/grouping for MISC
 // - should there be a sampling mechanism? (capturing everything on a busy
 //     server process can generate a lot of data)
@@ -80,16 +90,27 @@
 //     http://man7.org/linux/man-pages/man2/open.2.html
 
 
+// with CPU_TIME set, the CPU time of the calling thread is read around
+// the real call as well, inside the wall clock readings
 #define DECL_VARS() \
 struct timeval start_time, end_time; \
+struct timespec cpu_start_time = {0, 0}, cpu_end_time = {0, 0}; \
 int error_code = 0;
 
 #define GET_START_TIME() \
-gettimeofday(&start_time, NULL);
+gettimeofday(&start_time, NULL); \
+if (capture_cpu_time) clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start_time);
 
 #define GET_END_TIME() \
+if (capture_cpu_time) clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end_time); \
 gettimeofday(&end_time, NULL);
 
+#define CPU_TIME() \
+cpu_time_ms(&cpu_start_time, &cpu_end_time)
+
+static const double CPU_TIME_NONE = -1.0;
+static int capture_cpu_time = 0;
+
 #define TIME_BEFORE() \
 &start_time
 
@@ -104,10 +125,18 @@ static const char* ENV_MESSAGE_QUEUE_PATH = "MESSAGE_QUEUE_PATH";
 static const char* ENV_START_ON_OPEN = "START_ON_OPEN";
 static const char* ENV_MONITOR_DOMAINS = "MONITOR_DOMAINS";
 static const char* ENV_START_ON_ELAPSED = "START_ON_ELAPSED";
+static const char* ENV_CAPTURE_CALLER = "CAPTURE_CALLER";
+static const char* ENV_STACK_SAMPLE_RATE = "STACK_SAMPLE_RATE";
+static const char* ENV_STACK_LATENCY_MS = "STACK_LATENCY_MS";
+static const char* ENV_STAT_ON_OPEN = "STAT_ON_OPEN";
+static const char* ENV_BLOCKED_INTERVAL = "BLOCKED_INTERVAL";
+static const char* ENV_CPU_TIME = "CPU_TIME";
+static const char* ENV_CACHE_PROBE = "CACHE_PROBE";
 
 static const int SOCKET_PORT = 8001;
 static const int DOMAIN_UNSPECIFIED = -1;
 static const int FD_NONE = -1;
+static const long long OFFSET_NONE = -1;
 static const int MQ_KEY_NONE = -1;
 static int failed_socket_connections = 0;
 static int failed_ipc_sends = 0;
@@ -150,6 +179,10 @@ puts(s);
 
 //***********  initialization  ***********
 void initialize_monitor();
+void identify_container();
+void save_monitor_environment();
+static void after_fork_child();
+static void reset_fd_positions();
 unsigned int domain_list_to_bit_mask(const char* domain_list);
 
 //***********  IPC mechanisms  ***********
@@ -157,15 +190,47 @@ int send_tcp_socket(struct monitor_record_t* monitor_record);
 int send_msg_queue(struct monitor_record_t* monitor_record);
 
 //***********  monitoring mechanism  ***********
-void record(DOMAIN_TYPE dom_type,
-            OP_TYPE op_type,
-            int fd,
-            const char* s1,
-            const char* s2,
-            struct timeval* start_time,
-            struct timeval* end_time,
-            int error_code,
-            ssize_t bytes_transferred);
+void record_event(void* caller,
+                  long long offset,
+                  double cpu_time,
+                  DOMAIN_TYPE dom_type,
+                  OP_TYPE op_type,
+                  int fd,
+                  const char* s1,
+                  const char* s2,
+                  struct timeval* start_time,
+                  struct timeval* end_time,
+                  int error_code,
+                  ssize_t bytes_transferred);
+
+// time spent inside intercepted calls (BLOCKED records)
+static long long timeval_usec(const struct timeval* tv);
+static void format_blocked(const long long* blocked_usec, unsigned long long calls,
+                           long long elapsed_usec, char* s1, size_t s1_len,
+                           char* s2, size_t s2_len);
+static void start_thread_blocked(long long start_usec);
+static void end_thread_blocked();
+static void flush_thread_blocked(void* value);
+
+// resource usage of the process (STOP)
+struct resource_snapshot;
+static void take_resource_snapshot(struct resource_snapshot* snapshot);
+static void format_resources(const struct resource_snapshot* start,
+                             const struct resource_snapshot* end,
+                             char* out, size_t out_len);
+
+// CPU time between the two readings in ms, CPU_TIME_NONE if not read
+static double cpu_time_ms(const struct timespec* start, const struct timespec* end);
+
+// every intercepted function records through this macro so that the
+// return address of the intercepted call (i.e., the call site in the
+// monitored application) can be captured for free
+#define record(...) \
+record_event(__builtin_return_address(0), OFFSET_NONE, CPU_TIME(), __VA_ARGS__)
+
+// same for calls that access a known file offset
+#define record_at(offset, ...) \
+record_event(__builtin_return_address(0), offset, CPU_TIME(), __VA_ARGS__)
 
 //***********  file io  ************
 // open
@@ -201,11 +266,21 @@ typedef size_t (*orig_fread_f_type)(void* ptr, size_t size, size_t nmemb, FILE*
 typedef int (*orig_fscanf_f_type)(FILE* stream, const char* format, ...);
 typedef int (*orig_vfscanf_f_type)(FILE* stream, const char* format, va_list ap);
 
+// seek
+typedef off_t (*orig_lseek_f_type)(int fd, off_t offset, int whence);
+typedef off64_t (*orig_lseek64_f_type)(int fd, off64_t offset, int whence);
+typedef int (*orig_fseek_f_type)(FILE* stream, long offset, int whence);
+typedef int (*orig_fseeko_f_type)(FILE* stream, off_t offset, int whence);
+typedef long (*orig_ftell_f_type)(FILE* stream);
+typedef void (*orig_rewind_f_type)(FILE* stream);
+
 // sync
 typedef int (*orig_fsync_f_type)(int fd);
 typedef int (*orig_fdatasync_f_type)(int fd);
 typedef void (*orig_sync_f_type)(void);
 typedef int (*orig_syncfs_f_type)(int fd);
+typedef int (*orig_sync_file_range_f_type)(int fd, off64_t offset, off64_t nbytes,
+                                           unsigned int flags);
 typedef int (*orig_fflush_f_type)(FILE* fp);
 
 
@@ -312,6 +387,23 @@ typedef int (*orig_accept_f_type)(int sockfd, struct sockaddr *addr, socklen_t *
 typedef int (*orig_bind_f_type)(int socket, const struct sockaddr *addr, socklen_t addrlen);
 typedef int (*orig_listen_f_type)(int sockfd, int backlog);
 typedef int (*orig_socket_f_type)(int domain, int type, int protocol);
+
+// processes
+typedef pid_t (*orig_fork_f_type)(void);
+typedef int (*orig_clone_f_type)(int (*fn)(void*), void* stack, int flags,
+                                 void* arg, ...);
+typedef int (*orig_posix_spawn_f_type)(pid_t* pid, const char* path,
+                                       const posix_spawn_file_actions_t* file_actions,
+                                       const posix_spawnattr_t* attrp,
+                                       char* const argv[], char* const envp[]);
+typedef int (*orig_execve_f_type)(const char* path, char* const argv[],
+                                  char* const envp[]);
+typedef int (*orig_fexecve_f_type)(int fd, char* const argv[], char* const envp[]);
+
+// threads
+typedef int (*orig_pthread_create_f_type)(pthread_t* thread, const pthread_attr_t* attr,
+                                          void* (*start_routine)(void*), void* arg);
+typedef int (*orig_pthread_setname_np_f_type)(pthread_t thread, const char* name);
    
 
 // unique identifier to know originator of metrics. defaults to 'u' (unspecified)
@@ -322,6 +414,108 @@ static int paused = 0;
 static int have_elapsed_threshold = 0;
 static double elapsed_threshold = 0.0;
 
+// call-site attribution
+static int capture_caller = 0;
+static int stat_on_open = 0;
+
+// page cache residency probe (mincore) of every Nth open of a regular file
+static unsigned int cache_probe_rate = 0;
+static unsigned int cache_probe_counter = 0;
+// larger files are not probed: the probe maps and checks the whole file
+static const long long CACHE_PROBE_MAX_BYTES = 1024LL * 1024 * 1024;
+
+// filesystem type of each device seen at open, so that fstatfs is called
+// once per device. devices beyond the cache are looked up every time.
+#define MAX_FS_TYPES 64
+static unsigned long fs_type_devs[MAX_FS_TYPES];
+static long fs_types[MAX_FS_TYPES];
+static int num_fs_types = 0;
+static pthread_mutex_t fs_types_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int stack_sample_rate = 0;
+static unsigned int stack_sample_counter = 0;
+static int have_stack_latency_threshold = 0;
+static double stack_latency_threshold = 0.0;
+static __thread int capturing_stack = 0;
+
+// implicit file position of each fd, so that read/write (and stdio)
+// records carry the offset they accessed. OFFSET_NONE where unknown:
+// fds we did not see opened, O_APPEND, after fork (the offset is shared
+// with the other process). for streams it is the position seen by the
+// application, not that of the underlying fd.
+#define MAX_TRACKED_FDS 4096
+static long long fd_positions[MAX_TRACKED_FDS];
+
+// kernel thread id of the current thread, looked up on its first event
+static __thread pid_t thread_id = 0;
+
+// wall time spent inside intercepted calls, per domain (usec). each thread
+// sends its time as a BLOCKED record every blocked_interval_usec (0: only
+// when it ends) and the process totals go with STOP.
+static long long blocked_interval_usec = 10000000LL;
+static long long process_start_usec = 0;
+static long long process_blocked_usec[END_DOMAINS];
+static unsigned long long process_blocked_calls = 0;
+static int process_threads = 0;
+static __thread long long thread_blocked_usec[END_DOMAINS];
+static __thread unsigned long long thread_blocked_calls = 0;
+static __thread long long thread_period_start_usec = 0;
+// its destructor flushes the time of a thread when it ends, whether it
+// returns from its start routine or calls pthread_exit. created once by
+// initialize_monitor, before anything can be recorded.
+static pthread_key_t blocked_key;
+static pthread_once_t blocked_key_once = PTHREAD_ONCE_INIT;
+static int blocked_key_created = 0;
+
+// resource usage of the process when it started (or forked). STOP carries
+// what the process used since: getrusage and the /proc/self/io counters
+// survive exec, so a program exec'ed by another is not charged for what
+// the other one did.
+#define NUM_IO_COUNTERS 7
+static const char* io_counter_names[NUM_IO_COUNTERS] = {
+   "rchar", "wchar", "syscr", "syscw", "read_bytes", "write_bytes", "cancelled_write_bytes"
+};
+struct resource_snapshot {
+   struct rusage usage;
+   long long io[NUM_IO_COUNTERS];
+   int have_io;
+};
+static struct resource_snapshot start_resources;
+
+// tids of threads started through pthread_create, so that names set from
+// another thread (pthread_setname_np on a pthread_t) can be attributed.
+// direct mapped: a collision only loses the name change.
+#define KNOWN_THREADS 256
+static struct {
+   pthread_t thread;
+   pid_t tid;
+} known_threads[KNOWN_THREADS];
+
+// container/cgroup identification
+static char container_id[CONTAINER_ID_LEN];
+static unsigned long mnt_ns = 0;
+
+// getpid() is a system call on current glibc; cache it and refresh it in
+// the child after fork
+static pid_t monitored_pid = 0;
+
+// command line of this process, sent again as the START of forked children
+static char process_cmdline[PATH_MAX];
+
+// this library and the configuration we were started with are passed on
+// to programs that we exec or spawn, even if the application cleared or
+// replaced its environment
+static const char* ENV_LD_PRELOAD = "LD_PRELOAD";
+static const char* ENV_EXEC_START = "IO_MONITOR_EXEC_START";
+static const char* propagated_env_vars[] = {
+   "FACILITY_ID", "MESSAGE_QUEUE_PATH", "MONITOR_DOMAINS", "START_ON_OPEN",
+   "START_ON_ELAPSED", "CAPTURE_CALLER", "STACK_SAMPLE_RATE", "STACK_LATENCY_MS",
+   "STAT_ON_OPEN", "BLOCKED_INTERVAL", "CPU_TIME",
+   "CACHE_PROBE", NULL
+};
+static char monitor_library_path[PATH_MAX];
+static char* saved_env[sizeof(propagated_env_vars) / sizeof(propagated_env_vars[0])];
+static int num_saved_env = 0;
+
 
 // open/close
 static orig_open_f_type orig_open = NULL;
@@ -353,11 +547,20 @@ static orig_fread_f_type orig_fread = NULL;
 static orig_fscanf_f_type orig_fscanf = NULL;
 static orig_vfscanf_f_type orig_vfscanf = NULL;
 
+// seek
+static orig_lseek_f_type orig_lseek = NULL;
+static orig_lseek64_f_type orig_lseek64 = NULL;
+static orig_fseek_f_type orig_fseek = NULL;
+static orig_fseeko_f_type orig_fseeko = NULL;
+static orig_ftell_f_type orig_ftell = NULL;
+static orig_rewind_f_type orig_rewind = NULL;
+
 // sync/flush
 static orig_fsync_f_type orig_fsync = NULL;
 static orig_fdatasync_f_type orig_fdatasync = NULL;
 static orig_sync_f_type orig_sync = NULL;
 static orig_syncfs_f_type orig_syncfs = NULL;
+static orig_sync_file_range_f_type orig_sync_file_range = NULL;
 static orig_fflush_f_type orig_fflush = NULL;
 
 // xattrs
@@ -420,6 +623,20 @@ static orig_bind_f_type orig_bind = NULL;
 static orig_listen_f_type orig_listen = NULL;
 static orig_socket_f_type orig_socket = NULL;
 
+// processes
+static orig_fork_f_type orig_fork = NULL;
+static orig_fork_f_type orig_vfork = NULL;
+static orig_clone_f_type orig_clone = NULL;
+static orig_posix_spawn_f_type orig_posix_spawn = NULL;
+static orig_posix_spawn_f_type orig_posix_spawnp = NULL;
+static orig_execve_f_type orig_execve = NULL;
+static orig_execve_f_type orig_execvpe = NULL;
+static orig_fexecve_f_type orig_fexecve = NULL;
+
+// threads
+static orig_pthread_create_f_type orig_pthread_create = NULL;
+static orig_pthread_setname_np_f_type orig_pthread_setname_np = NULL;
+
 void load_library_functions();
 
 #define CHECK_LOADED_FNS() \
@@ -451,12 +668,36 @@ __attribute__((constructor)) void init() {
    /* here retrieve actual path */
 
    GET_END_TIME();
+   strncpy(process_cmdline, cmdline, sizeof(process_cmdline) - 1);
+   process_start_usec = timeval_usec(&start_time);
+   take_resource_snapshot(&start_resources);
+   if (thread_period_start_usec == 0) {
+      start_thread_blocked(process_start_usec);
+   }
 
    char ppid[10];
    sprintf(ppid, "%d", getppid());
    record(START_STOP, START, 0, cmdline, ppid,
           TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
-   
+
+   // we were exec'ed by a monitored program. record the exec on its
+   // behalf, from the exec call in the old program until now, so that
+   // loading and linking the new program is part of its latency.
+   const char* exec_start = getenv(ENV_EXEC_START);
+   if (exec_start != NULL) {
+      const long long exec_usec = atoll(exec_start);
+      char exe_path[PATH_MAX];
+      ssize_t exe_len;
+
+      unsetenv(ENV_EXEC_START);
+      start_time.tv_sec = exec_usec / 1000000LL;
+      start_time.tv_usec = exec_usec % 1000000LL;
+      GET_END_TIME()
+      exe_len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+      exe_path[(exe_len > 0) ? exe_len : 0] = '\0';
+      record(PROCESSES, EXEC, FD_NONE, exe_path, NULL,
+             TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
+   }
 }
 
 //*****************************************************************************
@@ -466,12 +707,31 @@ __attribute__((destructor))  void fini() {
    DECL_VARS()
    GET_START_TIME()
    CHECK_LOADED_FNS();
-   /* collect CPU usage, brk/heap size metrics from /proc */
-
+   char stop_s1[PATH_MAX];
+   char stop_s2[STR_LEN];
+   long long blocked_usec[END_DOMAINS];
+   struct resource_snapshot end_resources;
+   size_t len;
+   int d;
+
+   end_thread_blocked();
+   take_resource_snapshot(&end_resources);
+   for (d = 0; d < END_DOMAINS; ++d) {
+      blocked_usec[d] = __atomic_load_n(&process_blocked_usec[d], __ATOMIC_RELAXED);
+   }
    GET_END_TIME();
+   format_blocked(blocked_usec, __atomic_load_n(&process_blocked_calls, __ATOMIC_RELAXED),
+                  timeval_usec(&end_time) - process_start_usec,
+                  stop_s1, sizeof(stop_s1), stop_s2, sizeof(stop_s2));
+   snprintf(stop_s2 + strlen(stop_s2), sizeof(stop_s2) - strlen(stop_s2),
+            " threads=%d", __atomic_load_n(&process_threads, __ATOMIC_RELAXED));
+   len = strlen(stop_s1);
+   if (len > 0 && len < sizeof(stop_s1) - 1) {
+      stop_s1[len++] = ' ';
+   }
+   format_resources(&start_resources, &end_resources, stop_s1 + len, sizeof(stop_s1) - len);
 
-   
-   record(START_STOP, STOP, 0, NULL, NULL,
+   record(START_STOP, STOP, 0, stop_s1, stop_s2,
           TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
    //TODO: let collector know that we're done?
 }
@@ -497,6 +757,35 @@ void load_library_functions() {
       }
    }
 
+   stat_on_open = (getenv(ENV_STAT_ON_OPEN) != NULL);
+   const char* cache_probe = getenv(ENV_CACHE_PROBE);
+   if (cache_probe != NULL) {
+      cache_probe_rate = (unsigned int) atoi(cache_probe);
+   }
+   capture_cpu_time = (getenv(ENV_CPU_TIME) != NULL);
+   const char* blocked_interval = getenv(ENV_BLOCKED_INTERVAL);
+   if (blocked_interval != NULL) {
+      blocked_interval_usec = (long long) (atof(blocked_interval) * 1000000.0);
+   }
+   capture_caller = (getenv(ENV_CAPTURE_CALLER) != NULL);
+   if (capture_caller) {
+      const char* sample_rate = getenv(ENV_STACK_SAMPLE_RATE);
+      const char* latency_ms = getenv(ENV_STACK_LATENCY_MS);
+      if (sample_rate != NULL) {
+         stack_sample_rate = (unsigned int) atoi(sample_rate);
+      }
+      if (latency_ms != NULL) {
+         stack_latency_threshold = atof(latency_ms);
+         have_stack_latency_threshold = 1;
+      }
+      if (stack_sample_rate > 0 || have_stack_latency_threshold) {
+         // the first call to backtrace loads libgcc_s. get that out of
+         // the way now rather than in the middle of an intercepted call.
+         void* frame;
+         backtrace(&frame, 1);
+      }
+   }
+
    // open/close
    orig_open = (orig_open_f_type)dlsym(RTLD_NEXT,"open");
    orig_open64 = (orig_open64_f_type)dlsym(RTLD_NEXT,"open64");
@@ -527,12 +816,21 @@ void load_library_functions() {
    orig_fscanf = (orig_fscanf_f_type)dlsym(RTLD_NEXT,"fscanf");
    orig_vfscanf = (orig_vfscanf_f_type)dlsym(RTLD_NEXT,"vfscanf");
 
+   // seek
+   orig_lseek = (orig_lseek_f_type)dlsym(RTLD_NEXT,"lseek");
+   orig_lseek64 = (orig_lseek64_f_type)dlsym(RTLD_NEXT,"lseek64");
+   orig_fseek = (orig_fseek_f_type)dlsym(RTLD_NEXT,"fseek");
+   orig_fseeko = (orig_fseeko_f_type)dlsym(RTLD_NEXT,"fseeko");
+   orig_ftell = (orig_ftell_f_type)dlsym(RTLD_NEXT,"ftell");
+   orig_rewind = (orig_rewind_f_type)dlsym(RTLD_NEXT,"rewind");
+
    // sync
    orig_fsync = (orig_fsync_f_type)dlsym(RTLD_NEXT,"fsync");
    orig_fdatasync = (orig_fdatasync_f_type)dlsym(RTLD_NEXT,"fdatasync");
    orig_fflush = (orig_fflush_f_type)dlsym(RTLD_NEXT,"fflush");
    orig_sync = (orig_sync_f_type)dlsym(RTLD_NEXT,"sync");
    orig_syncfs = (orig_syncfs_f_type)dlsym(RTLD_NEXT,"syncfs");
+   orig_sync_file_range = (orig_sync_file_range_f_type)dlsym(RTLD_NEXT,"sync_file_range");
 
    // xattrs
    orig_setxattr = (orig_setxattr_f_type)dlsym(RTLD_NEXT,"setxattr");
@@ -594,6 +892,21 @@ void load_library_functions() {
    orig_listen = (orig_listen_f_type)dlsym(RTLD_NEXT,"listen");
    orig_socket = (orig_socket_f_type)dlsym(RTLD_NEXT,"socket");
 
+   // processes
+   orig_fork = (orig_fork_f_type)dlsym(RTLD_NEXT,"fork");
+   orig_vfork = (orig_fork_f_type)dlsym(RTLD_NEXT,"vfork");
+   orig_clone = (orig_clone_f_type)dlsym(RTLD_NEXT,"clone");
+   orig_posix_spawn = (orig_posix_spawn_f_type)dlsym(RTLD_NEXT,"posix_spawn");
+   orig_posix_spawnp = (orig_posix_spawn_f_type)dlsym(RTLD_NEXT,"posix_spawnp");
+   orig_execve = (orig_execve_f_type)dlsym(RTLD_NEXT,"execve");
+   orig_execvpe = (orig_execve_f_type)dlsym(RTLD_NEXT,"execvpe");
+   orig_fexecve = (orig_fexecve_f_type)dlsym(RTLD_NEXT,"fexecve");
+
+   // threads
+   orig_pthread_create = (orig_pthread_create_f_type)dlsym(RTLD_NEXT,"pthread_create");
+   orig_pthread_setname_np =
+      (orig_pthread_setname_np_f_type)dlsym(RTLD_NEXT,"pthread_setname_np");
+
 }
 
 //*****************************************************************************
@@ -621,7 +934,92 @@ unsigned int domain_list_to_bit_mask(const char* domain_list)
 
 //*****************************************************************************
 
+// derive a short id for the container (or cgroup) we run in from
+// /proc/self/cgroup. container runtimes put a 64 hex digit id in the
+// cgroup path (docker, containerd, cri-o, podman); we use the first 12
+// digits like "docker ps" does. otherwise the last component of the
+// cgroup path is used, and processes in the root cgroup (host processes,
+// or containers with their own cgroup namespace) are identified by their
+// mount namespace.
+void identify_container() {
+   char buffer[4096];
+   char link[64];
+   const char* cgroup_path = NULL;
+   char* line;
+   char* rest;
+   ssize_t len;
+   int fd;
+
+   memset(container_id, 0, sizeof(container_id));
+
+   len = readlink("/proc/self/ns/mnt", link, sizeof(link) - 1);
+   if (len > 0) {
+      link[len] = '\0';
+      sscanf(link, "mnt:[%lu]", &mnt_ns);
+   }
+
+   fd = orig_open("/proc/self/cgroup", O_RDONLY);
+   if (fd < 0) {
+      return;
+   }
+   len = orig_read(fd, buffer, sizeof(buffer) - 1);
+   orig_close(fd);
+   if (len <= 0) {
+      return;
+   }
+   buffer[len] = '\0';
+
+   // lines look like "hierarchy-id:controllers:path". prefer the unified
+   // (cgroup v2) hierarchy, then the first v1 hierarchy not at the root.
+   rest = buffer;
+   while ((line = strtok_r(rest, "\n", &rest))) {
+      char* path = strchr(line, ':');
+      path = (path != NULL) ? strchr(path + 1, ':') : NULL;
+      if (path == NULL || !strcmp(path + 1, "/")) {
+         continue;
+      }
+      if (!strncmp(line, "0::", 3) || cgroup_path == NULL) {
+         cgroup_path = path + 1;
+      }
+   }
+
+   if (cgroup_path != NULL) {
+      const char* p;
+      int hex_digits = 0;
+
+      for (p = cgroup_path; *p; ++p) {
+         if ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f')) {
+            if (++hex_digits == 64) {
+               strncpy(container_id, p - 63, 12);
+               return;
+            }
+         } else {
+            hex_digits = 0;
+         }
+      }
+
+      p = strrchr(cgroup_path, '/');
+      strncpy(container_id, (p != NULL) ? p + 1 : cgroup_path,
+              sizeof(container_id) - 1);
+   } else {
+      snprintf(container_id, sizeof(container_id), "mnt-%lu", mnt_ns);
+   }
+}
+
+//*****************************************************************************
+
+static void create_blocked_key()
+{
+   if (pthread_key_create(&blocked_key, flush_thread_blocked) == 0) {
+      __atomic_store_n(&blocked_key_created, 1, __ATOMIC_RELEASE);
+   }
+}
+
+//*****************************************************************************
+
 void initialize_monitor() {
+   pthread_once(&blocked_key_once, create_blocked_key);
+
    // establish facility id
    memset(facility, 0, sizeof(facility));
    const char* facility_id = getenv(ENV_FACILITY_ID);
@@ -646,6 +1044,79 @@ void initialize_monitor() {
    }
 
    load_library_functions();
+   identify_container();
+   save_monitor_environment();
+
+   reset_fd_positions();
+   monitored_pid = getpid();
+   pthread_atfork(NULL, NULL, after_fork_child);
+}
+
+//*****************************************************************************
+
+// remember where this library was loaded from and our configuration so
+// that both can be passed on to exec'ed and spawned programs
+void save_monitor_environment() {
+   Dl_info info;
+   char* value;
+   int i;
+
+   if (dladdr((void*) save_monitor_environment, &info) && info.dli_fname != NULL) {
+      strncpy(monitor_library_path, info.dli_fname, sizeof(monitor_library_path) - 1);
+   }
+
+   for (i = 0; propagated_env_vars[i] != NULL; ++i) {
+      value = getenv(propagated_env_vars[i]);
+      if (value != NULL) {
+         const size_t len = strlen(propagated_env_vars[i]) + strlen(value) + 2;
+         saved_env[num_saved_env] = malloc(len);
+         if (saved_env[num_saved_env] != NULL) {
+            snprintf(saved_env[num_saved_env], len, "%s=%s",
+                     propagated_env_vars[i], value);
+            num_saved_env++;
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+
+// runs in the child of fork() and vfork() (and of clone() without
+// CLONE_VM). the child starts with a copy of all of our state; whatever
+// is per process is reset here. the message queue id is system wide and
+// stays valid. the child then announces itself with a START that carries
+// the parent's command line, since it has no constructor run of its own.
+static void after_fork_child()
+{
+   DECL_VARS()
+   GET_START_TIME()
+   char ppid[16];
+
+   snprintf(ppid, sizeof(ppid), "%d", monitored_pid);
+   monitored_pid = getpid();
+   thread_id = 0;
+   memset(known_threads, 0, sizeof(known_threads));
+   reset_fd_positions();
+   failed_socket_connections = 0;
+   failed_ipc_sends = 0;
+   socket_fd = FD_NONE;
+   stack_sample_counter = 0;
+   capturing_stack = 0;
+   // another thread may have held it when the process forked
+   pthread_mutex_init(&fs_types_lock, NULL);
+   // the forking thread is the only thread of the child
+   process_start_usec = timeval_usec(&start_time);
+   memset(process_blocked_usec, 0, sizeof(process_blocked_usec));
+   process_blocked_calls = 0;
+   process_threads = 1;
+   memset(thread_blocked_usec, 0, sizeof(thread_blocked_usec));
+   thread_blocked_calls = 0;
+   thread_period_start_usec = process_start_usec;
+   take_resource_snapshot(&start_resources);
+
+   GET_END_TIME()
+   record(START_STOP, START, 0, process_cmdline, ppid,
+          TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
 }
 
 //*****************************************************************************
@@ -752,25 +1223,344 @@ int send_tcp_socket(struct monitor_record_t* monitor_record)
 
 //*****************************************************************************
 
+// capture a short stack for the current event. frames belonging to the
+// monitor itself (record_event, the wrapper) are dropped by looking for
+// the caller's return address in the unwound stack.
+static int capture_stack(void* caller, unsigned long* stack)
+{
+   void* frames[MAX_STACK_FRAMES + 4];
+   int depth;
+   int first = -1;
+   int i;
+
+   if (capturing_stack) {
+      return 0;
+   }
+
+   capturing_stack = 1;
+   depth = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+   capturing_stack = 0;
+
+   for (i = 0; i < depth; ++i) {
+      if (frames[i] == caller) {
+         first = i;
+         break;
+      }
+   }
+   if (first < 0) {
+      // caller not found (inlined or tail called); skip our two frames
+      first = (depth > 2) ? 2 : depth;
+   }
+
+   for (i = 0; (i < MAX_STACK_FRAMES) && (first + i < depth); ++i) {
+      stack[i] = (unsigned long) frames[first + i];
+   }
+   return i;
+}
+
+//*****************************************************************************
+
+static int should_capture_stack(double elapsed_time)
+{
+   if (have_stack_latency_threshold && (elapsed_time >= stack_latency_threshold)) {
+      return 1;
+   }
+   if (stack_sample_rate > 0 && ((++stack_sample_counter % stack_sample_rate) == 0)) {
+      return 1;
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+static int should_probe_cache(int fd, const struct stat* file_stat)
+{
+   int access_mode;
+
+   if (cache_probe_rate == 0 || file_stat->st_size == 0 ||
+       file_stat->st_size > CACHE_PROBE_MAX_BYTES) {
+      return 0;
+   }
+   // the mapping needs read access. since linux 5.2 mincore only tells
+   // about the page cache of files the caller owns or may write; for
+   // others it reports every page as resident.
+   access_mode = fcntl(fd, F_GETFL) & O_ACCMODE;
+   if (access_mode == O_WRONLY ||
+       (access_mode != O_RDWR && file_stat->st_uid != geteuid() && geteuid() != 0)) {
+      return 0;
+   }
+   return (++cache_probe_counter % cache_probe_rate) == 0;
+}
+
+//*****************************************************************************
+
+// statfs f_type of the filesystem holding fd, 0 if unknown
+static long fs_type(int fd, unsigned long dev)
+{
+   struct statfs fs_stat;
+   long type = 0;
+   int i;
+
+   pthread_mutex_lock(&fs_types_lock);
+   for (i = 0; i < num_fs_types; ++i) {
+      if (fs_type_devs[i] == dev) {
+         type = fs_types[i];
+         break;
+      }
+   }
+   pthread_mutex_unlock(&fs_types_lock);
+   if (type != 0) {
+      return type;
+   }
+
+   if (fstatfs(fd, &fs_stat) != 0) {
+      return 0;
+   }
+   type = (long) fs_stat.f_type;
+
+   pthread_mutex_lock(&fs_types_lock);
+   for (i = 0; i < num_fs_types && fs_type_devs[i] != dev; ++i) {
+   }
+   if (i == num_fs_types && num_fs_types < MAX_FS_TYPES) {
+      fs_type_devs[num_fs_types] = dev;
+      fs_types[num_fs_types] = type;
+      num_fs_types++;
+   }
+   pthread_mutex_unlock(&fs_types_lock);
+   return type;
+}
+
+//*****************************************************************************
+
+static long long timeval_usec(const struct timeval* tv)
+{
+   return tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+//*****************************************************************************
+
+static double cpu_time_ms(const struct timespec* start, const struct timespec* end)
+{
+   if ((start->tv_sec == 0 && start->tv_nsec == 0) ||
+       (end->tv_sec == 0 && end->tv_nsec == 0)) {
+      return CPU_TIME_NONE;
+   }
+   return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+//*****************************************************************************
+
+// blocked time as sent in BLOCKED and STOP records: the time per domain
+// in s1 ("FILE_READ=12.500 SYNCS=3.250", ms) and the totals in s2
+static void format_blocked(const long long* blocked_usec, unsigned long long calls,
+                           long long elapsed_usec, char* s1, size_t s1_len,
+                           char* s2, size_t s2_len)
+{
+   long long total_usec = 0;
+   size_t len = 0;
+   int d;
+
+   s1[0] = '\0';
+   for (d = 0; d < START_STOP; ++d) {
+      if (blocked_usec[d] > 0 && len < s1_len) {
+         len += snprintf(s1 + len, s1_len - len, "%s%s=%.3f", len ? " " : "",
+                         domains_names[d], blocked_usec[d] / 1000.0);
+      }
+      total_usec += blocked_usec[d];
+   }
+   snprintf(s2, s2_len, "blocked=%.3f elapsed=%.3f calls=%llu",
+            total_usec / 1000.0, elapsed_usec / 1000.0, calls);
+}
+
+//*****************************************************************************
+
+// sends the blocked time of this thread since its last BLOCKED record
+static void record_thread_blocked(long long end_usec)
+{
+   struct timeval start_time, end_time;
+   char s1[PATH_MAX];
+   char s2[STR_LEN];
+
+   if (thread_period_start_usec == 0 || end_usec <= thread_period_start_usec) {
+      return;
+   }
+   format_blocked(thread_blocked_usec, thread_blocked_calls,
+                  end_usec - thread_period_start_usec, s1, sizeof(s1), s2, sizeof(s2));
+   start_time.tv_sec = thread_period_start_usec / 1000000LL;
+   start_time.tv_usec = thread_period_start_usec % 1000000LL;
+   end_time.tv_sec = end_usec / 1000000LL;
+   end_time.tv_usec = end_usec % 1000000LL;
+
+   memset(thread_blocked_usec, 0, sizeof(thread_blocked_usec));
+   thread_blocked_calls = 0;
+   thread_period_start_usec = end_usec;
+
+   record_event(__builtin_return_address(0), OFFSET_NONE, CPU_TIME_NONE, START_STOP, BLOCKED, 0,
+                s1, s2, TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
+}
+
+//*****************************************************************************
+
+static void account_blocked(DOMAIN_TYPE dom_type, const struct timeval* start_time,
+                            const struct timeval* end_time)
+{
+   const long long start_usec = timeval_usec(start_time);
+   const long long end_usec = timeval_usec(end_time);
+
+   if (dom_type < 0 || dom_type >= START_STOP || paused ||
+       0 == (domain_bit_flags & (1 << dom_type))) {
+      return;
+   }
+
+   if (thread_period_start_usec == 0) {
+      // threads that did not start through pthread_create (or did so
+      // before we were loaded) are counted from their first call
+      start_thread_blocked(start_usec);
+      if (thread_period_start_usec == 0) {
+         return;
+      }
+   }
+   thread_blocked_usec[dom_type] += end_usec - start_usec;
+   thread_blocked_calls++;
+   __atomic_fetch_add(&process_blocked_usec[dom_type], end_usec - start_usec, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&process_blocked_calls, 1, __ATOMIC_RELAXED);
+
+   if (blocked_interval_usec > 0 &&
+       end_usec - thread_period_start_usec >= blocked_interval_usec) {
+      record_thread_blocked(end_usec);
+   }
+}
+
+//*****************************************************************************
+
+static void start_thread_blocked(long long start_usec)
+{
+   // without the key the time of the thread could not be flushed
+   if (!__atomic_load_n(&blocked_key_created, __ATOMIC_ACQUIRE)) {
+      return;
+   }
+   thread_period_start_usec = start_usec;
+   __atomic_fetch_add(&process_threads, 1, __ATOMIC_RELAXED);
+   // any non-NULL value, so that the destructor runs
+   pthread_setspecific(blocked_key, &blocked_key);
+}
+
+//*****************************************************************************
+
+// the thread ends (or the process stops): send what is left
+static void end_thread_blocked()
+{
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   record_thread_blocked(timeval_usec(&now));
+   thread_period_start_usec = 0;
+}
+
+//*****************************************************************************
+
+static void flush_thread_blocked(void* value)
+{
+   end_thread_blocked();
+}
+
+//*****************************************************************************
+
+static void take_resource_snapshot(struct resource_snapshot* snapshot)
+{
+   char buffer[512];
+   char* line;
+   char* save = NULL;
+   ssize_t len;
+   int fd;
+   int i;
+
+   memset(snapshot, 0, sizeof(struct resource_snapshot));
+   getrusage(RUSAGE_SELF, &snapshot->usage);
+
+   // not available without CONFIG_TASK_IO_ACCOUNTING
+   fd = orig_open("/proc/self/io", O_RDONLY);
+   if (fd < 0) {
+      return;
+   }
+   len = orig_read(fd, buffer, sizeof(buffer) - 1);
+   orig_close(fd);
+   if (len <= 0) {
+      return;
+   }
+   buffer[len] = '\0';
+   for (line = strtok_r(buffer, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save)) {
+      for (i = 0; i < NUM_IO_COUNTERS; ++i) {
+         const size_t name_len = strlen(io_counter_names[i]);
+         if (!strncmp(line, io_counter_names[i], name_len) && line[name_len] == ':') {
+            snapshot->io[i] = atoll(line + name_len + 1);
+            break;
+         }
+      }
+   }
+   snapshot->have_io = 1;
+}
+
+//*****************************************************************************
+
+static double timeval_ms(const struct timeval* tv)
+{
+   return tv->tv_sec * 1000.0 + tv->tv_usec / 1000.0;
+}
+
+// "utime=12.000 stime=3.000 minflt=... maxrss=... rchar=..." (ms, KiB, bytes)
+static void format_resources(const struct resource_snapshot* start,
+                             const struct resource_snapshot* end,
+                             char* out, size_t out_len)
+{
+   const struct rusage* a = &start->usage;
+   const struct rusage* b = &end->usage;
+   size_t len;
+   int i;
+
+   len = snprintf(out, out_len,
+                  "utime=%.3f stime=%.3f minflt=%ld majflt=%ld inblock=%ld oublock=%ld "
+                  "nvcsw=%ld nivcsw=%ld maxrss=%ld",
+                  timeval_ms(&b->ru_utime) - timeval_ms(&a->ru_utime),
+                  timeval_ms(&b->ru_stime) - timeval_ms(&a->ru_stime),
+                  b->ru_minflt - a->ru_minflt, b->ru_majflt - a->ru_majflt,
+                  b->ru_inblock - a->ru_inblock, b->ru_oublock - a->ru_oublock,
+                  b->ru_nvcsw - a->ru_nvcsw, b->ru_nivcsw - a->ru_nivcsw, b->ru_maxrss);
+   if (!start->have_io || !end->have_io) {
+      return;
+   }
+   for (i = 0; i < NUM_IO_COUNTERS && len < out_len; ++i) {
+      len += snprintf(out + len, out_len - len, " %s=%lld", io_counter_names[i],
+                      end->io[i] - start->io[i]);
+   }
+}
+
+//*****************************************************************************
+
 #define RECORD_FIELD(f) record_output. f = f
 #define RECORD_FIELD_S(f) if (f) {strncpy(record_output.f, f, sizeof(record_output.f)); \
     record_output.f[sizeof(record_output.f)-1] = 0; }
 
-void record(DOMAIN_TYPE dom_type,
-            OP_TYPE op_type,
-            int fd,
-            const char* s1,
-            const char* s2,
-            struct timeval* start_time,
-            struct timeval* end_time,
-            int error_code,
-            ssize_t bytes_transferred)
+void record_event(void* caller,
+                  long long offset,
+                  double cpu_time,
+                  DOMAIN_TYPE dom_type,
+                  OP_TYPE op_type,
+                  int fd,
+                  const char* s1,
+                  const char* s2,
+                  struct timeval* start_time,
+                  struct timeval* end_time,
+                  int error_code,
+                  ssize_t bytes_transferred)
 {
    struct monitor_record_t record_output;
    unsigned long timestamp;
+   long long start_usec;
    int rc_ipc;
    int record_length;
    pid_t pid;
+   pid_t tid;
    double elapsed_time;
 
    // have we already tried to connect to our peer and failed?
@@ -789,6 +1579,9 @@ void record(DOMAIN_TYPE dom_type,
       return;
    }
 
+   // time blocked counts calls on any fd
+   account_blocked(dom_type, start_time, end_time);
+
    // ignore reporting on stdin, stdout, stderr
    if ((fd > -1) && (fd < 3) && dom_type != START_STOP) {
       return;
@@ -802,7 +1595,7 @@ void record(DOMAIN_TYPE dom_type,
       return;
    }
 
-   if (op_type == OPEN) {
+   if (op_type == OPEN && s1 != NULL) {
       if (!strcmp(s1, ".")) {
          // ignore open of current directory
          return;
@@ -835,22 +1628,58 @@ void record(DOMAIN_TYPE dom_type,
    }
 
    timestamp = (unsigned long)time(NULL);
-   pid = getpid();
+   start_usec = start_time->tv_sec * 1000000LL + start_time->tv_usec;
+   pid = monitored_pid;
+   if (thread_id == 0) {
+      thread_id = syscall(SYS_gettid);
+   }
+   tid = thread_id;
 
    bzero(&record_output, sizeof(record_output));
 
    RECORD_FIELD_S(facility);
    RECORD_FIELD(timestamp);
+   RECORD_FIELD(start_usec);
    RECORD_FIELD(elapsed_time);
+   RECORD_FIELD(cpu_time);
    RECORD_FIELD(pid);
+   RECORD_FIELD(tid);
+   snprintf(record_output.container_id, sizeof(record_output.container_id), "%s", container_id);
+   RECORD_FIELD(mnt_ns);
    RECORD_FIELD(dom_type);
    RECORD_FIELD(op_type);
    RECORD_FIELD(error_code);
    RECORD_FIELD(fd);
    RECORD_FIELD(bytes_transferred);
+   RECORD_FIELD(offset);
    RECORD_FIELD_S(s1);
    RECORD_FIELD_S(s2);
-   
+
+   record_output.file_size = -1;
+   record_output.resident_bytes = -1;
+   if ((stat_on_open || cache_probe_rate > 0) && op_type == OPEN && fd >= 0 &&
+       error_code == 0) {
+      struct stat file_stat;
+      if (orig_fstat(fd, &file_stat) == 0) {
+         if (S_ISREG(file_stat.st_mode)) {
+            record_output.file_size = file_stat.st_size;
+            if (should_probe_cache(fd, &file_stat)) {
+               record_output.resident_bytes = residency_bytes(fd, file_stat.st_size);
+            }
+         }
+         record_output.inode = file_stat.st_ino;
+         record_output.dev = file_stat.st_dev;
+         record_output.fs_type = fs_type(fd, file_stat.st_dev);
+      }
+   }
+
+   if (capture_caller) {
+      record_output.caller = (unsigned long) caller;
+      if (should_capture_stack(elapsed_time)) {
+         record_output.stack_depth = capture_stack(caller, record_output.stack);
+      }
+   }
+
    if (message_queue_path != NULL) {
       rc_ipc = send_msg_queue(&record_output);
    } else {
@@ -865,21 +1694,95 @@ void record(DOMAIN_TYPE dom_type,
 
 //*****************************************************************************
 
+static void reset_fd_positions()
+{
+   int fd;
+
+   for (fd = 0; fd < MAX_TRACKED_FDS; ++fd) {
+      fd_positions[fd] = OFFSET_NONE;
+   }
+}
+
+//*****************************************************************************
+
+static void set_fd_position(int fd, long long position)
+{
+   if (fd >= 0 && fd < MAX_TRACKED_FDS) {
+      fd_positions[fd] = (position >= 0) ? position : OFFSET_NONE;
+   }
+}
+
+//*****************************************************************************
+
+// position of fd before a read or write of the given result, which then
+// moves it forward
+static long long advance_fd_position(int fd, ssize_t bytes)
+{
+   long long position;
+
+   if (fd < 0 || fd >= MAX_TRACKED_FDS) {
+      return OFFSET_NONE;
+   }
+   position = fd_positions[fd];
+   if (position != OFFSET_NONE && bytes > 0) {
+      fd_positions[fd] = position + bytes;
+   }
+   return position;
+}
+
+//*****************************************************************************
+
+// open flags are recorded in s2 in octal, as in fcntl.h
+static void format_open_flags(int flags, char* out, size_t out_len)
+{
+   snprintf(out, out_len, "0%o", flags);
+}
+
+//*****************************************************************************
+
+// the mode argument is only passed (and only valid) when a file may be
+// created
+#ifdef O_TMPFILE
+#define OPEN_MODE(flags, mode) \
+   if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) { \
+      va_list ap; \
+      va_start(ap, flags); \
+      mode = va_arg(ap, int); \
+      va_end(ap); \
+   }
+#else
+#define OPEN_MODE(flags, mode) \
+   if (flags & O_CREAT) { \
+      va_list ap; \
+      va_start(ap, flags); \
+      mode = va_arg(ap, int); \
+      va_end(ap); \
+   }
+#endif
+
+//*****************************************************************************
+
 int open(const char* pathname, int flags, ...)
 {
    CHECK_LOADED_FNS()
    PUTS("open")
    DECL_VARS()
+   mode_t mode = 0;
+   char flags_text[16];
+   OPEN_MODE(flags, mode)
    GET_START_TIME()
-   const int fd = orig_open(pathname, flags);
+   const int fd = orig_open(pathname, flags, mode);
    GET_END_TIME()
 
    if (fd == -1) {
       error_code = errno;
+   } else {
+      set_fd_position(fd, (flags & O_APPEND) ? OFFSET_NONE : 0);
    }
 
    char* real_path = realpath(pathname, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, NULL,
+   format_open_flags(flags, flags_text, sizeof(flags_text));
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : pathname, flags_text,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -893,16 +1796,22 @@ int open64(const char* pathname, int flags, ...)
    CHECK_LOADED_FNS()
    PUTS("open64")
    DECL_VARS()
+   mode_t mode = 0;
+   char flags_text[16];
+   OPEN_MODE(flags, mode)
    GET_START_TIME()
-   const int fd = orig_open64(pathname, flags);
+   const int fd = orig_open64(pathname, flags, mode);
    GET_END_TIME()
 
    if (fd == -1) {
       error_code = errno;
+   } else {
+      set_fd_position(fd, (flags & O_APPEND) ? OFFSET_NONE : 0);
    }
 
    char* real_path = realpath(pathname, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, NULL,
+   format_open_flags(flags, flags_text, sizeof(flags_text));
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : pathname, flags_text,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -916,16 +1825,20 @@ int creat(const char* pathname, mode_t mode)
    CHECK_LOADED_FNS()
    PUTS("creat")
    DECL_VARS()
+   char flags_text[16];
    GET_START_TIME()
    const int fd = orig_creat(pathname, mode);
    GET_END_TIME()
 
    if (fd == -1) {
       error_code = errno;
+   } else {
+      set_fd_position(fd, 0);
    }
 
    char* real_path = realpath(pathname, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, NULL,
+   format_open_flags(O_CREAT | O_WRONLY | O_TRUNC, flags_text, sizeof(flags_text));
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : pathname, flags_text,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -939,16 +1852,20 @@ int creat64(const char* pathname, mode_t mode)
    CHECK_LOADED_FNS()
    PUTS("creat64")
    DECL_VARS()
+   char flags_text[16];
    GET_START_TIME()
    const int fd = orig_creat64(pathname, mode);
    GET_END_TIME()
 
    if (fd == -1) {
       error_code = errno;
+   } else {
+      set_fd_position(fd, 0);
    }
 
    char* real_path = realpath(pathname, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, NULL,
+   format_open_flags(O_CREAT | O_WRONLY | O_TRUNC, flags_text, sizeof(flags_text));
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : pathname, flags_text,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -965,6 +1882,7 @@ int close(int fd)
    GET_START_TIME()
    const int rc = orig_close(fd);
    GET_END_TIME()
+   set_fd_position(fd, OFFSET_NONE);
 
    if (rc != 0) {
       error_code = errno;
@@ -987,6 +1905,7 @@ int fclose(FILE* fp)
    const int fd = fileno(fp);
    const int rc = orig_fclose(fp);
    GET_END_TIME()
+   set_fd_position(fd, OFFSET_NONE);
 
    if (rc != 0) {
       error_code = errno;
@@ -1001,7 +1920,7 @@ int fclose(FILE* fp)
 //*****************************************************************************
 
 
-void check_for_http(int dom, int fd, const char* buf, size_t count, struct timeval *s, struct timeval *e)
+void check_for_http(void* caller, int dom, int fd, const char* buf, size_t count, struct timeval *s, struct timeval *e)
 {
   char buffer1[PATH_MAX];
   char buffer2[STR_LEN];
@@ -1049,10 +1968,10 @@ void check_for_http(int dom, int fd, const char* buf, size_t count, struct timev
       || (!strncmp("POST ", buffer1, 5))
       || (!strncmp("DELETE ", buffer1, 7))) {
     if (dom == FILE_WRITE) {
-      record(HTTP, HTTP_REQ_SEND, fd, buffer1, buffer2,
+      record_event(caller, OFFSET_NONE, CPU_TIME_NONE, HTTP, HTTP_REQ_SEND, fd, buffer1, buffer2,
 	     s, e, 0, 0);
     } else {
-      record(HTTP, HTTP_REQ_RECV, fd, buffer1, buffer2,
+      record_event(caller, OFFSET_NONE, CPU_TIME_NONE, HTTP, HTTP_REQ_RECV, fd, buffer1, buffer2,
 	     s, e, 0, 0);
     }
   }
@@ -1072,9 +1991,10 @@ ssize_t write(int fd, const void* buf, size_t count)
       error_code = errno;
    }
 
-   record(FILE_WRITE, WRITE, fd, NULL, NULL,
+   const long long offset = advance_fd_position(fd, bytes_written);
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
-   check_for_http(FILE_WRITE, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
+   check_for_http(__builtin_return_address(0), FILE_WRITE, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
    return bytes_written;
 }
 
@@ -1095,7 +2015,7 @@ ssize_t send(int fd, const void* buf, size_t count, int flags)
 
    record(FILE_WRITE, WRITE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
-   check_for_http(FILE_WRITE, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
+   check_for_http(__builtin_return_address(0), FILE_WRITE, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
    return bytes_written;
 }
 
@@ -1115,7 +2035,7 @@ ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset)
       error_code = errno;
    }
 
-   record(FILE_WRITE, WRITE, fd, NULL, NULL,
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
 
    return bytes_written;
@@ -1136,7 +2056,8 @@ ssize_t writev(int fd, const struct iovec* iov, int iovcnt)
       error_code = errno;
    }
 
-   record(FILE_WRITE, WRITE, fd, NULL, NULL,
+   const long long offset = advance_fd_position(fd, bytes_written);
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
 
    return bytes_written;
@@ -1157,7 +2078,7 @@ ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
       error_code = errno;
    }
 
-   record(FILE_WRITE, WRITE, fd, NULL, NULL,
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
 
    return bytes_written;
@@ -1165,6 +2086,26 @@ ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
 
 //*****************************************************************************
 
+// reads and writes through stdio carry the function and the buffering of
+// the stream in s2 ("fwrite buf=4096", "fprintf buf=line", "fread
+// buf=none"): calls on unbuffered and line-buffered streams typically
+// turn into a system call each, calls on buffered streams do not
+static void format_stdio_call(const char* function, FILE* stream,
+                              char* out, size_t out_len)
+{
+   const size_t buffer_size = __fbufsize(stream);
+
+   if (__flbf(stream)) {
+      snprintf(out, out_len, "%s buf=line", function);
+   } else if (buffer_size <= 1) {
+      snprintf(out, out_len, "%s buf=none", function);
+   } else {
+      snprintf(out, out_len, "%s buf=%zu", function, buffer_size);
+   }
+}
+
+//*****************************************************************************
+
 int fprintf(FILE* stream, const char* format, ...)
 {
    CHECK_LOADED_FNS()
@@ -1187,7 +2128,11 @@ int fprintf(FILE* stream, const char* format, ...)
       record_bytes_written = 0;
    }
 
-   record(FILE_WRITE, WRITE, fileno(stream), NULL, NULL,
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, record_bytes_written);
+   char stdio_call[32];
+   format_stdio_call("fprintf", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, stdio_call,
           TIME_BEFORE(), TIME_AFTER(), error_code, record_bytes_written);
 
    return bytes_written;
@@ -1214,7 +2159,11 @@ int vfprintf(FILE* stream, const char* format, va_list ap)
       record_bytes_written = 0;
    }
 
-   record(FILE_WRITE, WRITE, fileno(stream), NULL, NULL,
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, record_bytes_written);
+   char stdio_call[32];
+   format_stdio_call("vfprintf", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, stdio_call,
           TIME_BEFORE(), TIME_AFTER(), error_code, record_bytes_written);
 
    return bytes_written;
@@ -1235,10 +2184,12 @@ size_t fwrite(const void* ptr, size_t size, size_t nmemb, FILE* stream)
       error_code = 1;
    }
 
-   // our recording of 0 bytes here is not accurate, however we don't
-   // have an easy way of knowing how many bytes were converted.
-   record(FILE_WRITE, WRITE, fileno(stream), NULL, NULL,
-          TIME_BEFORE(), TIME_AFTER(), error_code, rc * nmemb);
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, rc * size);
+   char stdio_call[32];
+   format_stdio_call("fwrite", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_WRITE, WRITE, fd, NULL, stdio_call,
+             TIME_BEFORE(), TIME_AFTER(), error_code, rc * size);
 
    return rc;
 }
@@ -1258,9 +2209,10 @@ ssize_t read(int fd, void* buf, size_t count)
       error_code = errno;
    }
 
-   record(FILE_READ, READ, fd, NULL, NULL,
+   const long long offset = advance_fd_position(fd, bytes_read);
+   record_at(offset, FILE_READ, READ, fd, NULL, NULL,
          TIME_BEFORE(), TIME_AFTER(), error_code, bytes_read);
-   check_for_http(FILE_READ, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
+   check_for_http(__builtin_return_address(0), FILE_READ, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
    
    return bytes_read;
 }
@@ -1282,7 +2234,7 @@ ssize_t recv(int fd, void* buf, size_t count, int flags)
 
    record(FILE_READ, READ, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_recv);
-   check_for_http(FILE_READ, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
+   check_for_http(__builtin_return_address(0), FILE_READ, fd, buf, count, TIME_BEFORE(), TIME_AFTER());
    return bytes_recv;
 }
 
@@ -1301,7 +2253,7 @@ ssize_t pread(int fd, void* buf, size_t count, off_t offset)
       error_code = errno;
    }
 
-   record(FILE_READ, READ, fd, NULL, NULL,
+   record_at(offset, FILE_READ, READ, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_read);
 
    return bytes_read;
@@ -1322,7 +2274,8 @@ ssize_t readv(int fd, const struct iovec* iov, int iovcnt)
       error_code = errno;
    }
 
-   record(FILE_READ, READ, fd, NULL, NULL,
+   const long long offset = advance_fd_position(fd, bytes_read);
+   record_at(offset, FILE_READ, READ, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_read);
 
    return bytes_read;
@@ -1343,7 +2296,7 @@ ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset)
       error_code = errno;
    }
 
-   record(FILE_READ, READ, fd, NULL, NULL,
+   record_at(offset, FILE_READ, READ, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_read);
 
    return bytes_read;
@@ -1366,8 +2319,12 @@ size_t fread(void* ptr, size_t size, size_t nmemb, FILE* stream)
       }
    }
 
-   record(FILE_READ, READ, fileno(stream), NULL, NULL,
-          TIME_BEFORE(), TIME_AFTER(), error_code, items_read * size);
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, items_read * size);
+   char stdio_call[32];
+   format_stdio_call("fread", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_READ, READ, fd, NULL, stdio_call,
+             TIME_BEFORE(), TIME_AFTER(), error_code, items_read * size);
 
    return items_read;
 }
@@ -1390,35 +2347,212 @@ int fscanf(FILE* stream, const char* format, ...)
       error_code = errno;
    }
 
-   // our recording of 0 bytes here is not accurate, however we don't
-   // have an easy way of knowing how many bytes were converted.
-   record(FILE_READ, READ, fileno(stream), NULL, NULL,
-          TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+   // our recording of 0 bytes here is not accurate, however we don't
+   // have an easy way of knowing how many bytes were converted.
+   // the amount consumed is unknown; resync with the stream position
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, 0);
+   if (offset != OFFSET_NONE) {
+      set_fd_position(fd, ftello(stream));
+   }
+   char stdio_call[32];
+   format_stdio_call("fscanf", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_READ, READ, fd, NULL, stdio_call,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+int vfscanf(FILE* stream, const char* format, va_list ap)
+{
+   CHECK_LOADED_FNS()
+   PUTS("vfscanf")
+   DECL_VARS()
+   GET_START_TIME()
+   const int rc = orig_vfscanf(stream, format, ap);
+   GET_END_TIME()
+
+   if (rc == EOF) {
+      error_code = errno;
+   }
+
+   // our recording of 0 bytes here is not accurate, however we don't
+   // have an easy way of knowing how many bytes were converted.
+   // the amount consumed is unknown; resync with the stream position
+   const int fd = fileno(stream);
+   const long long offset = advance_fd_position(fd, 0);
+   if (offset != OFFSET_NONE) {
+      set_fd_position(fd, ftello(stream));
+   }
+   char stdio_call[32];
+   format_stdio_call("vfscanf", stream, stdio_call, sizeof(stdio_call));
+   record_at(offset, FILE_READ, READ, fd, NULL, stdio_call,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+static const char* whence_name(int whence)
+{
+   switch (whence) {
+      case SEEK_SET:
+         return "SEEK_SET";
+      case SEEK_CUR:
+         return "SEEK_CUR";
+      case SEEK_END:
+         return "SEEK_END";
+      case SEEK_DATA:
+         return "SEEK_DATA";
+      case SEEK_HOLE:
+         return "SEEK_HOLE";
+      default:
+         return "?";
+   }
+}
+
+//*****************************************************************************
+
+off_t lseek(int fd, off_t offset, int whence)
+{
+   CHECK_LOADED_FNS()
+   PUTS("lseek")
+   DECL_VARS()
+   GET_START_TIME()
+   const off_t rc = orig_lseek(fd, offset, whence);
+   GET_END_TIME()
+
+   if (rc == -1) {
+      error_code = errno;
+   } else {
+      set_fd_position(fd, rc);
+   }
+
+   record_at(rc, SEEKS, SEEK, fd, whence_name(whence), NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+off64_t lseek64(int fd, off64_t offset, int whence)
+{
+   CHECK_LOADED_FNS()
+   PUTS("lseek64")
+   DECL_VARS()
+   GET_START_TIME()
+   const off64_t rc = orig_lseek64(fd, offset, whence);
+   GET_END_TIME()
+
+   if (rc == -1) {
+      error_code = errno;
+   } else {
+      set_fd_position(fd, rc);
+   }
+
+   record_at(rc, SEEKS, SEEK, fd, whence_name(whence), NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+int fseek(FILE* stream, long offset, int whence)
+{
+   CHECK_LOADED_FNS()
+   PUTS("fseek")
+   DECL_VARS()
+   GET_START_TIME()
+   const int rc = orig_fseek(stream, offset, whence);
+   GET_END_TIME()
+   const int fd = fileno(stream);
+   long long position = OFFSET_NONE;
+
+   if (rc != 0) {
+      error_code = errno;
+   } else {
+      // cheap right after a seek: the stream knows its offset
+      position = ftello(stream);
+   }
+   set_fd_position(fd, position);
+
+   record_at(position, SEEKS, SEEK, fd, whence_name(whence), NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+int fseeko(FILE* stream, off_t offset, int whence)
+{
+   CHECK_LOADED_FNS()
+   PUTS("fseeko")
+   DECL_VARS()
+   GET_START_TIME()
+   const int rc = orig_fseeko(stream, offset, whence);
+   GET_END_TIME()
+   const int fd = fileno(stream);
+   long long position = OFFSET_NONE;
+
+   if (rc != 0) {
+      error_code = errno;
+   } else {
+      position = ftello(stream);
+   }
+   set_fd_position(fd, position);
+
+   record_at(position, SEEKS, SEEK, fd, whence_name(whence), NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+long ftell(FILE* stream)
+{
+   CHECK_LOADED_FNS()
+   PUTS("ftell")
+   DECL_VARS()
+   GET_START_TIME()
+   const long rc = orig_ftell(stream);
+   GET_END_TIME()
+   const int fd = fileno(stream);
+
+   if (rc == -1) {
+      error_code = errno;
+   } else {
+      set_fd_position(fd, rc);
+   }
+
+   record_at(rc, SEEKS, SEEK, fd, "ftell", NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 
    return rc;
 }
 
 //*****************************************************************************
 
-int vfscanf(FILE* stream, const char* format, va_list ap)
+void rewind(FILE* stream)
 {
    CHECK_LOADED_FNS()
-   PUTS("vfscanf")
+   PUTS("rewind")
    DECL_VARS()
    GET_START_TIME()
-   const int rc = orig_vfscanf(stream, format, ap);
+   orig_rewind(stream);
    GET_END_TIME()
+   const int fd = fileno(stream);
 
-   if (rc == EOF) {
-      error_code = errno;
-   }
-
-   // our recording of 0 bytes here is not accurate, however we don't
-   // have an easy way of knowing how many bytes were converted.
-   record(FILE_READ, READ, fileno(stream), NULL, NULL,
-          TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+   set_fd_position(fd, 0);
 
-   return rc;
+   record_at(0, SEEKS, SEEK, fd, "rewind", NULL,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 }
 
 //*****************************************************************************
@@ -1436,7 +2570,7 @@ int fsync(int fd)
       error_code = errno;
    }
 
-   record(SYNCS, SYNC, fd, NULL, NULL,
+   record(SYNCS, SYNC, fd, "fsync", NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 
    return rc;
@@ -1457,7 +2591,7 @@ int fdatasync(int fd)
       error_code = errno;
    }
 
-   record(SYNCS, SYNC, fd, NULL, NULL,
+   record(SYNCS, SYNC, fd, "fdatasync", NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 
    return rc;
@@ -1471,9 +2605,9 @@ void sync()
    PUTS("sync")
    DECL_VARS()
    GET_START_TIME()
-   sync();
+   orig_sync();
    GET_END_TIME()
-   record(SYNCS, SYNC, FD_NONE, NULL, NULL,
+   record(SYNCS, SYNC, FD_NONE, "sync", NULL,
           TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
 }
 
@@ -1485,14 +2619,14 @@ int syncfs(int fd)
    PUTS("syncfs")
    DECL_VARS()
    GET_START_TIME()
-   const int rc = syncfs(fd);
+   const int rc = orig_syncfs(fd);
    GET_END_TIME()
 
    if (rc != 0) {
       error_code = errno;
    }
 
-   record(SYNCS, SYNC, fd, NULL, NULL,
+   record(SYNCS, SYNC, fd, "syncfs", NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 
    return rc;
@@ -1500,6 +2634,32 @@ int syncfs(int fd)
 
 //*****************************************************************************
 
+// starts (or waits for) writeback of a range without flushing metadata or
+// the device cache; the range length (0 = to the end of the file) and
+// the flags are in s2
+int sync_file_range(int fd, off64_t offset, off64_t nbytes, unsigned int flags)
+{
+   CHECK_LOADED_FNS()
+   PUTS("sync_file_range")
+   DECL_VARS()
+   char range[64];
+   GET_START_TIME()
+   const int rc = orig_sync_file_range(fd, offset, nbytes, flags);
+   GET_END_TIME()
+
+   if (rc != 0) {
+      error_code = errno;
+   }
+
+   snprintf(range, sizeof(range), "nbytes=%lld flags=%u", (long long) nbytes, flags);
+   record_at(offset, SYNCS, SYNC, fd, "sync_file_range", range,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
 int setxattr(const char* path,
              const char* name,
              const void* value,
@@ -1852,10 +3012,11 @@ FILE* fopen(const char* path, const char* mode)
       fd = FD_NONE;
    } else {
       fd = fileno(rc);
+      set_fd_position(fd, (mode[0] == 'a') ? OFFSET_NONE : 0);
    }
 
    char* real_path = realpath(path, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, mode,
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : path, mode,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -1888,6 +3049,7 @@ FILE* fopen64(const char* path, const char* mode)
    int fd = FD_NONE;
    if (rc != NULL) {
       fd = fileno(rc);
+      set_fd_position(fd, (mode[0] == 'a') ? OFFSET_NONE : 0);
    }
 
    record(FILE_OPEN_CLOSE, OPEN, fd, record_path, mode,
@@ -1916,10 +3078,11 @@ FILE* _IO_new_fopen(const char* path, const char* mode)
       fd = FD_NONE;
    } else {
       fd = fileno(rc);
+      set_fd_position(fd, (mode[0] == 'a') ? OFFSET_NONE : 0);
    }
 
    char* real_path = realpath(path, NULL);
-   record(FILE_OPEN_CLOSE, OPEN, fd, real_path, mode,
+   record(FILE_OPEN_CLOSE, OPEN, fd, real_path ? real_path : path, mode,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
    free(real_path);
 
@@ -1941,7 +3104,8 @@ int fflush(FILE* fp)
       error_code = errno;
    }
 
-   record(SYNCS, FLUSH, fileno(fp), NULL, NULL,
+   // fflush(NULL) flushes all streams
+   record(SYNCS, FLUSH, (fp != NULL) ? fileno(fp) : FD_NONE, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
 
    return rc;
@@ -2410,7 +3574,7 @@ int posix_fallocate(int fd, off_t offset, off_t len)
       bytes_written = ZERO_BYTES;
    }
 
-   record(FILE_SPACE, ALLOCATE, fd, NULL, NULL,
+   record_at(offset, FILE_SPACE, ALLOCATE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), rc, bytes_written);
 
    return rc;
@@ -2421,7 +3585,7 @@ int posix_fallocate(int fd, off_t offset, off_t len)
 int fallocate(int fd, int mode, off_t offset, off_t len)
 {
    CHECK_LOADED_FNS()
-   PUTS("ftruncate")
+   PUTS("fallocate")
    DECL_VARS()
    GET_START_TIME()
    const int rc = orig_fallocate(fd, mode, offset, len);
@@ -2436,7 +3600,7 @@ int fallocate(int fd, int mode, off_t offset, off_t len)
       bytes_written = ZERO_BYTES;
    }
 
-   record(FILE_SPACE, ALLOCATE, fd, NULL, NULL,
+   record_at(offset, FILE_SPACE, ALLOCATE, fd, NULL, NULL,
           TIME_BEFORE(), TIME_AFTER(), error_code, bytes_written);
 
    return rc;
@@ -2573,3 +3737,517 @@ int bind(int sockfd, const struct sockaddr *addr,
   // handle bind (command after socket and before accept
 
 }
+
+//*****************************************************************************
+
+static int env_name_matches(const char* entry, const char* name)
+{
+   const size_t len = strlen(name);
+
+   return !strncmp(entry, name, len) && entry[len] == '=';
+}
+
+//*****************************************************************************
+
+// environment for a program that we exec or spawn: the given one plus our
+// configuration, with this library in front of LD_PRELOAD. variables the
+// application set explicitly are left alone. exec_start (if not NULL) is
+// added as is. the result is a single allocation; NULL if out of memory.
+static char** monitor_environment(char* const envp[], const char* exec_start)
+{
+   const size_t lib_len = strlen(monitor_library_path);
+   const char* ld_preload = NULL;
+   char* preload_entry = NULL;
+   size_t preload_len = 0;
+   size_t num_env = 0;
+   size_t count = 0;
+   size_t slots;
+   char** env;
+   size_t i;
+   int j;
+
+   for (num_env = 0; envp != NULL && envp[num_env] != NULL; ++num_env) {
+      if (env_name_matches(envp[num_env], ENV_LD_PRELOAD)) {
+         ld_preload = envp[num_env] + strlen(ENV_LD_PRELOAD) + 1;
+      }
+   }
+   if (lib_len > 0 &&
+       (ld_preload == NULL || strstr(ld_preload, monitor_library_path) == NULL)) {
+      preload_len = strlen(ENV_LD_PRELOAD) + lib_len + 3 +
+                    ((ld_preload != NULL) ? strlen(ld_preload) : 0);
+   }
+
+   slots = num_env + num_saved_env + 3;
+   env = malloc(slots * sizeof(char*) + preload_len);
+   if (env == NULL) {
+      return NULL;
+   }
+
+   for (i = 0; i < num_env; ++i) {
+      if ((preload_len > 0 && env_name_matches(envp[i], ENV_LD_PRELOAD)) ||
+          env_name_matches(envp[i], ENV_EXEC_START)) {
+         continue;
+      }
+      env[count++] = envp[i];
+   }
+
+   if (preload_len > 0) {
+      preload_entry = (char*) (env + slots);
+      if (ld_preload != NULL && ld_preload[0] != '\0') {
+         snprintf(preload_entry, preload_len, "%s=%s:%s",
+                  ENV_LD_PRELOAD, monitor_library_path, ld_preload);
+      } else {
+         snprintf(preload_entry, preload_len, "%s=%s",
+                  ENV_LD_PRELOAD, monitor_library_path);
+      }
+      env[count++] = preload_entry;
+   }
+
+   for (j = 0; j < num_saved_env; ++j) {
+      const size_t name_len = strchr(saved_env[j], '=') - saved_env[j] + 1;
+      for (i = 0; i < num_env; ++i) {
+         if (!strncmp(envp[i], saved_env[j], name_len)) {
+            break;
+         }
+      }
+      if (i == num_env) {
+         env[count++] = saved_env[j];
+      }
+   }
+
+   if (exec_start != NULL) {
+      env[count++] = (char*) exec_start;
+   }
+   env[count] = NULL;
+
+   return env;
+}
+
+//*****************************************************************************
+
+static pid_t monitored_fork(void* caller, const char* name)
+{
+   DECL_VARS()
+   GET_START_TIME()
+   const pid_t pid = orig_fork();
+   char child_pid[16];
+
+   if (pid == 0) {
+      // child; already reset by after_fork_child
+      return pid;
+   }
+   GET_END_TIME()
+
+   child_pid[0] = '\0';
+   if (pid == -1) {
+      error_code = errno;
+   } else {
+      snprintf(child_pid, sizeof(child_pid), "%d", pid);
+   }
+
+   record_event(caller, OFFSET_NONE, CPU_TIME_NONE, PROCESSES, FORK, FD_NONE, name, child_pid,
+                TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   if (pid == -1) {
+      errno = error_code;
+   }
+   return pid;
+}
+
+//*****************************************************************************
+
+pid_t fork(void)
+{
+   CHECK_LOADED_FNS()
+   PUTS("fork")
+   return monitored_fork(__builtin_return_address(0), "fork");
+}
+
+//*****************************************************************************
+
+// the child of a real vfork borrows our stack until it calls exec or
+// _exit, so it must never return through this wrapper. fork is a valid
+// implementation of vfork and gives the child its own copy instead.
+pid_t vfork(void)
+{
+   CHECK_LOADED_FNS()
+   PUTS("vfork")
+   return monitored_fork(__builtin_return_address(0), "vfork");
+}
+
+//*****************************************************************************
+
+struct clone_start {
+   int (*fn)(void*);
+   void* arg;
+};
+
+// entry point of clone() children that have their own address space.
+// their copy of the clone_start is not freed: another thread may have
+// held the malloc lock when we were cloned.
+static int clone_child_start(void* arg)
+{
+   const struct clone_start* start = arg;
+
+   after_fork_child();
+   return start->fn(start->arg);
+}
+
+int clone(int (*fn)(void*), void* stack, int flags, void* arg, ...)
+{
+   CHECK_LOADED_FNS()
+   PUTS("clone")
+   DECL_VARS()
+   struct clone_start* start = NULL;
+   pid_t* parent_tid;
+   void* tls;
+   pid_t* child_tid;
+   va_list ap;
+
+   va_start(ap, arg);
+   parent_tid = va_arg(ap, pid_t*);
+   tls = va_arg(ap, void*);
+   child_tid = va_arg(ap, pid_t*);
+   va_end(ap);
+
+   // children sharing our memory (threads) must not reset our state
+   if (!(flags & CLONE_VM)) {
+      start = malloc(sizeof(struct clone_start));
+      if (start != NULL) {
+         start->fn = fn;
+         start->arg = arg;
+         fn = clone_child_start;
+         arg = start;
+      }
+   }
+
+   GET_START_TIME()
+   const int pid = orig_clone(fn, stack, flags, arg, parent_tid, tls, child_tid);
+   GET_END_TIME()
+   char child_pid[16];
+
+   free(start);
+   child_pid[0] = '\0';
+   if (pid == -1) {
+      error_code = errno;
+   } else {
+      snprintf(child_pid, sizeof(child_pid), "%d", pid);
+   }
+
+   if (!(flags & CLONE_THREAD)) {
+      record(PROCESSES, FORK, FD_NONE, "clone", child_pid,
+             TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+   }
+
+   if (pid == -1) {
+      errno = error_code;
+   }
+   return pid;
+}
+
+//*****************************************************************************
+
+static int monitored_spawn(void* caller,
+                           orig_posix_spawn_f_type spawn,
+                           pid_t* pid,
+                           const char* path,
+                           const posix_spawn_file_actions_t* file_actions,
+                           const posix_spawnattr_t* attrp,
+                           char* const argv[],
+                           char* const envp[])
+{
+   DECL_VARS()
+   char** env = monitor_environment(envp, NULL);
+   char child_pid[16];
+   pid_t spawned_pid = -1;
+
+   GET_START_TIME()
+   const int rc = spawn(&spawned_pid, path, file_actions, attrp, argv,
+                        (env != NULL) ? env : envp);
+   GET_END_TIME()
+
+   free(env);
+   child_pid[0] = '\0';
+   if (rc == 0) {
+      snprintf(child_pid, sizeof(child_pid), "%d", spawned_pid);
+      if (pid != NULL) {
+         *pid = spawned_pid;
+      }
+   }
+
+   // posix_spawn returns the error number rather than setting errno
+   record_event(caller, OFFSET_NONE, CPU_TIME_NONE, PROCESSES, FORK, FD_NONE, path, child_pid,
+                TIME_BEFORE(), TIME_AFTER(), rc, ZERO_BYTES);
+
+   return rc;
+}
+
+//*****************************************************************************
+
+int posix_spawn(pid_t* pid, const char* path,
+                const posix_spawn_file_actions_t* file_actions,
+                const posix_spawnattr_t* attrp,
+                char* const argv[], char* const envp[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("posix_spawn")
+   return monitored_spawn(__builtin_return_address(0), orig_posix_spawn,
+                          pid, path, file_actions, attrp, argv, envp);
+}
+
+//*****************************************************************************
+
+int posix_spawnp(pid_t* pid, const char* file,
+                 const posix_spawn_file_actions_t* file_actions,
+                 const posix_spawnattr_t* attrp,
+                 char* const argv[], char* const envp[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("posix_spawnp")
+   return monitored_spawn(__builtin_return_address(0), orig_posix_spawnp,
+                          pid, file, file_actions, attrp, argv, envp);
+}
+
+//*****************************************************************************
+
+// all exec variants end up here. a successful exec does not return: the
+// new program records the EXEC itself (see init) from the start time we
+// pass in its environment. only failed execs are recorded here.
+static int monitored_exec(void* caller, const char* path, int fd, int search_path,
+                          char* const argv[], char* const envp[])
+{
+   DECL_VARS()
+   char exec_start[64];
+   char** env;
+   int rc;
+
+   GET_START_TIME()
+   snprintf(exec_start, sizeof(exec_start), "%s=%lld", ENV_EXEC_START,
+            start_time.tv_sec * 1000000LL + start_time.tv_usec);
+   env = monitor_environment(envp, exec_start);
+
+   if (fd != FD_NONE) {
+      rc = orig_fexecve(fd, argv, (env != NULL) ? env : envp);
+   } else if (search_path) {
+      rc = orig_execvpe(path, argv, (env != NULL) ? env : envp);
+   } else {
+      rc = orig_execve(path, argv, (env != NULL) ? env : envp);
+   }
+   error_code = errno;
+   GET_END_TIME()
+
+   free(env);
+   record_event(caller, OFFSET_NONE, CPU_TIME_NONE, PROCESSES, EXEC, FD_NONE, path, NULL,
+                TIME_BEFORE(), TIME_AFTER(), error_code, ZERO_BYTES);
+
+   errno = error_code;
+   return rc;
+}
+
+// argument vector of execl, execlp and execle on the stack. ap is left
+// positioned after the terminating NULL (where execle has its envp).
+#define EXEC_ARGV(argv, arg, ap) \
+size_t argc = 1; \
+va_start(ap, arg); \
+while (va_arg(ap, char*) != NULL) { \
+   argc++; \
+} \
+va_end(ap); \
+char* argv[argc + 1]; \
+argv[0] = (char*) arg; \
+va_start(ap, arg); \
+for (size_t i = 1; i <= argc; ++i) { \
+   argv[i] = va_arg(ap, char*); \
+}
+
+//*****************************************************************************
+
+int execve(const char* path, char* const argv[], char* const envp[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("execve")
+   return monitored_exec(__builtin_return_address(0), path, FD_NONE, 0, argv, envp);
+}
+
+//*****************************************************************************
+
+int execv(const char* path, char* const argv[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("execv")
+   return monitored_exec(__builtin_return_address(0), path, FD_NONE, 0, argv, environ);
+}
+
+//*****************************************************************************
+
+int execvp(const char* file, char* const argv[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("execvp")
+   return monitored_exec(__builtin_return_address(0), file, FD_NONE, 1, argv, environ);
+}
+
+//*****************************************************************************
+
+int execvpe(const char* file, char* const argv[], char* const envp[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("execvpe")
+   return monitored_exec(__builtin_return_address(0), file, FD_NONE, 1, argv, envp);
+}
+
+//*****************************************************************************
+
+int fexecve(int fd, char* const argv[], char* const envp[])
+{
+   CHECK_LOADED_FNS()
+   PUTS("fexecve")
+   return monitored_exec(__builtin_return_address(0), NULL, fd, 0, argv, envp);
+}
+
+//*****************************************************************************
+
+int execl(const char* path, const char* arg, ...)
+{
+   CHECK_LOADED_FNS()
+   PUTS("execl")
+   va_list ap;
+   EXEC_ARGV(argv, arg, ap)
+   va_end(ap);
+   return monitored_exec(__builtin_return_address(0), path, FD_NONE, 0, argv, environ);
+}
+
+//*****************************************************************************
+
+int execlp(const char* file, const char* arg, ...)
+{
+   CHECK_LOADED_FNS()
+   PUTS("execlp")
+   va_list ap;
+   EXEC_ARGV(argv, arg, ap)
+   va_end(ap);
+   return monitored_exec(__builtin_return_address(0), file, FD_NONE, 1, argv, environ);
+}
+
+//*****************************************************************************
+
+int execle(const char* path, const char* arg, ...)
+{
+   CHECK_LOADED_FNS()
+   PUTS("execle")
+   va_list ap;
+   EXEC_ARGV(argv, arg, ap)
+   char* const* envp = va_arg(ap, char* const*);
+   va_end(ap);
+   return monitored_exec(__builtin_return_address(0), path, FD_NONE, 0, argv, envp);
+}
+
+//*****************************************************************************
+
+static int known_thread_slot(pthread_t thread)
+{
+   return ((unsigned long) thread >> 6) % KNOWN_THREADS;
+}
+
+//*****************************************************************************
+
+static void record_thread_name(void* caller, pid_t tid, const char* name)
+{
+   // not a timed call: no CPU time, so DECL_VARS is not used
+   struct timeval start_time, end_time;
+   char tid_string[16];
+
+   gettimeofday(&start_time, NULL);
+   end_time = start_time;
+   snprintf(tid_string, sizeof(tid_string), "%d", tid);
+   record_event(caller, OFFSET_NONE, CPU_TIME_NONE, START_STOP, THREAD_START, 0, name, tid_string,
+                TIME_BEFORE(), TIME_AFTER(), 0, ZERO_BYTES);
+}
+
+//*****************************************************************************
+
+struct thread_start {
+   void* (*start_routine)(void*);
+   void* arg;
+};
+
+// entry point of threads created through pthread_create. the thread
+// registers itself before reading its name: a name set by the creator
+// in the meantime either finds it registered or is read here.
+static void* thread_start_routine(void* arg)
+{
+   struct thread_start start = *(struct thread_start*) arg;
+   struct timeval now;
+   char name[16];
+   int slot;
+
+   free(arg);
+   thread_id = syscall(SYS_gettid);
+   slot = known_thread_slot(pthread_self());
+   known_threads[slot].thread = pthread_self();
+   __atomic_store_n(&known_threads[slot].tid, thread_id, __ATOMIC_RELEASE);
+
+   memset(name, 0, sizeof(name));
+   prctl(PR_GET_NAME, name, 0, 0, 0);
+   record_thread_name(__builtin_return_address(0), thread_id, name);
+
+   gettimeofday(&now, NULL);
+   start_thread_blocked(timeval_usec(&now));
+
+   // the rest of its time is sent by flush_thread_blocked
+   return start.start_routine(start.arg);
+}
+
+//*****************************************************************************
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr,
+                   void* (*start_routine)(void*), void* arg)
+{
+   CHECK_LOADED_FNS()
+   PUTS("pthread_create")
+   struct thread_start* start = malloc(sizeof(struct thread_start));
+   int rc;
+
+   if (start == NULL) {
+      return orig_pthread_create(thread, attr, start_routine, arg);
+   }
+   start->start_routine = start_routine;
+   start->arg = arg;
+
+   rc = orig_pthread_create(thread, attr, thread_start_routine, start);
+   if (rc != 0) {
+      free(start);
+   }
+   return rc;
+}
+
+//*****************************************************************************
+
+int pthread_setname_np(pthread_t thread, const char* name)
+{
+   CHECK_LOADED_FNS()
+   PUTS("pthread_setname_np")
+   const int rc = orig_pthread_setname_np(thread, name);
+   pid_t tid = 0;
+
+   if (rc != 0) {
+      return rc;
+   }
+
+   if (pthread_equal(thread, pthread_self())) {
+      if (thread_id == 0) {
+         thread_id = syscall(SYS_gettid);
+      }
+      tid = thread_id;
+   } else {
+      const int slot = known_thread_slot(thread);
+      if (pthread_equal(known_threads[slot].thread, thread)) {
+         tid = __atomic_load_n(&known_threads[slot].tid, __ATOMIC_ACQUIRE);
+      }
+   }
+
+   if (tid != 0) {
+      record_thread_name(__builtin_return_address(0), tid, name);
+   }
+   return rc;
+}
@@ -0,0 +1,646 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// io_monitor_cachesim.c
+//
+// offline page cache simulator. replays the reads and writes of a
+// capture (mq_listener -o) block by block through simulated caches:
+//
+// * LRU for all cache sizes at once, from the LRU stack distance of each
+//   access (Mattson et al.), computed with a Fenwick tree over access
+//   times (Bennett & Kruskal) in O(log n) per access
+// * 2Q (Johnson & Shasha) and ARC (Megiddo & Modha), which are not stack
+//   algorithms, with one simulation per cache size
+//
+// reads count towards the hit ratio; writes allocate (or refresh) their
+// blocks as in the page cache but are not counted. the saved I/O time is
+// the number of hits times the cost of a miss, which is estimated from
+// the reads of blocks not seen before (compulsory misses), or from all
+// reads if there are none (e.g., the data was written first), unless
+// given.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "domains.h"
+#include "capture.h"
+#include "htable.h"
+#include "process_table.h"
+
+#define MAX_CACHE_SIZES 64
+#define NOWHERE 0
+
+static const unsigned long long DEFAULT_BLOCK_SIZE = 4096;
+static const unsigned long long MIN_DEFAULT_CACHE_SIZE = 1024 * 1024;
+
+// points per doubling of the cache size in the miss-ratio curve
+static const double CURVE_STEP = 1.0905077;   // 2^(1/8)
+
+struct trace_access {
+   unsigned int block;
+   unsigned int is_read;
+};
+
+struct trace {
+   struct trace_access* accesses;
+   size_t count;
+   size_t capacity;
+   unsigned int num_blocks;
+   unsigned long long read_blocks;
+   unsigned long long write_blocks;
+   unsigned long long cold_read_blocks;  // reads of blocks not seen before
+   double cold_read_ms;
+   double read_ms;
+};
+
+// doubly linked lists of block ids with O(1) removal, as used by 2Q and
+// ARC. where[] holds the list a block is on (list index + 1).
+#define MAX_LISTS 4
+
+struct block_list {
+   int head;     // most recently used
+   int tail;     // least recently used
+   size_t size;
+};
+
+struct cache_state {
+   int* prev;
+   int* next;
+   unsigned char* where;
+   struct block_list lists[MAX_LISTS];
+};
+
+enum { A1IN, A1OUT, AM };          // 2Q
+enum { T1, T2, B1, B2 };           // ARC
+
+//*****************************************************************************
+
+void usage(const char* program)
+{
+   printf("usage: %s [options] <capture-file>\n", program);
+   printf("  -b <bytes>  block (page) size, default 4096\n");
+   printf("  -s <sizes>  comma-separated cache sizes (e.g., 64M,256M,1G), default\n");
+   printf("              powers of 2 from 1M up to the data touched\n");
+   printf("  -m <usec>   cost of a miss per block, default estimated from the capture\n");
+   printf("  -c <file>   write the LRU miss-ratio curve (CSV) to file\n");
+}
+
+//*****************************************************************************
+
+static int parse_size(const char* s, unsigned long long* size)
+{
+   char* end;
+   unsigned long long value = strtoull(s, &end, 10);
+
+   switch (*end) {
+      case 'k': case 'K': value <<= 10; end++; break;
+      case 'm': case 'M': value <<= 20; end++; break;
+      case 'g': case 'G': value <<= 30; end++; break;
+      case 't': case 'T': value <<= 40; end++; break;
+   }
+   if (end == s || (*end != '\0' && *end != ',') || value == 0) {
+      return -1;
+   }
+   *size = value;
+   return (int) (end - s);
+}
+
+//*****************************************************************************
+
+static void format_size(unsigned long long bytes, char* out, size_t out_len)
+{
+   static const char* units = "KMGT";
+   int unit = -1;
+
+   while (bytes >= 1024 && bytes % 1024 == 0 && unit < 3) {
+      bytes /= 1024;
+      unit++;
+   }
+   if (unit < 0) {
+      snprintf(out, out_len, "%llu", bytes);
+   } else {
+      snprintf(out, out_len, "%llu%c", bytes, units[unit]);
+   }
+}
+
+//*****************************************************************************
+
+static void add_access(struct trace* trace, unsigned int block, int is_read)
+{
+   if (trace->count == trace->capacity) {
+      trace->capacity = trace->capacity ? trace->capacity * 2 : 65536;
+      trace->accesses = realloc(trace->accesses,
+                                trace->capacity * sizeof(struct trace_access));
+   }
+   trace->accesses[trace->count].block = block;
+   trace->accesses[trace->count].is_read = is_read;
+   trace->count++;
+}
+
+//*****************************************************************************
+
+static int load_trace(const char* path, unsigned long long block_size,
+                      struct trace* trace)
+{
+   struct monitor_record_t* r = malloc(sizeof(struct monitor_record_t));
+   struct htable blocks;    // (block, path) -> block id + 1
+   char key[sizeof(long long) + PATH_MAX];
+   FILE* capture = capture_open(path);
+   int rc;
+
+   if (capture == NULL) {
+      free(r);
+      return -1;
+   }
+
+   process_table_init();
+   htable_init(&blocks);
+
+   while ((rc = capture_read(capture, r)) > 0) {
+      const struct process_info* process = process_table_update(r);
+      const char* file_path = record_path(process, r);
+      const int is_read = (r->dom_type == FILE_READ);
+      long long block;
+      long long first;
+      long long last;
+      size_t path_len;
+
+      if ((r->dom_type == FILE_READ || r->dom_type == FILE_WRITE) &&
+          r->offset >= 0 && r->bytes_transferred > 0 && r->error_code == 0 &&
+          file_path != NULL) {
+         first = r->offset / block_size;
+         last = (r->offset + r->bytes_transferred - 1) / block_size;
+         path_len = strlen(file_path);
+         memcpy(key + sizeof(long long), file_path, path_len);
+
+         for (block = first; block <= last; ++block) {
+            unsigned long id;
+
+            memcpy(key, &block, sizeof(long long));
+            id = (unsigned long) htable_get(&blocks, key, sizeof(long long) + path_len);
+            if (id == 0) {
+               id = ++trace->num_blocks;
+               htable_put(&blocks, key, sizeof(long long) + path_len, (void*) id);
+               if (is_read) {
+                  trace->cold_read_blocks++;
+                  trace->cold_read_ms += r->elapsed_time / (last - first + 1);
+               }
+            }
+            add_access(trace, id - 1, is_read);
+            if (is_read) {
+               trace->read_blocks++;
+               trace->read_ms += r->elapsed_time / (last - first + 1);
+            } else {
+               trace->write_blocks++;
+            }
+         }
+      }
+      process_table_release(r);
+   }
+
+   if (rc < 0) {
+      printf("error: capture file '%s' is truncated\n", path);
+   }
+
+   htable_destroy(&blocks, NULL);
+   process_table_fini();
+   fclose(capture);
+   free(r);
+   return 0;
+}
+
+//*****************************************************************************
+
+// read hits of an LRU cache of n blocks are the reads with a stack
+// distance below n. returns the cumulative counts: hits[n] for a cache
+// of n blocks, n = 0 .. num_blocks.
+static unsigned long long* lru_hits(const struct trace* trace)
+{
+   const size_t n = trace->count;
+   int* marks = calloc(n + 1, sizeof(int));   // Fenwick tree over times
+   long* last_access = malloc(trace->num_blocks * sizeof(long));
+   unsigned long long* hits = calloc(trace->num_blocks + 1, sizeof(unsigned long long));
+   size_t t;
+   long i;
+
+   for (i = 0; i < trace->num_blocks; ++i) {
+      last_access[i] = -1;
+   }
+
+   for (t = 0; t < n; ++t) {
+      const struct trace_access* access = &trace->accesses[t];
+      const long last = last_access[access->block];
+
+      if (last >= 0) {
+         // distinct blocks accessed since the last access of this block:
+         // the marks (latest access of each block) in (last, t)
+         unsigned long long distance = 0;
+         for (i = t; i > 0; i -= i & -i) {
+            distance += marks[i];
+         }
+         for (i = last + 1; i > 0; i -= i & -i) {
+            distance -= marks[i];
+         }
+         if (access->is_read) {
+            hits[distance + 1]++;
+         }
+         for (i = last + 1; i <= (long) n; i += i & -i) {
+            marks[i]--;
+         }
+      }
+      for (i = t + 1; i <= (long) n; i += i & -i) {
+         marks[i]++;
+      }
+      last_access[access->block] = t;
+   }
+
+   for (i = 1; i <= trace->num_blocks; ++i) {
+      hits[i] += hits[i - 1];
+   }
+
+   free(marks);
+   free(last_access);
+   return hits;
+}
+
+//*****************************************************************************
+
+static void cache_reset(struct cache_state* c, unsigned int num_blocks)
+{
+   int i;
+
+   memset(c->where, NOWHERE, num_blocks);
+   for (i = 0; i < MAX_LISTS; ++i) {
+      c->lists[i].head = -1;
+      c->lists[i].tail = -1;
+      c->lists[i].size = 0;
+   }
+}
+
+//*****************************************************************************
+
+static void list_remove(struct cache_state* c, int b)
+{
+   struct block_list* list = &c->lists[c->where[b] - 1];
+
+   if (c->prev[b] >= 0) {
+      c->next[c->prev[b]] = c->next[b];
+   } else {
+      list->head = c->next[b];
+   }
+   if (c->next[b] >= 0) {
+      c->prev[c->next[b]] = c->prev[b];
+   } else {
+      list->tail = c->prev[b];
+   }
+   list->size--;
+   c->where[b] = NOWHERE;
+}
+
+//*****************************************************************************
+
+static void list_push(struct cache_state* c, int list_index, int b)
+{
+   struct block_list* list = &c->lists[list_index];
+
+   c->prev[b] = -1;
+   c->next[b] = list->head;
+   if (list->head >= 0) {
+      c->prev[list->head] = b;
+   } else {
+      list->tail = b;
+   }
+   list->head = b;
+   list->size++;
+   c->where[b] = list_index + 1;
+}
+
+//*****************************************************************************
+
+// removes the least recently used block of a list, returns it
+static int list_pop(struct cache_state* c, int list_index)
+{
+   const int b = c->lists[list_index].tail;
+
+   list_remove(c, b);
+   return b;
+}
+
+//*****************************************************************************
+
+static int on_list(const struct cache_state* c, int b, int list_index)
+{
+   return c->where[b] == list_index + 1;
+}
+
+//*****************************************************************************
+
+// 2Q: new blocks enter the A1in FIFO, blocks referenced again after
+// leaving it (tracked by the A1out ghost list) enter the Am LRU
+static int twoq_access(struct cache_state* c, size_t size, int b)
+{
+   const size_t max_in = size / 4 > 0 ? size / 4 : 1;
+   const size_t max_out = size / 2 > 0 ? size / 2 : 1;
+   int target;
+
+   if (on_list(c, b, AM)) {
+      list_remove(c, b);
+      list_push(c, AM, b);
+      return 1;
+   }
+   if (on_list(c, b, A1IN)) {
+      return 1;
+   }
+
+   if (on_list(c, b, A1OUT)) {
+      list_remove(c, b);
+      target = AM;
+   } else {
+      target = A1IN;
+   }
+
+   if (c->lists[A1IN].size + c->lists[AM].size >= size) {
+      if (c->lists[A1IN].size > max_in || c->lists[AM].size == 0) {
+         list_push(c, A1OUT, list_pop(c, A1IN));
+         if (c->lists[A1OUT].size > max_out) {
+            list_pop(c, A1OUT);
+         }
+      } else {
+         list_pop(c, AM);
+      }
+   }
+   list_push(c, target, b);
+   return 0;
+}
+
+//*****************************************************************************
+
+static void arc_replace(struct cache_state* c, int b, double p)
+{
+   const size_t t1 = c->lists[T1].size;
+
+   if (t1 > 0 && ((on_list(c, b, B2) && t1 == (size_t) p) || t1 > p ||
+                  c->lists[T2].size == 0)) {
+      list_push(c, B1, list_pop(c, T1));
+   } else {
+      list_push(c, B2, list_pop(c, T2));
+   }
+}
+
+//*****************************************************************************
+
+// ARC: T1/T2 hold blocks seen once/more than once, B1/B2 their ghosts.
+// the target size p of T1 adapts to hits in the ghost lists.
+static int arc_access(struct cache_state* c, size_t size, int b, double* p)
+{
+   struct block_list* lists = c->lists;
+   size_t total;
+
+   if (on_list(c, b, T1) || on_list(c, b, T2)) {
+      list_remove(c, b);
+      list_push(c, T2, b);
+      return 1;
+   }
+
+   if (on_list(c, b, B1)) {
+      const double delta = lists[B1].size >= lists[B2].size ?
+                           1.0 : (double) lists[B2].size / lists[B1].size;
+      *p = (*p + delta < size) ? *p + delta : size;
+      arc_replace(c, b, *p);
+      list_remove(c, b);
+      list_push(c, T2, b);
+      return 0;
+   }
+
+   if (on_list(c, b, B2)) {
+      const double delta = lists[B2].size >= lists[B1].size ?
+                           1.0 : (double) lists[B1].size / lists[B2].size;
+      *p = (*p - delta > 0) ? *p - delta : 0;
+      arc_replace(c, b, *p);
+      list_remove(c, b);
+      list_push(c, T2, b);
+      return 0;
+   }
+
+   total = lists[T1].size + lists[T2].size + lists[B1].size + lists[B2].size;
+   if (lists[T1].size + lists[B1].size >= size) {
+      if (lists[T1].size < size) {
+         list_pop(c, B1);
+         arc_replace(c, b, *p);
+      } else {
+         list_pop(c, T1);
+      }
+   } else if (total >= size) {
+      if (total >= 2 * size) {
+         list_pop(c, B2);
+      }
+      arc_replace(c, b, *p);
+   }
+   list_push(c, T1, b);
+   return 0;
+}
+
+//*****************************************************************************
+
+static void simulate(const struct trace* trace, struct cache_state* c, size_t size,
+                     unsigned long long* twoq_hits, unsigned long long* arc_hits)
+{
+   double p = 0.0;
+   size_t t;
+
+   *twoq_hits = 0;
+   *arc_hits = 0;
+
+   cache_reset(c, trace->num_blocks);
+   for (t = 0; t < trace->count; ++t) {
+      const struct trace_access* access = &trace->accesses[t];
+      if (twoq_access(c, size, access->block) && access->is_read) {
+         (*twoq_hits)++;
+      }
+   }
+
+   cache_reset(c, trace->num_blocks);
+   for (t = 0; t < trace->count; ++t) {
+      const struct trace_access* access = &trace->accesses[t];
+      if (arc_access(c, size, access->block, &p) && access->is_read) {
+         (*arc_hits)++;
+      }
+   }
+}
+
+//*****************************************************************************
+
+static int write_curve(const char* path, const struct trace* trace,
+                       unsigned long long block_size,
+                       const unsigned long long* hits)
+{
+   FILE* output = fopen(path, "w");
+   double blocks = 1.0;
+   unsigned int n;
+   unsigned int last = 0;
+
+   if (output == NULL) {
+      printf("error: unable to write miss-ratio curve to '%s'\n", path);
+      return -1;
+   }
+
+   fprintf(output, "cache_bytes,hit_ratio,miss_ratio\n");
+   fprintf(output, "0,0.000000,1.000000\n");
+   while (last < trace->num_blocks) {
+      n = (unsigned int) blocks;
+      if (n > trace->num_blocks) {
+         n = trace->num_blocks;
+      }
+      if (n > last) {
+         const double hit_ratio = (double) hits[n] / trace->read_blocks;
+         fprintf(output, "%llu,%f,%f\n", n * block_size, hit_ratio, 1.0 - hit_ratio);
+         last = n;
+      }
+      blocks *= CURVE_STEP;
+   }
+   fclose(output);
+   return 0;
+}
+
+//*****************************************************************************
+
+int main(int argc, char* argv[])
+{
+   unsigned long long block_size = DEFAULT_BLOCK_SIZE;
+   unsigned long long cache_sizes[MAX_CACHE_SIZES];
+   int num_cache_sizes = 0;
+   double miss_cost_usec = -1.0;
+   const char* curve_path = NULL;
+   const char* miss_cost_source = "given";
+   struct trace trace;
+   struct cache_state cache;
+   unsigned long long* hits;
+   const char* s;
+   char size_text[32];
+   int opt;
+   int len;
+   int i;
+
+   while ((opt = getopt(argc, argv, "b:s:m:c:")) != -1) {
+      switch (opt) {
+         case 'b':
+            if (parse_size(optarg, &block_size) != (int) strlen(optarg)) {
+               printf("error: invalid block size '%s'\n", optarg);
+               exit(1);
+            }
+            break;
+         case 's':
+            for (s = optarg; *s; s += len + (s[len] == ',')) {
+               if (num_cache_sizes == MAX_CACHE_SIZES ||
+                   (len = parse_size(s, &cache_sizes[num_cache_sizes])) < 0) {
+                  printf("error: invalid cache sizes '%s'\n", optarg);
+                  exit(1);
+               }
+               num_cache_sizes++;
+            }
+            break;
+         case 'm':
+            miss_cost_usec = atof(optarg);
+            break;
+         case 'c':
+            curve_path = optarg;
+            break;
+         default:
+            usage(argv[0]);
+            exit(1);
+      }
+   }
+
+   if (optind >= argc) {
+      printf("error: missing arguments\n");
+      usage(argv[0]);
+      exit(1);
+   }
+
+   memset(&trace, 0, sizeof(trace));
+   if (load_trace(argv[optind], block_size, &trace) != 0) {
+      exit(1);
+   }
+   if (trace.read_blocks == 0) {
+      printf("error: no reads with known offsets in '%s'\n", argv[optind]);
+      exit(1);
+   }
+
+   if (num_cache_sizes == 0) {
+      unsigned long long size = MIN_DEFAULT_CACHE_SIZE;
+      do {
+         cache_sizes[num_cache_sizes++] = size;
+         size *= 2;
+      } while (size / 2 < trace.num_blocks * block_size &&
+               num_cache_sizes < MAX_CACHE_SIZES);
+   }
+   if (miss_cost_usec < 0.0 && trace.cold_read_blocks > 0) {
+      miss_cost_usec = trace.cold_read_ms * 1000.0 / trace.cold_read_blocks;
+      miss_cost_source = "compulsory misses";
+   } else if (miss_cost_usec < 0.0) {
+      miss_cost_usec = trace.read_ms * 1000.0 / trace.read_blocks;
+      miss_cost_source = "all reads";
+   }
+
+   hits = lru_hits(&trace);
+   if (curve_path != NULL) {
+      write_curve(curve_path, &trace, block_size, hits);
+   }
+
+   printf("===== page cache simulation (%llu byte blocks)\n", block_size);
+   printf("  blocks read           %llu\n", trace.read_blocks);
+   printf("  blocks written        %llu\n", trace.write_blocks);
+   printf("  unique bytes          %llu\n", trace.num_blocks * block_size);
+   printf("  compulsory misses     %llu (%.1f%% of reads)\n", trace.cold_read_blocks,
+          100.0 * trace.cold_read_blocks / trace.read_blocks);
+   printf("  miss cost             %.1f usec per block (%s)\n", miss_cost_usec,
+          miss_cost_source);
+   printf("\n  %10s %8s %8s %8s %13s %13s %13s\n", "CACHE SIZE",
+          "LRU HIT%", "2Q HIT%", "ARC HIT%", "LRU SAVED(ms)", "2Q SAVED(ms)",
+          "ARC SAVED(ms)");
+
+   cache.prev = malloc(trace.num_blocks * sizeof(int));
+   cache.next = malloc(trace.num_blocks * sizeof(int));
+   cache.where = malloc(trace.num_blocks);
+
+   for (i = 0; i < num_cache_sizes; ++i) {
+      const unsigned long long blocks = cache_sizes[i] / block_size;
+      const unsigned long long lru = hits[blocks < trace.num_blocks ? blocks : trace.num_blocks];
+      unsigned long long twoq = 0;
+      unsigned long long arc = 0;
+
+      if (blocks > 0) {
+         simulate(&trace, &cache, blocks, &twoq, &arc);
+      }
+      format_size(cache_sizes[i], size_text, sizeof(size_text));
+      printf("  %10s %8.1f %8.1f %8.1f %13.3f %13.3f %13.3f\n", size_text,
+             100.0 * lru / trace.read_blocks, 100.0 * twoq / trace.read_blocks,
+             100.0 * arc / trace.read_blocks, lru * miss_cost_usec / 1000.0,
+             twoq * miss_cost_usec / 1000.0, arc * miss_cost_usec / 1000.0);
+   }
+
+   free(cache.prev);
+   free(cache.next);
+   free(cache.where);
+   free(hits);
+   free(trace.accesses);
+   return 0;
+}
+
+//*****************************************************************************
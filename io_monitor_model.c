@@ -0,0 +1,1111 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// io_monitor_model.c
+//
+// fits a compact statistical model of the file I/O of a capture
+// (mq_listener -o), and runs a synthetic workload from such a model:
+//
+// * op mix: counts of open (with its close), read, write, fsync and stat
+// * request sizes of reads and writes, and the think time of each thread
+//   between the end of one operation and the start of its next one, as
+//   log2 histograms
+// * concurrency: mean number of active threads and mean/max number of
+//   operations in flight
+// * per file: size, op counts, and the dominant read and write pattern
+//   (see access_pattern.h). paths are not part of the model; files are
+//   numbered by their share of the operations.
+//
+// the model is a small text file that can be inspected and edited. the
+// generator starts the model's number of threads (times a scale factor)
+// for any duration; each thread draws operations, files, sizes and think
+// times from the model.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "domains.h"
+#include "ops.h"
+#include "access_pattern.h"
+#include "capture.h"
+#include "histogram.h"
+#include "htable.h"
+#include "process_table.h"
+
+#define MODEL_VERSION 1
+#define MAX_MODEL_FILES 1024
+#define PATTERN_LEN 16
+#define MAX_THREADS 1024
+
+static const size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+static const size_t FILL_CHUNK_SIZE = 1024 * 1024;
+static const mode_t FILE_MODE = 0644;
+
+// think times are slept in batches of at least this much, so that many
+// short think times add up to the right rate despite the sleep overhead
+static const long long MIN_SLEEP_USEC = 1000;
+
+typedef enum {
+   MODEL_OPEN,
+   MODEL_READ,
+   MODEL_WRITE,
+   MODEL_SYNC,
+   MODEL_STAT,
+   NUM_MODEL_OPS
+} MODEL_OP_TYPE;
+
+static const char* model_op_names[NUM_MODEL_OPS] = {
+   "open", "read", "write", "fsync", "stat"
+};
+
+enum { DIRECTION_READ, DIRECTION_WRITE, NUM_DIRECTIONS };
+
+struct model_file {
+   long long size;
+   unsigned long long ops[NUM_MODEL_OPS];
+   char patterns[NUM_DIRECTIONS][PATTERN_LEN];
+   struct access_pattern fit_patterns[NUM_DIRECTIONS];   // while fitting
+};
+
+struct model {
+   double duration_secs;
+   double threads;              // mean number of active threads
+   double inflight_mean;        // mean number of operations in flight
+   int inflight_max;
+   unsigned long long ops[NUM_MODEL_OPS];
+   struct histogram request_bytes[NUM_DIRECTIONS];
+   struct histogram think_usec;
+   struct model_file* files;
+   int num_files;
+};
+
+static const char* histogram_keys[NUM_DIRECTIONS] = { "read_bytes", "write_bytes" };
+
+//*****************************************************************************
+
+void usage(const char* program)
+{
+   printf("usage: %s [-o <model-file>] <capture-file>\n", program);
+   printf("       %s -g <model-file> -d <dir> [-T <seconds>] [-x <scale>]\n", program);
+   printf("  -o <file>   fit a model to the capture and write it to file\n");
+   printf("  -g <file>   run a synthetic workload from the model\n");
+   printf("  -d <dir>    directory for the files of the synthetic workload\n");
+   printf("  -T <secs>   duration of the synthetic workload, default as captured\n");
+   printf("  -x <scale>  multiply the number of threads by scale, default 1\n");
+}
+
+//*****************************************************************************
+// fitting
+//*****************************************************************************
+
+struct fit_session {
+   int file;
+   struct access_stream streams[NUM_DIRECTIONS];
+};
+
+struct fit_thread {
+   long long first_usec;
+   long long last_end_usec;
+};
+
+struct fit_state {
+   struct model* model;
+   struct htable files;         // path -> file index + 1
+   struct htable sessions;      // (pid, fd) -> struct fit_session*
+   struct htable threads;       // (pid, tid) -> struct fit_thread*
+   long long* starts;           // of all operations, for the in-flight max
+   long long* ends;
+   size_t num_intervals;
+   size_t capacity;
+   long long first_usec;
+   long long last_usec;
+   double busy_usec;
+};
+
+//*****************************************************************************
+
+static int fit_file(struct fit_state* state, const char* path)
+{
+   struct model* model = state->model;
+   long index = (long) htable_get_str(&state->files, path);
+
+   if (index == 0) {
+      if (model->num_files % 1024 == 0) {
+         model->files = realloc(model->files,
+                                (model->num_files + 1024) * sizeof(struct model_file));
+      }
+      memset(&model->files[model->num_files], 0, sizeof(struct model_file));
+      index = ++model->num_files;
+      htable_put_str(&state->files, path, (void*) index);
+   }
+   return (int) index - 1;
+}
+
+//*****************************************************************************
+
+static void end_session(struct fit_state* state, struct fit_session* session)
+{
+   struct model_file* file = &state->model->files[session->file];
+   int d;
+
+   for (d = 0; d < NUM_DIRECTIONS; ++d) {
+      access_pattern_end(&file->fit_patterns[d], &session->streams[d]);
+   }
+   free(session);
+}
+
+//*****************************************************************************
+
+static void end_session_visit(const void* key, size_t key_len, void* value, void* ctx)
+{
+   end_session(ctx, value);
+}
+
+//*****************************************************************************
+
+static void fit_timing(struct fit_state* state, const struct monitor_record_t* r)
+{
+   const long thread_key = ((long) r->pid << 32) | (unsigned int) r->tid;
+   const long long end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+   struct fit_thread* thread = htable_get_int(&state->threads, thread_key);
+
+   if (thread == NULL) {
+      thread = calloc(1, sizeof(struct fit_thread));
+      thread->first_usec = r->start_usec;
+      htable_put_int(&state->threads, thread_key, thread);
+   } else if (r->start_usec >= thread->last_end_usec) {
+      histogram_add(&state->model->think_usec, r->start_usec - thread->last_end_usec);
+   } else {
+      histogram_add(&state->model->think_usec, 0);
+   }
+   if (end_usec > thread->last_end_usec) {
+      thread->last_end_usec = end_usec;
+   }
+
+   if (state->num_intervals == 0 || r->start_usec < state->first_usec) {
+      state->first_usec = r->start_usec;
+   }
+   if (end_usec > state->last_usec) {
+      state->last_usec = end_usec;
+   }
+   state->busy_usec += r->elapsed_time * 1000.0;
+
+   if (state->num_intervals == state->capacity) {
+      state->capacity = state->capacity ? state->capacity * 2 : 65536;
+      state->starts = realloc(state->starts, state->capacity * sizeof(long long));
+      state->ends = realloc(state->ends, state->capacity * sizeof(long long));
+   }
+   state->starts[state->num_intervals] = r->start_usec;
+   state->ends[state->num_intervals] = end_usec;
+   state->num_intervals++;
+}
+
+//*****************************************************************************
+
+static void fit_record(struct fit_state* state, const struct process_info* process,
+                       const struct monitor_record_t* r)
+{
+   struct model* model = state->model;
+   const long session_key = ((long) r->pid << 32) | (unsigned int) r->fd;
+   struct fit_session* session = NULL;
+   const char* path = record_path(process, r);
+   MODEL_OP_TYPE type;
+   int file;
+
+   if (r->fd >= 0) {
+      session = htable_get_int(&state->sessions, session_key);
+   }
+
+   if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE) {
+      if (r->error_code != 0 || r->fd < 0 || r->s1[0] == '\0') {
+         return;
+      }
+      type = MODEL_OPEN;
+      path = r->s1;
+   } else if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE) {
+      if (session != NULL) {
+         htable_remove_int(&state->sessions, session_key);
+         end_session(state, session);
+      }
+      return;
+   } else if ((r->dom_type == FILE_READ || r->dom_type == FILE_WRITE) &&
+              (r->op_type == READ || r->op_type == WRITE)) {
+      if (r->error_code != 0 || path == NULL) {
+         return;
+      }
+      type = (r->op_type == READ) ? MODEL_READ : MODEL_WRITE;
+   } else if (r->op_type == SYNC && r->fd >= 0 && path != NULL) {
+      type = MODEL_SYNC;
+   } else if (r->op_type == STAT && path != NULL) {
+      type = MODEL_STAT;
+   } else {
+      return;
+   }
+
+   file = fit_file(state, path);
+   model->ops[type]++;
+   model->files[file].ops[type]++;
+   fit_timing(state, r);
+
+   if (type == MODEL_OPEN) {
+      // a new open of the same fd ends the previous session
+      if (session != NULL) {
+         htable_remove_int(&state->sessions, session_key);
+         end_session(state, session);
+      }
+      session = calloc(1, sizeof(struct fit_session));
+      session->file = file;
+      htable_put_int(&state->sessions, session_key, session);
+   } else if (type == MODEL_READ || type == MODEL_WRITE) {
+      const int direction = (type == MODEL_READ) ? DIRECTION_READ : DIRECTION_WRITE;
+      struct model_file* model_file = &model->files[file];
+
+      histogram_add(&model->request_bytes[direction], r->bytes_transferred);
+      if (r->offset >= 0) {
+         if (session == NULL) {
+            // opened before the capture started
+            session = calloc(1, sizeof(struct fit_session));
+            session->file = file;
+            htable_put_int(&state->sessions, session_key, session);
+         }
+         access_pattern_add(&model_file->fit_patterns[direction],
+                            &session->streams[direction],
+                            r->offset, r->bytes_transferred);
+         if (r->offset + (long long) r->bytes_transferred > model_file->size) {
+            model_file->size = r->offset + r->bytes_transferred;
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+
+static int compare_long_long(const void* a, const void* b)
+{
+   const long long la = *(const long long*) a;
+   const long long lb = *(const long long*) b;
+
+   return (la > lb) - (la < lb);
+}
+
+//*****************************************************************************
+
+// largest number of overlapping operations: sweep over the sorted start
+// and end times
+static int max_inflight(struct fit_state* state)
+{
+   size_t s = 0;
+   size_t e = 0;
+   int inflight = 0;
+   int max = 0;
+
+   qsort(state->starts, state->num_intervals, sizeof(long long), compare_long_long);
+   qsort(state->ends, state->num_intervals, sizeof(long long), compare_long_long);
+   while (s < state->num_intervals) {
+      if (state->starts[s] < state->ends[e]) {
+         inflight++;
+         s++;
+         if (inflight > max) {
+            max = inflight;
+         }
+      } else {
+         inflight--;
+         e++;
+      }
+   }
+   return max;
+}
+
+//*****************************************************************************
+
+static void sum_thread_span(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct fit_thread* thread = value;
+   double* span_usec = ctx;
+
+   *span_usec += thread->last_end_usec - thread->first_usec;
+}
+
+//*****************************************************************************
+
+static unsigned long long file_ops(const struct model_file* file)
+{
+   unsigned long long ops = 0;
+   int t;
+
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      ops += file->ops[t];
+   }
+   return ops;
+}
+
+//*****************************************************************************
+
+static int compare_files(const void* a, const void* b)
+{
+   const unsigned long long oa = file_ops(a);
+   const unsigned long long ob = file_ops(b);
+
+   return (oa < ob) - (oa > ob);
+}
+
+//*****************************************************************************
+
+static int fit_model(const char* path, struct model* model)
+{
+   struct monitor_record_t* r = malloc(sizeof(struct monitor_record_t));
+   struct fit_state state;
+   FILE* capture = capture_open(path);
+   double thread_span_usec = 0.0;
+   double duration_usec;
+   int rc;
+   int i;
+   int d;
+
+   if (capture == NULL) {
+      free(r);
+      return -1;
+   }
+
+   memset(model, 0, sizeof(struct model));
+   memset(&state, 0, sizeof(state));
+   state.model = model;
+   htable_init(&state.files);
+   htable_init(&state.sessions);
+   htable_init(&state.threads);
+   process_table_init();
+
+   while ((rc = capture_read(capture, r)) > 0) {
+      const struct process_info* process = process_table_update(r);
+      if (r->dom_type != START_STOP) {
+         fit_record(&state, process, r);
+      }
+      process_table_release(r);
+   }
+   if (rc < 0) {
+      printf("error: capture file '%s' is truncated\n", path);
+   }
+
+   htable_foreach(&state.sessions, end_session_visit, &state);
+   htable_foreach(&state.threads, sum_thread_span, &thread_span_usec);
+
+   if (state.num_intervals > 0) {
+      duration_usec = state.last_usec - state.first_usec;
+      model->duration_secs = duration_usec / 1e6;
+      // Little's law: mean concurrency is the busy time over the duration
+      if (duration_usec > 0) {
+         model->threads = thread_span_usec / duration_usec;
+         model->inflight_mean = state.busy_usec / duration_usec;
+      }
+      if (model->threads < 1.0) {
+         model->threads = 1.0;
+      }
+      model->inflight_max = max_inflight(&state);
+   }
+
+   for (i = 0; i < model->num_files; ++i) {
+      for (d = 0; d < NUM_DIRECTIONS; ++d) {
+         const struct access_pattern* pattern = &model->files[i].fit_patterns[d];
+         snprintf(model->files[i].patterns[d], PATTERN_LEN, "%s",
+                  pattern->requests > 0 ? access_pattern_label(pattern) : "none");
+      }
+   }
+   qsort(model->files, model->num_files, sizeof(struct model_file), compare_files);
+   if (model->num_files > MAX_MODEL_FILES) {
+      model->num_files = MAX_MODEL_FILES;
+   }
+
+   htable_destroy(&state.files, NULL);
+   htable_destroy(&state.sessions, NULL);
+   htable_destroy(&state.threads, free);
+   process_table_fini();
+   free(state.starts);
+   free(state.ends);
+   fclose(capture);
+   free(r);
+   return 0;
+}
+
+//*****************************************************************************
+// model file
+//*****************************************************************************
+
+static void write_histogram(FILE* output, const char* key, const struct histogram* h)
+{
+   int i;
+
+   fprintf(output, "%s", key);
+   for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      fprintf(output, " %llu", h->counts[i]);
+   }
+   fprintf(output, "\n");
+}
+
+//*****************************************************************************
+
+static int write_model(const char* path, const struct model* model)
+{
+   FILE* output = fopen(path, "w");
+   int i;
+   int t;
+
+   if (output == NULL) {
+      printf("error: unable to write model to '%s'\n", path);
+      return -1;
+   }
+
+   fprintf(output, "# io_monitor workload model\n");
+   fprintf(output, "version %d\n", MODEL_VERSION);
+   fprintf(output, "duration %.6f\n", model->duration_secs);
+   fprintf(output, "threads %.3f\n", model->threads);
+   fprintf(output, "inflight %.3f %d\n", model->inflight_mean, model->inflight_max);
+   fprintf(output, "ops");
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      fprintf(output, " %llu", model->ops[t]);
+   }
+   fprintf(output, "\n");
+   for (i = 0; i < NUM_DIRECTIONS; ++i) {
+      write_histogram(output, histogram_keys[i], &model->request_bytes[i]);
+   }
+   write_histogram(output, "think_usec", &model->think_usec);
+   fprintf(output, "# file size open read write fsync stat read_pattern write_pattern\n");
+   for (i = 0; i < model->num_files; ++i) {
+      const struct model_file* file = &model->files[i];
+      fprintf(output, "file %lld", file->size);
+      for (t = 0; t < NUM_MODEL_OPS; ++t) {
+         fprintf(output, " %llu", file->ops[t]);
+      }
+      fprintf(output, " %s %s\n", file->patterns[DIRECTION_READ],
+              file->patterns[DIRECTION_WRITE]);
+   }
+   fclose(output);
+   return 0;
+}
+
+//*****************************************************************************
+
+static int read_histogram(FILE* input, struct histogram* h)
+{
+   int i;
+
+   memset(h, 0, sizeof(struct histogram));
+   for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      if (fscanf(input, "%llu", &h->counts[i]) != 1) {
+         return -1;
+      }
+      // only the counts are kept in the model; sum and max are estimated
+      // from the bucket bounds
+      if (h->counts[i] > 0) {
+         h->count += h->counts[i];
+         h->sum += h->counts[i] * histogram_bucket_upper(i);
+         h->max = histogram_bucket_upper(i);
+      }
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+static int read_model(const char* path, struct model* model)
+{
+   FILE* input = fopen(path, "r");
+   char key[64];
+   int version = 0;
+   int ok = 1;
+   int i;
+   int t;
+
+   if (input == NULL) {
+      printf("error: unable to open model file '%s'\n", path);
+      return -1;
+   }
+
+   memset(model, 0, sizeof(struct model));
+   while (ok && fscanf(input, "%63s", key) == 1) {
+      if (key[0] == '#') {
+         ok = fscanf(input, "%*[^\n]") >= 0;
+      } else if (!strcmp(key, "version")) {
+         ok = fscanf(input, "%d", &version) == 1 && version == MODEL_VERSION;
+      } else if (!strcmp(key, "duration")) {
+         ok = fscanf(input, "%lf", &model->duration_secs) == 1;
+      } else if (!strcmp(key, "threads")) {
+         ok = fscanf(input, "%lf", &model->threads) == 1;
+      } else if (!strcmp(key, "inflight")) {
+         ok = fscanf(input, "%lf %d", &model->inflight_mean, &model->inflight_max) == 2;
+      } else if (!strcmp(key, "ops")) {
+         for (t = 0; ok && t < NUM_MODEL_OPS; ++t) {
+            ok = fscanf(input, "%llu", &model->ops[t]) == 1;
+         }
+      } else if (!strcmp(key, histogram_keys[DIRECTION_READ])) {
+         ok = read_histogram(input, &model->request_bytes[DIRECTION_READ]) == 0;
+      } else if (!strcmp(key, histogram_keys[DIRECTION_WRITE])) {
+         ok = read_histogram(input, &model->request_bytes[DIRECTION_WRITE]) == 0;
+      } else if (!strcmp(key, "think_usec")) {
+         ok = read_histogram(input, &model->think_usec) == 0;
+      } else if (!strcmp(key, "file") && model->num_files < MAX_MODEL_FILES) {
+         struct model_file* file;
+         if (model->num_files == 0) {
+            model->files = calloc(MAX_MODEL_FILES, sizeof(struct model_file));
+         }
+         file = &model->files[model->num_files++];
+         ok = fscanf(input, "%lld", &file->size) == 1;
+         for (t = 0; ok && t < NUM_MODEL_OPS; ++t) {
+            ok = fscanf(input, "%llu", &file->ops[t]) == 1;
+         }
+         for (i = 0; ok && i < NUM_DIRECTIONS; ++i) {
+            ok = fscanf(input, "%15s", file->patterns[i]) == 1;
+         }
+      } else {
+         ok = 0;
+      }
+   }
+   fclose(input);
+
+   if (!ok || version != MODEL_VERSION || model->num_files == 0) {
+      printf("error: '%s' is not a valid model file\n", path);
+      free(model->files);
+      return -1;
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+static void print_model(const struct model* model)
+{
+   unsigned long long total = 0;
+   int t;
+   int d;
+
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      total += model->ops[t];
+   }
+
+   printf("===== workload model\n");
+   printf("  duration              %.3f s\n", model->duration_secs);
+   printf("  threads (mean)        %.2f\n", model->threads);
+   printf("  in flight (mean/max)  %.2f / %d\n", model->inflight_mean,
+          model->inflight_max);
+   printf("  files                 %d\n", model->num_files);
+   printf("  operations            %llu\n", total);
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      printf("    %-8s %12llu %6.1f%%\n", model_op_names[t], model->ops[t],
+             total ? 100.0 * model->ops[t] / total : 0.0);
+   }
+   for (d = 0; d < NUM_DIRECTIONS; ++d) {
+      const struct histogram* h = &model->request_bytes[d];
+      printf("  %-21s p50 %.0f, p95 %.0f, p99 %.0f\n", histogram_keys[d],
+             histogram_percentile(h, 50.0), histogram_percentile(h, 95.0),
+             histogram_percentile(h, 99.0));
+   }
+   printf("  %-21s p50 %.0f, p95 %.0f, p99 %.0f\n", "think_usec",
+          histogram_percentile(&model->think_usec, 50.0),
+          histogram_percentile(&model->think_usec, 95.0),
+          histogram_percentile(&model->think_usec, 99.0));
+}
+
+//*****************************************************************************
+// generation
+//*****************************************************************************
+
+struct generator {
+   const struct model* model;
+   char** paths;
+   unsigned long long* file_weights[NUM_MODEL_OPS];  // cumulative op counts
+   double duration_usec;
+   size_t buffer_size;
+   struct timespec start;
+};
+
+struct gen_thread {
+   pthread_t thread;
+   struct generator* generator;
+   unsigned int seed;
+   int* fds;
+   long long* positions[NUM_DIRECTIONS];
+   int last_written;
+   char* buffer;
+   struct histogram latency[NUM_MODEL_OPS];
+   unsigned long long errors[NUM_MODEL_OPS];
+   unsigned long long bytes[NUM_DIRECTIONS];
+};
+
+//*****************************************************************************
+
+static unsigned long long random_below(unsigned int* seed, unsigned long long n)
+{
+   const unsigned long long r = ((unsigned long long) rand_r(seed) << 31) ^ rand_r(seed);
+
+   return n > 0 ? r % n : 0;
+}
+
+//*****************************************************************************
+
+// draws a value from a histogram: the upper bound of a bucket (request
+// sizes are mostly powers of 2), or uniformly within it
+static double sample_histogram(const struct histogram* h, unsigned int* seed, int uniform)
+{
+   unsigned long long target = random_below(seed, h->count);
+   double lower;
+   int i;
+
+   if (h->count == 0) {
+      return 0.0;
+   }
+   for (i = 0; i < HISTOGRAM_BUCKETS - 1 && target >= h->counts[i]; ++i) {
+      target -= h->counts[i];
+   }
+   if (!uniform) {
+      return histogram_bucket_upper(i);
+   }
+   lower = (i > 0) ? histogram_bucket_upper(i - 1) : 0.0;
+   return lower + (histogram_bucket_upper(i) - lower) * rand_r(seed) / RAND_MAX;
+}
+
+//*****************************************************************************
+
+// index of the entry hit by a random draw from cumulative weights
+static int pick(const unsigned long long* cumulative, int n, unsigned int* seed)
+{
+   const unsigned long long target = random_below(seed, cumulative[n - 1]);
+   int low = 0;
+   int high = n - 1;
+
+   while (low < high) {
+      const int mid = (low + high) / 2;
+      if (cumulative[mid] > target) {
+         high = mid;
+      } else {
+         low = mid + 1;
+      }
+   }
+   return low;
+}
+
+//*****************************************************************************
+
+static long long next_offset(struct gen_thread* thread, int file, int direction,
+                             size_t bytes)
+{
+   const struct model_file* model_file = &thread->generator->model->files[file];
+   const char* pattern = model_file->patterns[direction];
+   const long long size = model_file->size;
+   long long* position = &thread->positions[direction][file];
+   long long offset;
+
+   if (size <= 0) {
+      // unknown size: reads hit the end of file, writes append
+      offset = (direction == DIRECTION_WRITE) ? *position : 0;
+   } else if (!strcmp(pattern, "sequential")) {
+      offset = (*position + (long long) bytes <= size) ? *position : 0;
+   } else if (!strcmp(pattern, "reverse")) {
+      offset = *position - (long long) bytes;
+      if (offset < 0) {
+         offset = (size > (long long) bytes) ? size - bytes : 0;
+      }
+   } else if (!strcmp(pattern, "strided")) {
+      // stride of one request between requests
+      offset = *position + bytes;
+      if (offset + (long long) bytes > size) {
+         offset = 0;
+      }
+   } else {
+      offset = random_below(&thread->seed, size / bytes > 0 ? size / bytes : 1) * bytes;
+   }
+
+   *position = (!strcmp(pattern, "reverse")) ? offset : offset + bytes;
+   return offset;
+}
+
+//*****************************************************************************
+
+static int thread_fd(struct gen_thread* thread, int file)
+{
+   if (thread->fds[file] < 0) {
+      thread->fds[file] = open(thread->generator->paths[file], O_RDWR | O_CREAT,
+                               FILE_MODE);
+   }
+   return thread->fds[file];
+}
+
+//*****************************************************************************
+
+static long long elapsed_usec(const struct timespec* since)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - since->tv_sec) * 1000000LL +
+          (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+//*****************************************************************************
+
+static void run_op(struct gen_thread* thread, MODEL_OP_TYPE type, int file)
+{
+   struct generator* generator = thread->generator;
+   const int direction = (type == MODEL_READ) ? DIRECTION_READ : DIRECTION_WRITE;
+   struct timespec start;
+   struct stat st;
+   size_t bytes = 0;
+   long long offset = 0;
+   long long rc;
+   int fd = -1;
+
+   if (type == MODEL_READ || type == MODEL_WRITE) {
+      bytes = sample_histogram(&generator->model->request_bytes[direction],
+                               &thread->seed, 0);
+      if (bytes > generator->buffer_size) {
+         bytes = generator->buffer_size;
+      }
+      offset = next_offset(thread, file, direction, bytes);
+      fd = thread_fd(thread, file);
+   } else if (type == MODEL_SYNC) {
+      if (thread->last_written >= 0) {
+         file = thread->last_written;
+      }
+      fd = thread_fd(thread, file);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   switch (type) {
+      case MODEL_OPEN:
+         rc = open(generator->paths[file], O_RDWR | O_CREAT, FILE_MODE);
+         if (rc >= 0) {
+            close(rc);
+         }
+         break;
+      case MODEL_READ:
+         rc = pread(fd, thread->buffer, bytes, offset);
+         break;
+      case MODEL_WRITE:
+         rc = pwrite(fd, thread->buffer, bytes, offset);
+         thread->last_written = file;
+         break;
+      case MODEL_SYNC:
+         rc = fsync(fd);
+         break;
+      case MODEL_STAT:
+         rc = stat(generator->paths[file], &st);
+         break;
+      default:
+         return;
+   }
+   histogram_add(&thread->latency[type], elapsed_usec(&start));
+   if (rc < 0) {
+      thread->errors[type]++;
+   } else if (type == MODEL_READ || type == MODEL_WRITE) {
+      thread->bytes[direction] += rc;
+   }
+}
+
+//*****************************************************************************
+
+static void* run_thread(void* arg)
+{
+   struct gen_thread* thread = arg;
+   struct generator* generator = thread->generator;
+   const struct model* model = generator->model;
+   unsigned long long op_weights[NUM_MODEL_OPS];
+   unsigned long long total = 0;
+   long long sleep_debt_usec = 0;
+   int t;
+
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      total += model->ops[t];
+      op_weights[t] = total;
+   }
+
+   while (elapsed_usec(&generator->start) < generator->duration_usec) {
+      const MODEL_OP_TYPE type = pick(op_weights, NUM_MODEL_OPS, &thread->seed);
+      const int file = pick(generator->file_weights[type], model->num_files,
+                            &thread->seed);
+
+      run_op(thread, type, file);
+
+      sleep_debt_usec += sample_histogram(&model->think_usec, &thread->seed, 1);
+      if (sleep_debt_usec >= MIN_SLEEP_USEC) {
+         struct timespec delay;
+         delay.tv_sec = sleep_debt_usec / 1000000;
+         delay.tv_nsec = (sleep_debt_usec % 1000000) * 1000;
+         nanosleep(&delay, NULL);
+         sleep_debt_usec = 0;
+      }
+   }
+
+   for (t = 0; t < model->num_files; ++t) {
+      if (thread->fds[t] >= 0) {
+         close(thread->fds[t]);
+      }
+   }
+   return NULL;
+}
+
+//*****************************************************************************
+
+static int prepare_files(struct generator* generator, const char* dir)
+{
+   const struct model* model = generator->model;
+   char* chunk = malloc(FILL_CHUNK_SIZE);
+   int i;
+
+   memset(chunk, 'x', FILL_CHUNK_SIZE);
+   if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+      printf("error: unable to create directory '%s'\n", dir);
+      free(chunk);
+      return -1;
+   }
+
+   generator->paths = calloc(model->num_files, sizeof(char*));
+   for (i = 0; i < model->num_files; ++i) {
+      struct stat st;
+      long long size;
+      int fd;
+
+      generator->paths[i] = malloc(strlen(dir) + 16);
+      sprintf(generator->paths[i], "%s/f%d", dir, i);
+      fd = open(generator->paths[i], O_WRONLY | O_CREAT, FILE_MODE);
+      if (fd < 0 || fstat(fd, &st) != 0) {
+         printf("error: unable to create '%s'\n", generator->paths[i]);
+         free(chunk);
+         return -1;
+      }
+      for (size = st.st_size; size < model->files[i].size; size += FILL_CHUNK_SIZE) {
+         const size_t len = (model->files[i].size - size < (long long) FILL_CHUNK_SIZE) ?
+                            model->files[i].size - size : FILL_CHUNK_SIZE;
+         if (pwrite(fd, chunk, len, size) != (ssize_t) len) {
+            printf("error: unable to fill '%s'\n", generator->paths[i]);
+            close(fd);
+            free(chunk);
+            return -1;
+         }
+      }
+      close(fd);
+   }
+   free(chunk);
+   return 0;
+}
+
+//*****************************************************************************
+
+static int generate(const struct model* model, const char* dir, double duration_secs,
+                    double scale)
+{
+   struct generator generator;
+   struct gen_thread* threads;
+   struct histogram latency[NUM_MODEL_OPS];
+   unsigned long long errors[NUM_MODEL_OPS];
+   unsigned long long bytes[NUM_DIRECTIONS];
+   unsigned long long total_ops = 0;
+   double elapsed_secs;
+   int num_threads = (int) (model->threads * scale + 0.5);
+   int i;
+   int t;
+   int d;
+
+   if (num_threads < 1) {
+      num_threads = 1;
+   } else if (num_threads > MAX_THREADS) {
+      num_threads = MAX_THREADS;
+   }
+
+   memset(&generator, 0, sizeof(generator));
+   generator.model = model;
+   generator.duration_usec = duration_secs * 1e6;
+   for (d = 0; d < NUM_DIRECTIONS; ++d) {
+      const struct histogram* h = &model->request_bytes[d];
+      for (i = HISTOGRAM_BUCKETS - 1; i > 0 && h->counts[i] == 0; --i) {
+      }
+      if (histogram_bucket_upper(i) > generator.buffer_size) {
+         generator.buffer_size = histogram_bucket_upper(i);
+      }
+   }
+   if (generator.buffer_size > MAX_BUFFER_SIZE) {
+      generator.buffer_size = MAX_BUFFER_SIZE;
+   }
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      unsigned long long sum = 0;
+      generator.file_weights[t] = malloc(model->num_files * sizeof(unsigned long long));
+      for (i = 0; i < model->num_files; ++i) {
+         // files without this op still get a tiny weight so that ops the
+         // model has no files for can be drawn at all
+         sum += model->files[i].ops[t] ? model->files[i].ops[t] * 1024 : 1;
+         generator.file_weights[t][i] = sum;
+      }
+   }
+   if (prepare_files(&generator, dir) != 0) {
+      return -1;
+   }
+
+   printf("\n===== synthetic workload (%d threads, %.1f s)\n", num_threads, duration_secs);
+   fflush(stdout);
+
+   threads = calloc(num_threads, sizeof(struct gen_thread));
+   clock_gettime(CLOCK_MONOTONIC, &generator.start);
+   for (i = 0; i < num_threads; ++i) {
+      struct gen_thread* thread = &threads[i];
+      thread->generator = &generator;
+      thread->seed = i + 1;
+      thread->last_written = -1;
+      thread->fds = malloc(model->num_files * sizeof(int));
+      for (t = 0; t < model->num_files; ++t) {
+         thread->fds[t] = -1;
+      }
+      for (d = 0; d < NUM_DIRECTIONS; ++d) {
+         thread->positions[d] = calloc(model->num_files, sizeof(long long));
+      }
+      thread->buffer = malloc(generator.buffer_size + 1);
+      memset(thread->buffer, 'x', generator.buffer_size + 1);
+      if (pthread_create(&thread->thread, NULL, run_thread, thread) != 0) {
+         printf("error: unable to start thread\n");
+         exit(1);
+      }
+   }
+
+   memset(latency, 0, sizeof(latency));
+   memset(errors, 0, sizeof(errors));
+   memset(bytes, 0, sizeof(bytes));
+   for (i = 0; i < num_threads; ++i) {
+      pthread_join(threads[i].thread, NULL);
+      for (t = 0; t < NUM_MODEL_OPS; ++t) {
+         histogram_merge(&latency[t], &threads[i].latency[t]);
+         errors[t] += threads[i].errors[t];
+      }
+      for (d = 0; d < NUM_DIRECTIONS; ++d) {
+         bytes[d] += threads[i].bytes[d];
+         free(threads[i].positions[d]);
+      }
+      free(threads[i].fds);
+      free(threads[i].buffer);
+   }
+   elapsed_secs = elapsed_usec(&generator.start) / 1e6;
+
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      total_ops += latency[t].count;
+   }
+   printf("  operations            %llu (%.1f/s)\n", total_ops, total_ops / elapsed_secs);
+   printf("  bytes read            %llu (%.1f MB/s)\n", bytes[DIRECTION_READ],
+          bytes[DIRECTION_READ] / elapsed_secs / 1e6);
+   printf("  bytes written         %llu (%.1f MB/s)\n", bytes[DIRECTION_WRITE],
+          bytes[DIRECTION_WRITE] / elapsed_secs / 1e6);
+   printf("\n  %-6s %10s %8s %10s %10s %10s %10s %10s\n", "OP", "COUNT", "ERRORS",
+          "AVG(us)", "P50(us)", "P95(us)", "P99(us)", "MAX(us)");
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      const struct histogram* h = &latency[t];
+      if (h->count == 0) {
+         continue;
+      }
+      printf("  %-6s %10llu %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+             model_op_names[t], h->count, errors[t], h->sum / h->count,
+             histogram_percentile(h, 50.0), histogram_percentile(h, 95.0),
+             histogram_percentile(h, 99.0), h->max);
+   }
+
+   for (i = 0; i < model->num_files; ++i) {
+      free(generator.paths[i]);
+   }
+   for (t = 0; t < NUM_MODEL_OPS; ++t) {
+      free(generator.file_weights[t]);
+   }
+   free(generator.paths);
+   free(threads);
+   return 0;
+}
+
+//*****************************************************************************
+
+int main(int argc, char* argv[])
+{
+   const char* model_output_path = NULL;
+   const char* model_input_path = NULL;
+   const char* dir = NULL;
+   double duration_secs = 0.0;
+   double scale = 1.0;
+   struct model model;
+   int opt;
+   int rc = 0;
+
+   while ((opt = getopt(argc, argv, "o:g:d:T:x:")) != -1) {
+      switch (opt) {
+         case 'o':
+            model_output_path = optarg;
+            break;
+         case 'g':
+            model_input_path = optarg;
+            break;
+         case 'd':
+            dir = optarg;
+            break;
+         case 'T':
+            duration_secs = atof(optarg);
+            break;
+         case 'x':
+            scale = atof(optarg);
+            if (scale <= 0.0) {
+               printf("error: invalid scale '%s'\n", optarg);
+               exit(1);
+            }
+            break;
+         default:
+            usage(argv[0]);
+            exit(1);
+      }
+   }
+
+   if (model_input_path != NULL) {
+      if (dir == NULL) {
+         printf("error: missing arguments\n");
+         usage(argv[0]);
+         exit(1);
+      }
+      if (read_model(model_input_path, &model) != 0) {
+         exit(1);
+      }
+      print_model(&model);
+      rc = generate(&model, dir, duration_secs > 0.0 ? duration_secs : model.duration_secs,
+                    scale);
+   } else {
+      if (optind >= argc) {
+         printf("error: missing arguments\n");
+         usage(argv[0]);
+         exit(1);
+      }
+      if (fit_model(argv[optind], &model) != 0) {
+         exit(1);
+      }
+      if (model.num_files == 0) {
+         printf("error: no file operations in '%s'\n", argv[optind]);
+         exit(1);
+      }
+      print_model(&model);
+      if (model_output_path != NULL) {
+         rc = write_model(model_output_path, &model);
+      }
+   }
+
+   free(model.files);
+   return rc == 0 ? 0 : 1;
+}
+
+//*****************************************************************************
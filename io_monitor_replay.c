@@ -0,0 +1,795 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// io_monitor_replay.c
+//
+// replays the file operations of a capture (mq_listener -o) against a
+// scratch directory, as a repeatable storage benchmark:
+//
+// * open, close, read, write (positioned at the captured offset when
+//   known), fsync/fdatasync and stat are replayed; everything else is
+//   skipped. paths are recreated below the scratch directory (relative
+//   paths, and paths that climb above / with "..", are skipped), and files
+//   are filled before the replay up to the largest offset read, so that
+//   reads transfer the same number of bytes.
+// * each thread of the capture (pid, tid) is a stream whose operations
+//   run in their original order. streams are spread over a pool of
+//   worker threads, each of which runs its streams interleaved by start
+//   time.
+// * by default operations run as fast as possible; with -t each one
+//   waits for its original start time (relative to the first one),
+//   optionally sped up with -x.
+//
+// the latency distribution of each operation in the replay is reported
+// next to the one of the capture.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "domains.h"
+#include "ops.h"
+#include "capture.h"
+#include "histogram.h"
+#include "htable.h"
+#include "process_table.h"
+
+#define MAX_WORKERS 256
+
+static const int DEFAULT_MAX_WORKERS = 64;
+static const size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+static const size_t FILL_CHUNK_SIZE = 1024 * 1024;
+static const mode_t FILE_MODE = 0644;
+static const mode_t DIR_MODE = 0755;
+
+typedef enum {
+   REPLAY_OPEN,
+   REPLAY_CLOSE,
+   REPLAY_READ,
+   REPLAY_WRITE,
+   REPLAY_SYNC,
+   REPLAY_STAT,
+   NUM_REPLAY_OPS
+} REPLAY_OP_TYPE;
+
+static const char* replay_op_names[NUM_REPLAY_OPS] = {
+   "open", "close", "read", "write", "fsync", "stat"
+};
+
+struct replay_op {
+   long long start_usec;
+   double original_usec;
+   REPLAY_OP_TYPE type;
+   int stream;
+   int handle;          // open file instance, -1 for path-based stat
+   int file;            // path, for open and stat
+   int flags;           // open flags
+   size_t bytes;
+   long long offset;    // -1 to use the current position
+};
+
+struct replay_file {
+   char* path;          // below the scratch directory
+   long long size;      // largest offset read
+   int is_dir;
+   int needed;          // opened or successfully stat'ed in the capture
+};
+
+struct worker {
+   pthread_t thread;
+   size_t* ops;         // indexes into trace.ops, by start time
+   size_t num_ops;
+   char* buffer;
+   size_t buffer_size;
+   struct histogram latency[NUM_REPLAY_OPS];
+   unsigned long long errors[NUM_REPLAY_OPS];
+   unsigned long long unopened;   // handle not open (yet) in the replay
+};
+
+static struct {
+   struct replay_op* ops;
+   size_t num_ops;
+   size_t capacity;
+   struct replay_file* files;
+   int num_files;
+   int num_handles;
+   int num_streams;
+   size_t max_bytes;
+   long long first_usec;
+   long long last_usec;
+   unsigned long long skipped;     // records that are not replayed
+   unsigned long long unmapped;    // I/O on fds not opened in the capture
+   unsigned long long unsafe;      // opens and stats of paths kept out of the replay
+} trace;
+
+static int* handles;               // handle -> fd in the replay
+static int timed = 0;
+static double speed = 1.0;
+static struct timespec replay_start;
+
+//*****************************************************************************
+
+void usage(const char* program)
+{
+   printf("usage: %s [options] -d <scratch-dir> <capture-file>\n", program);
+   printf("  -d <dir>    directory to recreate the captured files in\n");
+   printf("  -j <n>      number of worker threads, default one per captured\n");
+   printf("              thread up to %d\n", DEFAULT_MAX_WORKERS);
+   printf("  -t          keep the original timing of the operations\n");
+   printf("  -x <factor> speed up the original timing by factor (implies -t)\n");
+}
+
+//*****************************************************************************
+
+// path without ".", ".." and repeated slashes, so that it stays below the
+// scratch directory once joined to it. returns -1 for relative paths and
+// paths that climb above /.
+static int normalize_path(const char* path, char* out, size_t out_len)
+{
+   size_t len = 0;
+   size_t part_len;
+   const char* part;
+
+   if (path[0] != '/' || strlen(path) >= out_len) {
+      return -1;
+   }
+   while (*path) {
+      while (*path == '/') {
+         path++;
+      }
+      part = path;
+      while (*path && *path != '/') {
+         path++;
+      }
+      part_len = path - part;
+      if (part_len == 0 || (part_len == 1 && part[0] == '.')) {
+         continue;
+      }
+      if (part_len == 2 && part[0] == '.' && part[1] == '.') {
+         if (len == 0) {
+            return -1;
+         }
+         while (len > 0 && out[len] != '/') {
+            len--;
+         }
+         continue;
+      }
+      out[len++] = '/';
+      memcpy(out + len, part, part_len);
+      len += part_len;
+   }
+   if (len == 0) {
+      out[len++] = '/';
+   }
+   out[len] = '\0';
+   return 0;
+}
+
+//*****************************************************************************
+
+// index of the file of a captured path, -1 if the path is kept out of
+// the replay
+static int get_file(struct htable* files, const char* scratch_dir, const char* captured_path)
+{
+   char path[PATH_MAX];
+   long index;
+
+   if (normalize_path(captured_path, path, sizeof(path)) != 0) {
+      trace.unsafe++;
+      return -1;
+   }
+   index = (long) htable_get_str(files, path);
+
+   if (index == 0) {
+      struct replay_file* file;
+
+      if (trace.num_files % 1024 == 0) {
+         trace.files = realloc(trace.files,
+                               (trace.num_files + 1024) * sizeof(struct replay_file));
+      }
+      file = &trace.files[trace.num_files];
+      memset(file, 0, sizeof(struct replay_file));
+      file->path = malloc(strlen(scratch_dir) + strlen(path) + 1);
+      sprintf(file->path, "%s%s", scratch_dir, path);
+      index = ++trace.num_files;
+      htable_put_str(files, path, (void*) index);
+   }
+   return (int) index - 1;
+}
+
+//*****************************************************************************
+
+static struct replay_op* add_op(const struct monitor_record_t* r, REPLAY_OP_TYPE type,
+                                int stream)
+{
+   struct replay_op* op;
+
+   if (trace.num_ops == trace.capacity) {
+      trace.capacity = trace.capacity ? trace.capacity * 2 : 65536;
+      trace.ops = realloc(trace.ops, trace.capacity * sizeof(struct replay_op));
+   }
+   op = &trace.ops[trace.num_ops++];
+   memset(op, 0, sizeof(struct replay_op));
+   op->start_usec = r->start_usec;
+   op->original_usec = r->elapsed_time * 1000.0;
+   op->type = type;
+   op->stream = stream;
+   op->handle = -1;
+   op->file = -1;
+   op->offset = -1;
+
+   if (trace.num_ops == 1 || r->start_usec < trace.first_usec) {
+      trace.first_usec = r->start_usec;
+   }
+   if (r->start_usec > trace.last_usec) {
+      trace.last_usec = r->start_usec;
+   }
+   return op;
+}
+
+//*****************************************************************************
+
+// open flags from s2: octal flags for open/creat, a mode for fopen
+static int parse_open_flags(const char* s)
+{
+   int flags;
+
+   if (s[0] >= '0' && s[0] <= '9') {
+      return (int) strtol(s, NULL, 8);
+   }
+   if (s[0] == '\0') {
+      return O_RDWR;
+   }
+
+   flags = strchr(s, '+') ? O_RDWR : (s[0] == 'r' ? O_RDONLY : O_WRONLY);
+   if (s[0] == 'w') {
+      flags |= O_CREAT | O_TRUNC;
+   } else if (s[0] == 'a') {
+      flags |= O_CREAT | O_APPEND;
+   }
+   return flags;
+}
+
+//*****************************************************************************
+
+static int load_trace(const char* path, const char* scratch_dir)
+{
+   struct monitor_record_t* r = malloc(sizeof(struct monitor_record_t));
+   struct htable files;         // path -> file index + 1
+   struct htable fd_handles;    // (pid, fd) -> handle + 1
+   struct htable streams;       // (pid, tid) -> stream + 1
+   int* handle_files = NULL;    // handle -> file
+   FILE* capture = capture_open(path);
+   int rc;
+
+   if (capture == NULL) {
+      free(r);
+      return -1;
+   }
+
+   process_table_init();
+   htable_init(&files);
+   htable_init(&fd_handles);
+   htable_init(&streams);
+
+   while ((rc = capture_read(capture, r)) > 0) {
+      const long fd_key = ((long) r->pid << 32) | (unsigned int) r->fd;
+      const long stream_key = ((long) r->pid << 32) | (unsigned int) r->tid;
+      long handle = 0;
+      long stream;
+      int file_index;
+      struct replay_op* op;
+
+      process_table_update(r);
+
+      stream = (long) htable_get_int(&streams, stream_key);
+      if (stream == 0) {
+         stream = ++trace.num_streams;
+         htable_put_int(&streams, stream_key, (void*) stream);
+      }
+      stream--;
+      if (r->fd >= 0) {
+         handle = (long) htable_get_int(&fd_handles, fd_key);
+      }
+
+      if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE &&
+          r->error_code == 0 && r->fd >= 0 && r->s1[0]) {
+         file_index = get_file(&files, scratch_dir, r->s1);
+         if (file_index < 0) {
+            // its I/O is then skipped as on an unknown fd
+            if (handle != 0) {
+               htable_remove_int(&fd_handles, fd_key);
+            }
+            process_table_release(r);
+            continue;
+         }
+         op = add_op(r, REPLAY_OPEN, stream);
+         op->file = file_index;
+         op->flags = parse_open_flags(r->s2);
+         op->handle = trace.num_handles++;
+         if (op->handle % 1024 == 0) {
+            handle_files = realloc(handle_files, (op->handle + 1024) * sizeof(int));
+         }
+         handle_files[op->handle] = op->file;
+         trace.files[op->file].needed = 1;
+         if (op->flags & O_DIRECTORY) {
+            trace.files[op->file].is_dir = 1;
+         }
+         if (handle != 0) {
+            // CLOSE not seen
+            htable_remove_int(&fd_handles, fd_key);
+         }
+         htable_put_int(&fd_handles, fd_key, (void*) (long) (op->handle + 1));
+      } else if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE &&
+                 handle != 0) {
+         op = add_op(r, REPLAY_CLOSE, stream);
+         op->handle = handle - 1;
+         htable_remove_int(&fd_handles, fd_key);
+      } else if ((r->dom_type == FILE_READ || r->dom_type == FILE_WRITE) &&
+                 (r->op_type == READ || r->op_type == WRITE) && r->error_code == 0) {
+         if (handle == 0) {
+            trace.unmapped++;
+         } else {
+            op = add_op(r, r->op_type == READ ? REPLAY_READ : REPLAY_WRITE, stream);
+            op->handle = handle - 1;
+            op->bytes = r->bytes_transferred;
+            op->offset = r->offset;
+            if (op->bytes > trace.max_bytes) {
+               trace.max_bytes = op->bytes;
+            }
+            if (op->type == REPLAY_READ && op->offset >= 0) {
+               struct replay_file* file = &trace.files[handle_files[op->handle]];
+               if (op->offset + (long long) op->bytes > file->size) {
+                  file->size = op->offset + op->bytes;
+               }
+            }
+         }
+      } else if (r->op_type == SYNC && r->fd >= 0) {
+         if (handle == 0) {
+            trace.unmapped++;
+         } else {
+            op = add_op(r, REPLAY_SYNC, stream);
+            op->handle = handle - 1;
+         }
+      } else if (r->op_type == STAT && r->fd >= 0) {
+         if (handle == 0) {
+            trace.unmapped++;
+         } else {
+            op = add_op(r, REPLAY_STAT, stream);
+            op->handle = handle - 1;
+         }
+      } else if (r->op_type == STAT && r->s1[0]) {
+         file_index = get_file(&files, scratch_dir, r->s1);
+         if (file_index < 0) {
+            process_table_release(r);
+            continue;
+         }
+         op = add_op(r, REPLAY_STAT, stream);
+         op->file = file_index;
+         if (r->error_code == 0) {
+            trace.files[op->file].needed = 1;
+         }
+      } else if (r->dom_type != START_STOP) {
+         trace.skipped++;
+      }
+
+      process_table_release(r);
+   }
+
+   if (rc < 0) {
+      printf("error: capture file '%s' is truncated\n", path);
+   }
+
+   free(handle_files);
+   htable_destroy(&files, NULL);
+   htable_destroy(&fd_handles, NULL);
+   htable_destroy(&streams, NULL);
+   process_table_fini();
+   fclose(capture);
+   free(r);
+   return 0;
+}
+
+//*****************************************************************************
+
+static int make_dirs(char* path, int including_last)
+{
+   char* slash = path;
+
+   while ((slash = strchr(slash + 1, '/')) != NULL) {
+      *slash = '\0';
+      if (mkdir(path, DIR_MODE) != 0 && errno != EEXIST) {
+         *slash = '/';
+         return -1;
+      }
+      *slash = '/';
+   }
+   if (including_last && mkdir(path, DIR_MODE) != 0 && errno != EEXIST) {
+      return -1;
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+// recreates the directories and files, and fills the files up to the
+// largest offset read. existing files are reused.
+static int prepare_files()
+{
+   char* chunk = malloc(FILL_CHUNK_SIZE);
+   int i;
+
+   memset(chunk, 'x', FILL_CHUNK_SIZE);
+
+   for (i = 0; i < trace.num_files; ++i) {
+      struct replay_file* file = &trace.files[i];
+      struct stat st;
+      long long size;
+      int fd;
+
+      if (make_dirs(file->path, file->is_dir) != 0) {
+         printf("error: unable to create directory for '%s'\n", file->path);
+         free(chunk);
+         return -1;
+      }
+      if (!file->needed || file->is_dir) {
+         continue;
+      }
+
+      fd = open(file->path, O_WRONLY | O_CREAT, FILE_MODE);
+      if (fd < 0 || fstat(fd, &st) != 0) {
+         printf("error: unable to create '%s'\n", file->path);
+         free(chunk);
+         return -1;
+      }
+      for (size = st.st_size; size < file->size; size += FILL_CHUNK_SIZE) {
+         const size_t len = (file->size - size < (long long) FILL_CHUNK_SIZE) ?
+                            file->size - size : FILL_CHUNK_SIZE;
+         if (pwrite(fd, chunk, len, size) != (ssize_t) len) {
+            printf("error: unable to fill '%s'\n", file->path);
+            close(fd);
+            free(chunk);
+            return -1;
+         }
+      }
+      close(fd);
+   }
+
+   free(chunk);
+   return 0;
+}
+
+//*****************************************************************************
+
+static long long elapsed_usec(const struct timespec* since)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - since->tv_sec) * 1000000LL +
+          (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+//*****************************************************************************
+
+static void wait_for_start(const struct replay_op* op)
+{
+   const long long target_usec = (op->start_usec - trace.first_usec) / speed;
+   const long long wait_usec = target_usec - elapsed_usec(&replay_start);
+
+   if (wait_usec > 0) {
+      struct timespec delay;
+      delay.tv_sec = wait_usec / 1000000;
+      delay.tv_nsec = (wait_usec % 1000000) * 1000;
+      nanosleep(&delay, NULL);
+   }
+}
+
+//*****************************************************************************
+
+// reads or writes bytes in chunks of the worker's buffer
+static ssize_t transfer(struct worker* worker, const struct replay_op* op, int fd)
+{
+   size_t done = 0;
+
+   while (done < op->bytes) {
+      const size_t len = (op->bytes - done < worker->buffer_size) ?
+                         op->bytes - done : worker->buffer_size;
+      ssize_t rc;
+
+      if (op->type == REPLAY_READ) {
+         rc = (op->offset >= 0) ? pread(fd, worker->buffer, len, op->offset + done) :
+                                  read(fd, worker->buffer, len);
+      } else {
+         rc = (op->offset >= 0) ? pwrite(fd, worker->buffer, len, op->offset + done) :
+                                  write(fd, worker->buffer, len);
+      }
+      if (rc <= 0) {
+         return rc < 0 ? -1 : (ssize_t) done;
+      }
+      done += rc;
+   }
+   return done;
+}
+
+//*****************************************************************************
+
+static void run_op(struct worker* worker, const struct replay_op* op)
+{
+   struct timespec start;
+   struct stat st;
+   long long rc;
+   int fd = -1;
+
+   if (op->handle >= 0 && op->type != REPLAY_OPEN) {
+      fd = (op->type == REPLAY_CLOSE) ?
+           __atomic_exchange_n(&handles[op->handle], -1, __ATOMIC_ACQ_REL) :
+           __atomic_load_n(&handles[op->handle], __ATOMIC_ACQUIRE);
+      if (fd < 0) {
+         // opened by another thread that has not got there yet
+         worker->unopened++;
+         return;
+      }
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   switch (op->type) {
+      case REPLAY_OPEN:
+         rc = open(trace.files[op->file].path,
+                   (op->flags & ~O_EXCL) | (trace.files[op->file].is_dir ? 0 : O_CREAT),
+                   FILE_MODE);
+         if (rc >= 0) {
+            __atomic_store_n(&handles[op->handle], (int) rc, __ATOMIC_RELEASE);
+         }
+         break;
+      case REPLAY_CLOSE:
+         rc = close(fd);
+         break;
+      case REPLAY_READ:
+      case REPLAY_WRITE:
+         rc = transfer(worker, op, fd);
+         break;
+      case REPLAY_SYNC:
+         rc = fsync(fd);
+         break;
+      case REPLAY_STAT:
+         rc = (fd >= 0) ? fstat(fd, &st) : stat(trace.files[op->file].path, &st);
+         break;
+      default:
+         return;
+   }
+   histogram_add(&worker->latency[op->type], elapsed_usec(&start));
+   if (rc < 0) {
+      worker->errors[op->type]++;
+   }
+}
+
+//*****************************************************************************
+
+static void* run_worker(void* arg)
+{
+   struct worker* worker = arg;
+   size_t i;
+
+   for (i = 0; i < worker->num_ops; ++i) {
+      const struct replay_op* op = &trace.ops[worker->ops[i]];
+      if (timed) {
+         wait_for_start(op);
+      }
+      run_op(worker, op);
+   }
+   return NULL;
+}
+
+//*****************************************************************************
+
+static int compare_ops(const void* a, const void* b)
+{
+   const size_t ia = *(const size_t*) a;
+   const size_t ib = *(const size_t*) b;
+   const long long sa = trace.ops[ia].start_usec;
+   const long long sb = trace.ops[ib].start_usec;
+
+   // same start time: keep the original order
+   if (sa != sb) {
+      return (sa > sb) - (sa < sb);
+   }
+   return (ia > ib) - (ia < ib);
+}
+
+//*****************************************************************************
+
+static void print_latency_row(const char* name, const char* source,
+                              const struct histogram* h, unsigned long long errors)
+{
+   printf("  %-6s %-8s %10llu %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+          name, source, h->count, errors, h->count ? h->sum / h->count : 0.0,
+          histogram_percentile(h, 50.0), histogram_percentile(h, 95.0),
+          histogram_percentile(h, 99.0), h->max);
+}
+
+//*****************************************************************************
+
+int main(int argc, char* argv[])
+{
+   const char* scratch_dir = NULL;
+   int num_workers = 0;
+   struct worker* workers;
+   struct histogram original[NUM_REPLAY_OPS];
+   struct histogram replayed[NUM_REPLAY_OPS];
+   unsigned long long errors[NUM_REPLAY_OPS];
+   unsigned long long unopened = 0;
+   size_t* worker_op_counts;
+   size_t i;
+   int opt;
+   int w;
+   int t;
+
+   while ((opt = getopt(argc, argv, "d:j:tx:")) != -1) {
+      switch (opt) {
+         case 'd':
+            scratch_dir = optarg;
+            break;
+         case 'j':
+            num_workers = atoi(optarg);
+            if (num_workers < 1 || num_workers > MAX_WORKERS) {
+               printf("error: number of workers must be between 1 and %d\n", MAX_WORKERS);
+               exit(1);
+            }
+            break;
+         case 't':
+            timed = 1;
+            break;
+         case 'x':
+            timed = 1;
+            speed = atof(optarg);
+            if (speed <= 0.0) {
+               printf("error: invalid speed factor '%s'\n", optarg);
+               exit(1);
+            }
+            break;
+         default:
+            usage(argv[0]);
+            exit(1);
+      }
+   }
+
+   if (optind >= argc || scratch_dir == NULL) {
+      printf("error: missing arguments\n");
+      usage(argv[0]);
+      exit(1);
+   }
+
+   if (load_trace(argv[optind], scratch_dir) != 0) {
+      exit(1);
+   }
+   if (trace.num_ops == 0) {
+      printf("error: no file operations to replay in '%s'\n", argv[optind]);
+      exit(1);
+   }
+   if (prepare_files() != 0) {
+      exit(1);
+   }
+
+   if (num_workers == 0) {
+      num_workers = trace.num_streams < DEFAULT_MAX_WORKERS ?
+                    trace.num_streams : DEFAULT_MAX_WORKERS;
+   }
+
+   handles = malloc((trace.num_handles + 1) * sizeof(int));
+   for (t = 0; t < trace.num_handles; ++t) {
+      handles[t] = -1;
+   }
+
+   // streams are assigned to workers round robin
+   workers = calloc(num_workers, sizeof(struct worker));
+   worker_op_counts = calloc(num_workers, sizeof(size_t));
+   for (i = 0; i < trace.num_ops; ++i) {
+      worker_op_counts[trace.ops[i].stream % num_workers]++;
+   }
+   for (w = 0; w < num_workers; ++w) {
+      workers[w].ops = malloc((worker_op_counts[w] + 1) * sizeof(size_t));
+      workers[w].buffer_size = trace.max_bytes < MAX_BUFFER_SIZE ?
+                               trace.max_bytes : MAX_BUFFER_SIZE;
+      if (workers[w].buffer_size == 0) {
+         workers[w].buffer_size = 1;
+      }
+      workers[w].buffer = malloc(workers[w].buffer_size);
+      memset(workers[w].buffer, 'x', workers[w].buffer_size);
+   }
+   for (i = 0; i < trace.num_ops; ++i) {
+      struct worker* worker = &workers[trace.ops[i].stream % num_workers];
+      worker->ops[worker->num_ops++] = i;
+   }
+   for (w = 0; w < num_workers; ++w) {
+      qsort(workers[w].ops, workers[w].num_ops, sizeof(size_t), compare_ops);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &replay_start);
+   for (w = 0; w < num_workers; ++w) {
+      if (pthread_create(&workers[w].thread, NULL, run_worker, &workers[w]) != 0) {
+         printf("error: unable to start worker thread\n");
+         exit(1);
+      }
+   }
+   for (w = 0; w < num_workers; ++w) {
+      pthread_join(workers[w].thread, NULL);
+   }
+
+   memset(original, 0, sizeof(original));
+   memset(replayed, 0, sizeof(replayed));
+   memset(errors, 0, sizeof(errors));
+   for (i = 0; i < trace.num_ops; ++i) {
+      histogram_add(&original[trace.ops[i].type], trace.ops[i].original_usec);
+   }
+   for (w = 0; w < num_workers; ++w) {
+      for (t = 0; t < NUM_REPLAY_OPS; ++t) {
+         histogram_merge(&replayed[t], &workers[w].latency[t]);
+         errors[t] += workers[w].errors[t];
+      }
+      unopened += workers[w].unopened;
+   }
+
+   printf("===== replay of %s\n", argv[optind]);
+   printf("  operations            %zu (%d threads, %d files)\n", trace.num_ops,
+          trace.num_streams, trace.num_files);
+   printf("  workers               %d\n", num_workers);
+   if (timed) {
+      printf("  timing                original, %.2fx\n", speed);
+   } else {
+      printf("  timing                as fast as possible\n");
+   }
+   printf("  original duration     %.3f s\n", (trace.last_usec - trace.first_usec) / 1e6);
+   printf("  replay duration       %.3f s\n", elapsed_usec(&replay_start) / 1e6);
+   printf("  skipped, other ops    %llu\n", trace.skipped);
+   printf("  skipped, unknown fd   %llu (not opened in the capture)\n", trace.unmapped);
+   printf("  skipped, unsafe path  %llu (relative, or climbing above /)\n", trace.unsafe);
+   printf("  skipped, fd not open  %llu (not opened yet in the replay)\n", unopened);
+
+   printf("\n  %-6s %-8s %10s %8s %10s %10s %10s %10s %10s\n", "OP", "SOURCE",
+          "COUNT", "ERRORS", "AVG(us)", "P50(us)", "P95(us)", "P99(us)", "MAX(us)");
+   for (t = 0; t < NUM_REPLAY_OPS; ++t) {
+      if (original[t].count == 0) {
+         continue;
+      }
+      print_latency_row(replay_op_names[t], "capture", &original[t], 0);
+      print_latency_row("", "replay", &replayed[t], errors[t]);
+   }
+
+   for (w = 0; w < num_workers; ++w) {
+      free(workers[w].ops);
+      free(workers[w].buffer);
+   }
+   for (t = 0; t < trace.num_files; ++t) {
+      free(trace.files[t].path);
+   }
+   free(workers);
+   free(worker_op_counts);
+   free(handles);
+   free(trace.files);
+   free(trace.ops);
+   return 0;
+}
+
+//*****************************************************************************
@@ -0,0 +1,378 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// io_sampler.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "io_sampler.h"
+
+static const time_t SAMPLE_INTERVAL_SECS = 10;
+
+// intervals with fewer file bytes read are too small for a hit rate
+static const double MIN_HIT_RATE_BYTES = 1024 * 1024;
+
+#define NUM_COUNTERS 5
+enum { RCHAR, WCHAR, READ_BYTES, WRITE_BYTES, CANCELLED_WRITE_BYTES };
+static const char* counter_names[NUM_COUNTERS] = {
+   "rchar", "wchar", "read_bytes", "write_bytes", "cancelled_write_bytes"
+};
+
+struct shim_counts {
+   unsigned long long reads;
+   unsigned long long read_bytes;
+   unsigned long long writes;
+   unsigned long long write_bytes;
+};
+
+struct sampled_process {
+   int pid;
+   char command[40];
+   int have_baseline;
+   int unreadable;                     // io file could not be read at all
+   time_t sampled_at;
+   long long counters[NUM_COUNTERS];   // at the last sample
+   struct shim_counts interval;        // since the last sample
+   // totals over the sampled intervals
+   unsigned long long samples;
+   struct shim_counts total;
+   long long total_counters[NUM_COUNTERS];
+   double worst_hit;                   // lowest hit rate of an interval
+   time_t worst_hit_time;
+};
+
+static FILE* report_output = NULL;
+static FILE* series = NULL;
+static struct htable processes;   // pid -> struct sampled_process*
+static time_t last_sample = 0;
+static unsigned long long unreadable = 0;
+
+//*****************************************************************************
+
+int io_sampler_init(FILE* output, const char* series_path)
+{
+   report_output = output;
+   htable_init(&processes);
+   if (series_path != NULL) {
+      series = fopen(series_path, "w");
+      if (series == NULL) {
+         printf("error: unable to write I/O samples to '%s'\n", series_path);
+         return -1;
+      }
+      fprintf(series, "time,pid,interval_secs,shim_reads,shim_read_bytes,rchar,read_bytes,"
+                      "cache_hit_pct,shim_writes,shim_write_bytes,wchar,write_bytes,"
+                      "cancelled_write_bytes\n");
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+// 0 on success, -1 if the process is gone or its io file is not readable
+static int read_proc_io(int pid, long long* counters)
+{
+   char path[64];
+   char line[128];
+   FILE* file;
+   int found = 0;
+   int i;
+
+   snprintf(path, sizeof(path), "/proc/%d/io", pid);
+   file = fopen(path, "r");
+   if (file == NULL) {
+      return -1;
+   }
+   while (fgets(line, sizeof(line), file) != NULL) {
+      for (i = 0; i < NUM_COUNTERS; ++i) {
+         const size_t len = strlen(counter_names[i]);
+         if (!strncmp(line, counter_names[i], len) && line[len] == ':') {
+            counters[i] = atoll(line + len + 1);
+            found++;
+            break;
+         }
+      }
+   }
+   fclose(file);
+   return found == NUM_COUNTERS ? 0 : -1;
+}
+
+//*****************************************************************************
+
+// hit rate of the file reads the shim saw, -1 if there were too few
+static double cache_hit(double shim_read_bytes, double disk_read_bytes)
+{
+   double hit;
+
+   if (shim_read_bytes < MIN_HIT_RATE_BYTES) {
+      return -1.0;
+   }
+   hit = 1.0 - disk_read_bytes / shim_read_bytes;
+   return hit < 0.0 ? 0.0 : hit;
+}
+
+//*****************************************************************************
+
+// returns -1 if the process can no longer be sampled
+static int sample(struct sampled_process* p, time_t now)
+{
+   long long counters[NUM_COUNTERS];
+   long long delta[NUM_COUNTERS];
+   double hit;
+   int i;
+
+   if (read_proc_io(p->pid, counters) != 0) {
+      return -1;
+   }
+   if (!p->have_baseline) {
+      // what the shim saw before the baseline cannot be compared
+      memcpy(p->counters, counters, sizeof(counters));
+      memset(&p->interval, 0, sizeof(struct shim_counts));
+      p->have_baseline = 1;
+      p->sampled_at = now;
+      return 0;
+   }
+
+   for (i = 0; i < NUM_COUNTERS; ++i) {
+      delta[i] = counters[i] - p->counters[i];
+      p->total_counters[i] += delta[i];
+   }
+   memcpy(p->counters, counters, sizeof(counters));
+
+   hit = cache_hit(p->interval.read_bytes, delta[READ_BYTES]);
+   if (hit >= 0.0 && (p->samples == 0 || p->worst_hit < 0.0 || hit < p->worst_hit)) {
+      p->worst_hit = hit;
+      p->worst_hit_time = now;
+   }
+   if (series != NULL) {
+      fprintf(series, "%ld,%d,%ld,%llu,%llu,%lld,%lld,", (long) now, p->pid,
+              (long) (now - p->sampled_at), p->interval.reads, p->interval.read_bytes,
+              delta[RCHAR], delta[READ_BYTES]);
+      if (hit >= 0.0) {
+         fprintf(series, "%.1f", 100.0 * hit);
+      }
+      fprintf(series, ",%llu,%llu,%lld,%lld,%lld\n", p->interval.writes,
+              p->interval.write_bytes, delta[WCHAR], delta[WRITE_BYTES],
+              delta[CANCELLED_WRITE_BYTES]);
+   }
+
+   p->samples++;
+   p->total.reads += p->interval.reads;
+   p->total.read_bytes += p->interval.read_bytes;
+   p->total.writes += p->interval.writes;
+   p->total.write_bytes += p->interval.write_bytes;
+   memset(&p->interval, 0, sizeof(struct shim_counts));
+   p->sampled_at = now;
+   return 0;
+}
+
+//*****************************************************************************
+
+static void print_process(const struct sampled_process* p);
+
+static struct sampled_process* get_process(const struct process_info* process, int pid)
+{
+   struct sampled_process* p = htable_get_int(&processes, pid);
+
+   if (p == NULL) {
+      p = calloc(1, sizeof(struct sampled_process));
+      p->pid = pid;
+      p->worst_hit = -1.0;
+      htable_put_int(&processes, pid, p);
+   }
+   if (p->command[0] == '\0' && process != NULL && process->cmdline != NULL) {
+      snprintf(p->command, sizeof(p->command), "%s", process->cmdline);
+   }
+   return p;
+}
+
+//*****************************************************************************
+
+void io_sampler_record(const struct process_info* process,
+                       const struct monitor_record_t* r)
+{
+   struct sampled_process* p;
+
+   if (report_output == NULL && series == NULL) {
+      return;
+   }
+
+   if (r->op_type == STOP) {
+      // the process is about to exit; take what it did since the last
+      // sample if it is still there
+      p = htable_remove_int(&processes, r->pid);
+      if (p != NULL) {
+         if (p->have_baseline) {
+            sample(p, time(NULL));
+         }
+         if (p->samples > 0) {
+            print_process(p);
+         }
+         free(p);
+      }
+      return;
+   }
+   p = get_process(process, r->pid);
+   if (p->unreadable) {
+      return;
+   }
+   if (r->error_code != 0 || r->fd < 0 || record_path(process, r) == NULL) {
+      return;
+   }
+   if (r->op_type == READ && r->dom_type == FILE_READ) {
+      p->interval.reads++;
+      p->interval.read_bytes += r->bytes_transferred;
+   } else if (r->op_type == WRITE && r->dom_type == FILE_WRITE) {
+      p->interval.writes++;
+      p->interval.write_bytes += r->bytes_transferred;
+   }
+}
+
+//*****************************************************************************
+
+struct tick_context {
+   time_t now;
+   int* gone;
+   size_t num_gone;
+};
+
+static void sample_process(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct sampled_process* p = value;
+   struct tick_context* tick = ctx;
+
+   if (p->unreadable) {
+      return;
+   }
+   if (sample(p, tick->now) != 0) {
+      if (!p->have_baseline) {
+         // not readable by the listener (or gone before its first sample).
+         // kept and counted once, so that its records don't bring it back
+         p->unreadable = 1;
+         unreadable++;
+      } else {
+         tick->gone[tick->num_gone++] = p->pid;
+      }
+   }
+}
+
+//*****************************************************************************
+
+void io_sampler_tick(time_t now)
+{
+   struct tick_context tick;
+   struct sampled_process* p;
+   size_t i;
+
+   if ((report_output == NULL && series == NULL) ||
+       now - last_sample < SAMPLE_INTERVAL_SECS) {
+      return;
+   }
+   last_sample = now;
+
+   tick.now = now;
+   tick.gone = malloc((processes.count + 1) * sizeof(int));
+   tick.num_gone = 0;
+   htable_foreach(&processes, sample_process, &tick);
+
+   // processes that exited (or cannot be read) are reported and dropped
+   for (i = 0; i < tick.num_gone; ++i) {
+      p = htable_remove_int(&processes, tick.gone[i]);
+      if (p->samples > 0) {
+         print_process(p);
+      }
+      free(p);
+   }
+   free(tick.gone);
+   if (series != NULL) {
+      fflush(series);
+   }
+}
+
+//*****************************************************************************
+
+static int header_printed = 0;
+
+static void format_hit(char* buf, size_t len, double hit)
+{
+   if (hit >= 0.0) {
+      snprintf(buf, len, "%.1f", 100.0 * hit);
+   } else {
+      snprintf(buf, len, "-");
+   }
+}
+
+static void print_process(const struct sampled_process* p)
+{
+   char hit[16];
+   char worst[16];
+   const double total_hit = cache_hit(p->total.read_bytes, p->total_counters[READ_BYTES]);
+
+   if (report_output == NULL) {
+      return;
+   }
+   if (!header_printed) {
+      fprintf(report_output, "\n===== sampled I/O (/proc/<pid>/io every %lds)\n",
+              (long) SAMPLE_INTERVAL_SECS);
+      fprintf(report_output, "  %7s %7s %14s %14s %8s %8s %14s %14s %14s  %s\n",
+              "PID", "SAMPLES", "SHIM READ", "DISK READ", "CACHE%", "WORST%",
+              "SHIM WRITE", "DISK WRITE", "CANCELLED", "COMMAND");
+      header_printed = 1;
+   }
+   format_hit(hit, sizeof(hit), total_hit);
+   format_hit(worst, sizeof(worst), p->worst_hit);
+   fprintf(report_output, "  %7d %7llu %14llu %14lld %8s %8s %14llu %14lld %14lld  %s\n",
+           p->pid, p->samples, p->total.read_bytes, p->total_counters[READ_BYTES], hit,
+           worst, p->total.write_bytes, p->total_counters[WRITE_BYTES],
+           p->total_counters[CANCELLED_WRITE_BYTES], p->command);
+}
+
+static void print_sampled(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct sampled_process* p = value;
+
+   if (p->samples > 0) {
+      print_process(p);
+   }
+}
+
+//*****************************************************************************
+
+void io_sampler_report()
+{
+   if (report_output == NULL && series == NULL) {
+      return;
+   }
+
+   htable_foreach(&processes, print_sampled, NULL);
+   if (report_output != NULL) {
+      if (unreadable > 0) {
+         fprintf(report_output, "  %llu processes could not be sampled\n", unreadable);
+      }
+      fflush(report_output);
+   }
+   if (series != NULL) {
+      fclose(series);
+      series = NULL;
+   }
+   htable_destroy(&processes, free);
+}
+
+//*****************************************************************************
@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __IO_SAMPLER_H
+#define __IO_SAMPLER_H
+#include <stdio.h>
+#include <time.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// samples /proc/<pid>/io of the monitored processes at a low rate and
+// pairs the deltas of the kernel's counters with the reads and writes the
+// shim saw in the same interval: a live estimate of the page cache hit
+// rate of each process. the listener must see the processes' pids (same
+// pid namespace) and be allowed to read their io files.
+
+// returns -1 if the series file cannot be created
+int io_sampler_init(FILE* output, const char* series_path);
+void io_sampler_record(const struct process_info* process,
+                       const struct monitor_record_t* monitor_record);
+void io_sampler_tick(time_t now);
+void io_sampler_report();
+
+#endif //__IO_SAMPLER_H
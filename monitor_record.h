@@ -2,12 +2,21 @@
 #define __MONITOR_RECORD_H
 #include <linux/limits.h>
 #define STR_LEN 256
+#define MAX_STACK_FRAMES 16
+#define CONTAINER_ID_LEN 32
 
 struct monitor_record_t {
   char facility[STR_LEN];
   int timestamp;
+  long long start_usec;   // start of operation, usec since the epoch
   float elapsed_time;
+  float cpu_time;         // on-CPU time of the call (ms), -1 if not measured (CPU_TIME)
   int pid;
+  int tid;                // kernel thread id of the calling thread
+
+  // container/cgroup the process runs in (derived once at startup)
+  char container_id[CONTAINER_ID_LEN];
+  unsigned long mnt_ns;
 
   int dom_type;
   int op_type;
@@ -15,8 +24,22 @@ struct monitor_record_t {
   int error_code;
   int fd;
   size_t bytes_transferred;
+  long long offset;       // file offset accessed (or seeked to), -1 if unknown
+  // file opened (only filled in for OPEN when STAT_ON_OPEN is set)
+  long long file_size;    // size of a regular file, -1 if unknown
+  unsigned long inode;    // 0 if unknown
+  unsigned long dev;      // st_dev of the file, 0 if unknown
+  long fs_type;           // statfs f_type (magic) of its filesystem, 0 if unknown
+  // bytes of the file in the page cache at open (only filled in when
+  // CACHE_PROBE is set and the open was probed), -1 if not probed
+  long long resident_bytes;
   char s1[PATH_MAX];
   char s2[STR_LEN];
+
+  // call-site attribution (only filled in when CAPTURE_CALLER is set)
+  unsigned long caller;
+  int stack_depth;
+  unsigned long stack[MAX_STACK_FRAMES];
 };
 
 #endif
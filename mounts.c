@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// mounts.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysmacros.h>
+#include "mounts.h"
+
+static const char* MOUNTINFO_PATH = "/proc/self/mountinfo";
+
+struct mount_entry {
+   struct mount_info info;
+   size_t mount_point_len;
+   int whole_fs;              // the root of the filesystem is mounted
+};
+
+static struct mount_entry* mounts = NULL;
+static size_t num_mounts = 0;
+static int loaded = 0;
+
+//*****************************************************************************
+
+// undo the octal escapes of mountinfo (e.g. "\040" for a space)
+static void unescape(char* s)
+{
+   char* out = s;
+
+   while (*s) {
+      if (s[0] == '\\' && s[1] >= '0' && s[1] <= '7' && s[2] >= '0' && s[2] <= '7' &&
+          s[3] >= '0' && s[3] <= '7') {
+         *out++ = (char) ((s[1] - '0') * 64 + (s[2] - '0') * 8 + (s[3] - '0'));
+         s += 4;
+      } else {
+         *out++ = *s++;
+      }
+   }
+   *out = '\0';
+}
+
+//*****************************************************************************
+
+// "36 35 98:0 /root /mnt/point rw,noatime master:1 - ext4 /dev/sda1 rw"
+static int parse_mountinfo(char* line, struct mount_entry* entry)
+{
+   char root[4096];
+   char mount_point[4096];
+   char fs_type[256];
+   char source[4096];
+   unsigned int major_id;
+   unsigned int minor_id;
+   char* separator;
+
+   if (sscanf(line, "%*d %*d %u:%u %4095s %4095s", &major_id, &minor_id, root,
+              mount_point) != 4) {
+      return -1;
+   }
+   // the optional fields end with a lone "-"
+   separator = strstr(line, " - ");
+   if (separator == NULL ||
+       sscanf(separator + 3, "%255s %4095s", fs_type, source) != 2) {
+      return -1;
+   }
+   unescape(mount_point);
+   unescape(source);
+   entry->info.dev = makedev(major_id, minor_id);
+   entry->info.mount_point = strdup(mount_point);
+   entry->info.fs_type = strdup(fs_type);
+   entry->info.device = strdup(source);
+   entry->mount_point_len = strlen(mount_point);
+   entry->whole_fs = !strcmp(root, "/");
+   return 0;
+}
+
+//*****************************************************************************
+
+void mounts_init()
+{
+   char line[16384];
+   FILE* file;
+
+   if (loaded) {
+      return;
+   }
+   loaded = 1;
+
+   file = fopen(MOUNTINFO_PATH, "r");
+   if (file == NULL) {
+      return;
+   }
+   while (fgets(line, sizeof(line), file) != NULL) {
+      mounts = realloc(mounts, (num_mounts + 1) * sizeof(struct mount_entry));
+      if (parse_mountinfo(line, &mounts[num_mounts]) == 0) {
+         num_mounts++;
+      }
+   }
+   fclose(file);
+}
+
+//*****************************************************************************
+
+void mounts_fini()
+{
+   size_t i;
+
+   for (i = 0; i < num_mounts; ++i) {
+      free(mounts[i].info.device);
+      free(mounts[i].info.mount_point);
+      free(mounts[i].info.fs_type);
+   }
+   free(mounts);
+   mounts = NULL;
+   num_mounts = 0;
+   loaded = 0;
+}
+
+//*****************************************************************************
+
+const struct mount_info* mounts_find(const char* path)
+{
+   const struct mount_entry* best = NULL;
+   size_t i;
+
+   if (path == NULL || path[0] != '/') {
+      return NULL;
+   }
+
+   // the longest mount point that is a prefix of the path; later mounts
+   // over the same point hide earlier ones
+   for (i = 0; i < num_mounts; ++i) {
+      const struct mount_entry* m = &mounts[i];
+      const size_t len = m->mount_point_len;
+
+      if (strncmp(path, m->info.mount_point, len) != 0) {
+         continue;
+      }
+      if (len > 1 && path[len] != '/' && path[len] != '\0') {
+         continue;
+      }
+      if (best == NULL || len >= best->mount_point_len) {
+         best = m;
+      }
+   }
+   return best != NULL ? &best->info : NULL;
+}
+
+//*****************************************************************************
+
+const char* mounts_device(const char* path)
+{
+   const struct mount_info* mount = mounts_find(path);
+
+   return mount != NULL ? mount->device : NULL;
+}
+
+//*****************************************************************************
+
+const struct mount_info* mounts_by_dev(unsigned long dev)
+{
+   const struct mount_entry* best = NULL;
+   size_t i;
+
+   // a filesystem mounted more than once (bind mounts) is named after the
+   // mount of its root, if there is one
+   for (i = 0; i < num_mounts; ++i) {
+      if (mounts[i].info.dev != dev) {
+         continue;
+      }
+      if (best == NULL || (mounts[i].whole_fs && !best->whole_fs)) {
+         best = &mounts[i];
+      }
+   }
+   return best != NULL ? &best->info : NULL;
+}
+
+//*****************************************************************************
@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __MOUNTS_H
+#define __MOUNTS_H
+
+// mount table of the listener's host (/proc/self/mountinfo), used to
+// attribute paths and devices to the filesystem they live on. the listener
+// must see the same mounts as the monitored processes (it runs on the same
+// host, outside of their mount namespaces).
+
+struct mount_info {
+   unsigned long dev;        // st_dev of the files on the mount
+   char* mount_point;
+   char* fs_type;            // e.g. "ext4", "nfs4", "tmpfs"
+   char* device;             // source, e.g. "/dev/nvme0n1p1"
+};
+
+// loaded once by mq_listener for all modules, before any record is
+// processed, and released after the reports
+void mounts_init();
+void mounts_fini();
+
+// mount holding path, or NULL if no mount matches (relative path, no
+// mount table)
+const struct mount_info* mounts_find(const char* path);
+
+// source (device) of the mount holding path, or NULL
+const char* mounts_device(const char* path);
+
+// mount of the filesystem with the given st_dev, or NULL if unknown
+const struct mount_info* mounts_by_dev(unsigned long dev);
+
+#endif //__MOUNTS_H
@@ -22,7 +22,10 @@
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <errno.h>
@@ -31,9 +34,36 @@
 #include "ops_names.h"
 #include "domains_names.h"
 #include "mq.h"
+#include "capture.h"
+#include "folded_stacks.h"
+#include "prom_metrics.h"
+#include "process_table.h"
+#include "proc_report.h"
+#include "proc_tree.h"
+#include "container_report.h"
+#include "thread_report.h"
+#include "working_set.h"
+#include "small_io.h"
+#include "durability.h"
+#include "redundant_io.h"
+#include "read_amplification.h"
+#include "inflight.h"
+#include "blocked_time.h"
+#include "cpu_split.h"
+#include "resource_report.h"
+#include "io_sampler.h"
+#include "cache_residency.h"
+#include "device_report.h"
+#include "system_sampler.h"
+#include "mounts.h"
 
 static const int MESSAGE_QUEUE_PROJECT_ID = 'm';
 
+static const int TICK_INTERVAL_SECS = 1;
+
+static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t tick_pending = 0;
+
 //*****************************************************************************
 
 void print_log_entry(struct monitor_record_t *data)
@@ -45,39 +75,225 @@ void print_log_entry(struct monitor_record_t *data)
 
   if (!((ln++)&15)) {
     /* print header every 16th line"*/
-    printf("%10s %10s %8s %5s %20s  %-20s %3s %5s %8s %s\n",
+    printf("%10s %10s %8s %5s %5s %20s  %-20s %3s %5s %8s %10s %s\n",
 	   "FACILITY", "TS.", "ELAPSED",
-	   "PID", "DOMAIN", "OPERATION", "ERR", "FD",
-	   "XFER", "PARM");
+	   "PID", "TID", "DOMAIN", "OPERATION", "ERR", "FD",
+	   "XFER", "OFFSET", "PARM");
   }
  
-  printf("%10s %10d %8.4f %5d %20s  %-20s %3d %5d %8zu %s %s\n",
+  printf("%10s %10d %8.4f %5d %5d %20s  %-20s %3d %5d %8zu %10lld %s %s\n",
 	 data->facility,
 	 data->timestamp,
 	 data->elapsed_time,
 	 data->pid,
+	 data->tid,
 	 domains_names[data->dom_type],
 	 ops_names[data->op_type], data->error_code, data->fd,
-	 data->bytes_transferred, data->s1, data->s2);
+	 data->bytes_transferred, data->offset, data->s1, data->s2);
+}
+
+
+
+void handle_stop_signal(int sig)
+{
+   keep_running = 0;
+}
+
+//*****************************************************************************
+
+void handle_tick_signal(int sig)
+{
+   tick_pending = 1;
 }
 
+//*****************************************************************************
+
+// periodic work of the analysis modules runs on the main thread, driven
+// by a SIGALRM that also interrupts a blocked msgrcv
+void run_tick()
+{
+   const time_t now = time(NULL);
 
+   tick_pending = 0;
+   prom_metrics_tick(now);
+   io_sampler_tick(now);
+   cache_residency_tick(now);
+   system_sampler_tick(now);
+}
+
+//*****************************************************************************
+
+void usage(const char* program)
+{
+   printf("usage: %s [options] <msg-queue-path>\n", program);
+   printf("  -q          don't print individual events\n");
+   printf("  -o <file>   capture all records to file for the offline tools\n");
+   printf("  -f <file>   write folded call stacks (flame graph input) to file on exit\n");
+   printf("  -b          weight folded stacks by bytes instead of latency\n");
+   printf("  -p <port>   expose Prometheus metrics on http://127.0.0.1:<port>/metrics\n");
+   printf("  -t <file>   periodically write Prometheus metrics to textfile-collector file\n");
+   printf("  -s          print a summary report for each process when it stops\n");
+   printf("  -T          print the process tree and I/O by command on exit\n");
+   printf("  -C          print I/O by container/cgroup on exit\n");
+   printf("  -N          print I/O by thread pool (thread name) on exit\n");
+   printf("  -w          print working set and re-read ratio on exit\n");
+   printf("  -H <file>   write per-file offset heatmap (CSV) to file on exit\n");
+   printf("  -B          print small reads/writes that buffering would save on exit\n");
+   printf("  -D          print sync (durability) analysis on exit\n");
+   printf("  -R          print redundant lookups, re-reads and open-read-close cycles on exit\n");
+   printf("  -A          print read amplification against file size on exit (needs STAT_ON_OPEN)\n");
+   printf("  -Q          print in-flight I/O (queue depth) by process, device and file on exit\n");
+   printf("  -S <file>   write per-second in-flight I/O series (CSV) to file\n");
+   printf("  -W          print time threads and processes spent blocked in I/O on exit\n");
+   printf("  -U          print on-CPU vs off-CPU time of calls on exit (needs CPU_TIME)\n");
+   printf("  -E          print resource usage and logical vs physical I/O of processes on exit\n");
+   printf("  -I          sample /proc/<pid>/io and print page cache hit estimates per process\n");
+   printf("  -L <file>   write /proc/<pid>/io samples with shim I/O per interval (CSV) to file\n");
+   printf("  -M          print page cache residency (mincore) and read latency of files on exit\n");
+   printf("  -V          print file I/O latency and throughput by filesystem and device on exit\n");
+   printf("  -Y          sample disks, I/O pressure and dirty pages and print what slow I/O coincided with\n");
+   printf("  -Z <file>   write per-second host samples with file I/O calls (CSV) to file\n");
+}
+
+//*****************************************************************************
 
 int main(int argc, char* argv[]) {
    const char* message_queue_path;
    int message_queue_key;
    int message_queue_id;
    int rc;
+   int opt;
+   int quiet = 0;
+   const char* capture_path = NULL;
+   FILE* capture = NULL;
+   const char* folded_stacks_path = NULL;
+   FOLD_WEIGHT fold_weight = FOLD_BY_LATENCY;
+   int metrics_port = 0;
+   const char* metrics_textfile_path = NULL;
+   int summary_reports = 0;
+   int tree_report = 0;
+   int container_report = 0;
+   int thread_report = 0;
+   int working_set_report_enabled = 0;
+   const char* heatmap_path = NULL;
+   int small_io_report_enabled = 0;
+   int durability_report_enabled = 0;
+   int redundant_io_report_enabled = 0;
+   int read_amplification_report_enabled = 0;
+   int inflight_report_enabled = 0;
+   const char* inflight_series_path = NULL;
+   int blocked_time_report_enabled = 0;
+   int cpu_split_report_enabled = 0;
+   int resource_report_enabled = 0;
+   int io_sampler_report_enabled = 0;
+   const char* io_sampler_series_path = NULL;
+   int cache_residency_enabled = 0;
+   int device_report_enabled = 0;
+   int system_sampler_report_enabled = 0;
+   const char* system_sampler_series_path = NULL;
+   struct process_info* process;
    ssize_t message_size_received;
    MONITOR_MESSAGE monitor_message;
+   struct sigaction stop_action;
+   struct sigaction tick_action;
+   struct itimerval tick_timer;
+
+   while ((opt = getopt(argc, argv, "qo:f:bp:t:sTCNwH:BDRAQS:WUEIL:MVYZ:")) != -1) {
+      switch (opt) {
+         case 'q':
+            quiet = 1;
+            break;
+         case 'o':
+            capture_path = optarg;
+            break;
+         case 'f':
+            folded_stacks_path = optarg;
+            break;
+         case 'b':
+            fold_weight = FOLD_BY_BYTES;
+            break;
+         case 'p':
+            metrics_port = atoi(optarg);
+            break;
+         case 't':
+            metrics_textfile_path = optarg;
+            break;
+         case 's':
+            summary_reports = 1;
+            break;
+         case 'T':
+            tree_report = 1;
+            break;
+         case 'C':
+            container_report = 1;
+            break;
+         case 'N':
+            thread_report = 1;
+            break;
+         case 'w':
+            working_set_report_enabled = 1;
+            break;
+         case 'H':
+            heatmap_path = optarg;
+            break;
+         case 'B':
+            small_io_report_enabled = 1;
+            break;
+         case 'D':
+            durability_report_enabled = 1;
+            break;
+         case 'R':
+            redundant_io_report_enabled = 1;
+            break;
+         case 'A':
+            read_amplification_report_enabled = 1;
+            break;
+         case 'Q':
+            inflight_report_enabled = 1;
+            break;
+         case 'S':
+            inflight_series_path = optarg;
+            break;
+         case 'W':
+            blocked_time_report_enabled = 1;
+            break;
+         case 'U':
+            cpu_split_report_enabled = 1;
+            break;
+         case 'E':
+            resource_report_enabled = 1;
+            break;
+         case 'I':
+            io_sampler_report_enabled = 1;
+            break;
+         case 'L':
+            io_sampler_series_path = optarg;
+            break;
+         case 'M':
+            cache_residency_enabled = 1;
+            break;
+         case 'V':
+            device_report_enabled = 1;
+            break;
+         case 'Y':
+            system_sampler_report_enabled = 1;
+            break;
+         case 'Z':
+            system_sampler_series_path = optarg;
+            break;
+         default:
+            usage(argv[0]);
+            exit(1);
+      }
+   }
 
-   if (argc < 2) {
+   if (optind >= argc) {
       printf("error: missing arguments\n");
-      printf("usage: %s <msg-queue-path>\n", argv[0]);
+      usage(argv[0]);
       exit(1);
    }
 
-   message_queue_path = argv[1];
+   message_queue_path = argv[optind];
 
    message_queue_key = ftok(message_queue_path, MESSAGE_QUEUE_PROJECT_ID);
    if (message_queue_key == -1) {
@@ -95,7 +311,63 @@ int main(int argc, char* argv[]) {
       exit(1);
    }
 
-   while (1) {
+   if (capture_path != NULL) {
+      capture = capture_create(capture_path);
+      if (capture == NULL) {
+         exit(1);
+      }
+   }
+
+   process_table_init();
+   mounts_init();
+   folded_stacks_init(folded_stacks_path, fold_weight);
+   proc_report_init(summary_reports ? stdout : NULL);
+   proc_tree_init(tree_report ? stdout : NULL);
+   container_report_init(container_report ? stdout : NULL);
+   thread_report_init(thread_report ? stdout : NULL);
+   working_set_init(working_set_report_enabled ? stdout : NULL, heatmap_path);
+   small_io_init(small_io_report_enabled ? stdout : NULL);
+   durability_init(durability_report_enabled ? stdout : NULL);
+   redundant_io_init(redundant_io_report_enabled ? stdout : NULL);
+   read_amplification_init(read_amplification_report_enabled ? stdout : NULL);
+   if (inflight_init(inflight_report_enabled ? stdout : NULL, inflight_series_path) != 0) {
+      exit(1);
+   }
+   blocked_time_init(blocked_time_report_enabled ? stdout : NULL);
+   cpu_split_init(cpu_split_report_enabled ? stdout : NULL);
+   resource_report_init(resource_report_enabled ? stdout : NULL);
+   if (io_sampler_init(io_sampler_report_enabled ? stdout : NULL, io_sampler_series_path) != 0) {
+      exit(1);
+   }
+   cache_residency_init(cache_residency_enabled ? stdout : NULL);
+   device_report_init(device_report_enabled ? stdout : NULL);
+   if (system_sampler_init(system_sampler_report_enabled ? stdout : NULL,
+                           system_sampler_series_path) != 0) {
+      exit(1);
+   }
+   if (prom_metrics_init(metrics_port, metrics_textfile_path) != 0) {
+      exit(1);
+   }
+
+   // stop cleanly on ctrl-c/kill so that reports can be written. no
+   // SA_RESTART, so that a blocked msgrcv returns with EINTR.
+   memset(&stop_action, 0, sizeof(stop_action));
+   stop_action.sa_handler = handle_stop_signal;
+   sigaction(SIGINT, &stop_action, NULL);
+   sigaction(SIGTERM, &stop_action, NULL);
+
+   memset(&tick_action, 0, sizeof(tick_action));
+   tick_action.sa_handler = handle_tick_signal;
+   sigaction(SIGALRM, &tick_action, NULL);
+   memset(&tick_timer, 0, sizeof(tick_timer));
+   tick_timer.it_interval.tv_sec = TICK_INTERVAL_SECS;
+   tick_timer.it_value.tv_sec = TICK_INTERVAL_SECS;
+   setitimer(ITIMER_REAL, &tick_timer, NULL);
+
+   while (keep_running) {
+      if (tick_pending) {
+         run_tick();
+      }
       memset(&monitor_message, 0, sizeof(MONITOR_MESSAGE));
       message_size_received = msgrcv(message_queue_id,
                                      &monitor_message,   // void* ptr
@@ -103,13 +375,69 @@ int main(int argc, char* argv[]) {
                                      0,   // long type
                                      0);  // int flag
       if (message_size_received > 0) {
-         print_log_entry(&monitor_message.monitor_record);
+         const struct monitor_record_t* r = &monitor_message.monitor_record;
+         if (capture != NULL && capture_write(capture, r) != 0) {
+            printf("error: unable to write capture file '%s'\n", capture_path);
+            fclose(capture);
+            capture = NULL;
+         }
+         process = process_table_update(r);
+         if (!quiet) {
+            print_log_entry(&monitor_message.monitor_record);
+         }
+         folded_stacks_record(r);
+         prom_metrics_record(r);
+         proc_report_record(process, r);
+         proc_tree_record(process, r);
+         container_report_record(r);
+         thread_report_record(process, r);
+         working_set_record(process, r);
+         small_io_record(process, r);
+         durability_record(process, r);
+         redundant_io_record(process, r);
+         read_amplification_record(process, r);
+         inflight_record(process, r);
+         blocked_time_record(process, r);
+         cpu_split_record(process, r);
+         resource_report_record(process, r);
+         io_sampler_record(process, r);
+         cache_residency_record(process, r);
+         device_report_record(process, r);
+         system_sampler_record(process, r);
+         process_table_release(r);
+      } else if (errno == EINTR) {
+         continue;
       } else {
          printf("rc = %zu\n", message_size_received);
          printf("errno = %d\n", errno);
       }
    }
 
+   folded_stacks_report();
+   prom_metrics_report();
+   proc_report_flush();
+   proc_tree_report();
+   container_report_report();
+   thread_report_report();
+   working_set_report();
+   small_io_report();
+   durability_report();
+   redundant_io_report();
+   read_amplification_report();
+   inflight_report();
+   blocked_time_report();
+   cpu_split_report();
+   resource_report_report();
+   io_sampler_report();
+   cache_residency_report();
+   device_report_report();
+   system_sampler_report();
+   mounts_fini();
+   process_table_fini();
+   if (capture != NULL) {
+      fclose(capture);
+   }
+
    return 0;
 }
 
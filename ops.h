@@ -49,17 +49,20 @@ typedef enum {
    ACCEPT,         // 44  (SOCKETS)
    LISTEN,         // 45  (SOCKETS)
    BIND,           // 46  (SOCKETS)
+   EXEC,           // 47  (PROCESSES)
    
    // operations listed below are NOT directly associated with
    // C functions
    START,          // Start execution of program
    STOP,           // Stop execution of program
+   THREAD_START,   // Start (or renaming) of a thread. s1 contains the thread name, s2 its tid
    HTTP_REQ_SEND,  // Send an HTTP request. s1 will contain verb and URL
    HTTP_REQ_RECV,  // Get an HTTP request.  s1 will contain verb and URL
    HTTP_RESP_SEND, // Send an HTTP response. error code field will contain response code
    HTTP_RESP_RECV, // Receive HTTP response
    HTTP_RESP_FINI_SEND, // Sent final byte of HTTP response
    HTTP_RESP_FINI_RECV, // Receive final byte of HTTP response
+   BLOCKED,        // Time a thread spent in intercepted calls over a period. s1 has the time per domain, s2 the totals
    
    END_OPS         // keep this one as last
 } OP_TYPE;
@@ -0,0 +1,436 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// proc_report.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "ops_names.h"
+#include "htable.h"
+#include "histogram.h"
+#include "access_pattern.h"
+#include "proc_report.h"
+
+static const int TOP_FILES = 10;
+
+struct op_stats {
+   unsigned long long bytes;
+   struct histogram latency_usec;
+};
+
+struct error_key {
+   int op_type;
+   int error_code;
+};
+
+enum { PATTERN_READ, PATTERN_WRITE, PATTERN_DIRECTIONS };
+
+static const char* pattern_directions[PATTERN_DIRECTIONS] = { "read", "write" };
+
+struct file_stats {
+   char* path;
+   unsigned long long ops;
+   unsigned long long bytes;
+   double time_ms;
+   struct access_pattern patterns[PATTERN_DIRECTIONS];
+};
+
+// session of an open fd, for the access pattern of its file
+struct fd_session {
+   struct file_stats* file;
+   struct access_stream streams[PATTERN_DIRECTIONS];
+};
+
+struct proc_stats {
+   struct op_stats ops[END_OPS];
+   struct htable errors;     // struct error_key -> unsigned long long*
+   struct htable files;      // path -> struct file_stats*
+   struct htable sessions;   // fd -> struct fd_session*
+   double call_ms;           // summed over the calls of all threads
+   // from STOP: time blocked in intercepted calls and threads that made them
+   int have_blocked;
+   double blocked_ms;
+   int threads;
+};
+
+static FILE* report_output = NULL;
+static struct htable all_stats;   // pid -> struct proc_stats*
+
+//*****************************************************************************
+
+static void free_file_stats(void* value)
+{
+   struct file_stats* file = value;
+
+   free(file->path);
+   free(file);
+}
+
+//*****************************************************************************
+
+static void free_proc_stats(void* value)
+{
+   struct proc_stats* stats = value;
+
+   htable_destroy(&stats->errors, free);
+   htable_destroy(&stats->sessions, free);
+   htable_destroy(&stats->files, free_file_stats);
+   free(stats);
+}
+
+//*****************************************************************************
+
+void proc_report_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&all_stats);
+}
+
+//*****************************************************************************
+
+static void print_op_line(const char* name, const struct op_stats* op)
+{
+   const struct histogram* h = &op->latency_usec;
+
+   fprintf(report_output, "  %-20s %10llu %14llu %10.4f %10.4f %10.4f %10.4f %10.4f\n",
+           name, h->count, op->bytes,
+           h->sum / h->count / 1000.0,
+           histogram_percentile(h, 50.0) / 1000.0,
+           histogram_percentile(h, 95.0) / 1000.0,
+           histogram_percentile(h, 99.0) / 1000.0,
+           h->max / 1000.0);
+}
+
+//*****************************************************************************
+
+static void print_error_line(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct error_key* error = key;
+
+   fprintf(report_output, "  %-20s %6d %-28s %10llu\n",
+           ops_names[error->op_type], error->error_code,
+           strerror(error->error_code), *(unsigned long long*) value);
+}
+
+//*****************************************************************************
+
+struct file_list {
+   struct file_stats** files;
+   size_t count;
+};
+
+static void collect_file(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct file_list* list = ctx;
+
+   list->files[list->count++] = value;
+}
+
+static int compare_by_bytes(const void* a, const void* b)
+{
+   const struct file_stats* fa = *(struct file_stats* const*) a;
+   const struct file_stats* fb = *(struct file_stats* const*) b;
+
+   return (fa->bytes < fb->bytes) - (fa->bytes > fb->bytes);
+}
+
+static int compare_by_time(const void* a, const void* b)
+{
+   const struct file_stats* fa = *(struct file_stats* const*) a;
+   const struct file_stats* fb = *(struct file_stats* const*) b;
+
+   return (fa->time_ms < fb->time_ms) - (fa->time_ms > fb->time_ms);
+}
+
+static void print_top_files(struct file_list* list, const char* title,
+                            int (*compare)(const void*, const void*))
+{
+   size_t i;
+
+   qsort(list->files, list->count, sizeof(struct file_stats*), compare);
+   fprintf(report_output, "\n  top files by %s\n", title);
+   fprintf(report_output, "  %14s %10s %12s  %s\n", "BYTES", "OPS", "TIME(ms)", "PATH");
+   for (i = 0; i < list->count && i < TOP_FILES; ++i) {
+      fprintf(report_output, "  %14llu %10llu %12.4f  %s\n",
+              list->files[i]->bytes, list->files[i]->ops,
+              list->files[i]->time_ms, list->files[i]->path);
+   }
+}
+
+//*****************************************************************************
+
+static void end_session(struct fd_session* session)
+{
+   int d;
+
+   for (d = 0; d < PATTERN_DIRECTIONS; ++d) {
+      access_pattern_end(&session->file->patterns[d], &session->streams[d]);
+   }
+}
+
+static void end_one_session(const void* key, size_t key_len, void* value, void* ctx)
+{
+   end_session(value);
+}
+
+//*****************************************************************************
+
+// reads and writes at known offsets feed the access pattern of the file,
+// per session (open to close of an fd)
+static void track_access(struct proc_stats* stats, struct file_stats* file,
+                         const struct monitor_record_t* r)
+{
+   struct fd_session* session;
+   int direction;
+
+   if (r->op_type == CLOSE) {
+      session = htable_remove_int(&stats->sessions, r->fd);
+      if (session != NULL) {
+         end_session(session);
+         free(session);
+      }
+      return;
+   }
+
+   if (r->dom_type == FILE_READ) {
+      direction = PATTERN_READ;
+   } else if (r->dom_type == FILE_WRITE) {
+      direction = PATTERN_WRITE;
+   } else {
+      return;
+   }
+   if (file == NULL || r->fd < 0 || r->offset < 0 ||
+       r->bytes_transferred == 0 || r->error_code != 0) {
+      return;
+   }
+
+   session = htable_get_int(&stats->sessions, r->fd);
+   if (session != NULL && session->file != file) {
+      // the CLOSE of the previous file on this fd was not seen
+      end_session(session);
+      memset(session, 0, sizeof(*session));
+      session->file = file;
+   } else if (session == NULL) {
+      session = calloc(1, sizeof(struct fd_session));
+      session->file = file;
+      htable_put_int(&stats->sessions, r->fd, session);
+   }
+
+   access_pattern_add(&file->patterns[direction], &session->streams[direction],
+                      r->offset, r->bytes_transferred);
+}
+
+//*****************************************************************************
+
+static void print_access_patterns(struct file_list* list)
+{
+   size_t i;
+   int d;
+
+   fprintf(report_output, "\n  access patterns (requests at known offsets)\n");
+   fprintf(report_output, "  %-5s %-10s %10s %6s %6s %6s %6s %10s %10s %10s  %s\n",
+           "DIR", "PATTERN", "REQUESTS", "SEQ%", "REV%", "STRD%", "RAND%",
+           "SIZE P50", "RUN P50", "RUN MAX", "PATH");
+   for (i = 0; i < list->count && i < TOP_FILES; ++i) {
+      for (d = 0; d < PATTERN_DIRECTIONS; ++d) {
+         const struct access_pattern* p = &list->files[i]->patterns[d];
+         const double transitions = p->sequential + p->reverse + p->strided + p->random;
+         if (p->requests == 0) {
+            continue;
+         }
+         fprintf(report_output,
+                 "  %-5s %-10s %10llu %6.1f %6.1f %6.1f %6.1f %10.0f %10.0f %10.0f  %s\n",
+                 pattern_directions[d], access_pattern_label(p), p->requests,
+                 transitions > 0 ? 100.0 * p->sequential / transitions : 0.0,
+                 transitions > 0 ? 100.0 * p->reverse / transitions : 0.0,
+                 transitions > 0 ? 100.0 * p->strided / transitions : 0.0,
+                 transitions > 0 ? 100.0 * p->random / transitions : 0.0,
+                 histogram_percentile(&p->request_bytes, 50.0),
+                 histogram_percentile(&p->run_bytes, 50.0),
+                 p->run_bytes.max, list->files[i]->path);
+      }
+   }
+}
+
+//*****************************************************************************
+
+static void print_report(const struct process_info* process,
+                         struct proc_stats* stats)
+{
+   struct op_stats total;
+   struct file_list list;
+   double lifetime_ms;
+   int i;
+
+   memset(&total, 0, sizeof(total));
+   htable_foreach(&stats->sessions, end_one_session, NULL);
+   lifetime_ms = (process != NULL) ? process_lifetime_ms(process) : 0.0;
+
+   fprintf(report_output, "\n===== process %d", process ? process->pid : -1);
+   if (process != NULL) {
+      fprintf(report_output, " (ppid %d, facility %s, container %s): %s",
+              process->ppid, process->facility, process->container_id,
+              process->cmdline ? process->cmdline : "[no START seen]");
+   }
+   fprintf(report_output, "\n");
+   if (!stats->have_blocked) {
+      // threads overlap, so no share of the lifetime
+      fprintf(report_output, "  lifetime %.3f ms, summed call time %.3f ms%s\n",
+              lifetime_ms, stats->call_ms,
+              (process != NULL && process->stopped) ? "" : ", still running");
+   } else if (stats->threads <= 1) {
+      fprintf(report_output, "  lifetime %.3f ms, blocked in I/O %.3f ms (%.1f%%)\n",
+              lifetime_ms, stats->blocked_ms,
+              lifetime_ms > 0.0 ? 100.0 * stats->blocked_ms / lifetime_ms : 0.0);
+   } else {
+      fprintf(report_output,
+              "  lifetime %.3f ms, blocked in I/O %.3f ms by %d threads (%.2f blocked on average)\n",
+              lifetime_ms, stats->blocked_ms, stats->threads,
+              lifetime_ms > 0.0 ? stats->blocked_ms / lifetime_ms : 0.0);
+   }
+
+   fprintf(report_output, "\n  %-20s %10s %14s %10s %10s %10s %10s %10s\n",
+           "OPERATION", "COUNT", "BYTES", "AVG(ms)", "P50(ms)", "P95(ms)",
+           "P99(ms)", "MAX(ms)");
+   for (i = 0; i < END_OPS; ++i) {
+      if (stats->ops[i].latency_usec.count == 0) {
+         continue;
+      }
+      print_op_line(ops_names[i], &stats->ops[i]);
+      total.bytes += stats->ops[i].bytes;
+      histogram_merge(&total.latency_usec, &stats->ops[i].latency_usec);
+   }
+   if (total.latency_usec.count > 0) {
+      print_op_line("TOTAL", &total);
+   }
+
+   if (stats->errors.count > 0) {
+      fprintf(report_output, "\n  %-20s %6s %-28s %10s\n",
+              "OPERATION", "ERRNO", "ERROR", "COUNT");
+      htable_foreach(&stats->errors, print_error_line, NULL);
+   }
+
+   if (stats->files.count > 0) {
+      list.files = malloc(stats->files.count * sizeof(struct file_stats*));
+      list.count = 0;
+      htable_foreach(&stats->files, collect_file, &list);
+      print_top_files(&list, "bytes", compare_by_bytes);
+      print_top_files(&list, "time", compare_by_time);
+      qsort(list.files, list.count, sizeof(struct file_stats*), compare_by_bytes);
+      print_access_patterns(&list);
+      free(list.files);
+   }
+   fflush(report_output);
+}
+
+//*****************************************************************************
+
+void proc_report_record(const struct process_info* process,
+                        const struct monitor_record_t* r)
+{
+   struct proc_stats* stats;
+   struct file_stats* file;
+   const char* path;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   stats = htable_get_int(&all_stats, r->pid);
+   if (stats == NULL) {
+      stats = calloc(1, sizeof(struct proc_stats));
+      htable_init(&stats->errors);
+      htable_init(&stats->files);
+      htable_init(&stats->sessions);
+      htable_put_int(&all_stats, r->pid, stats);
+   }
+
+   if (r->op_type == STOP) {
+      // "blocked=15.750 elapsed=100.000 calls=42 threads=2"
+      if (sscanf(r->s2, "blocked=%lf", &stats->blocked_ms) == 1) {
+         const char* threads = strstr(r->s2, " threads=");
+         stats->have_blocked = 1;
+         stats->threads = threads != NULL ? atoi(threads + 9) : 1;
+      }
+      print_report(process, stats);
+      htable_remove_int(&all_stats, r->pid);
+      free_proc_stats(stats);
+      return;
+   }
+
+   if (r->dom_type == START_STOP || r->op_type >= END_OPS) {
+      return;
+   }
+
+   stats->ops[r->op_type].bytes += r->bytes_transferred;
+   histogram_add(&stats->ops[r->op_type].latency_usec, r->elapsed_time * 1000.0);
+   stats->call_ms += r->elapsed_time;
+
+   if (r->error_code != 0) {
+      struct error_key key;
+      unsigned long long* count;
+
+      memset(&key, 0, sizeof(key));
+      key.op_type = r->op_type;
+      key.error_code = r->error_code;
+      count = htable_get(&stats->errors, &key, sizeof(key));
+      if (count == NULL) {
+         count = calloc(1, sizeof(*count));
+         htable_put(&stats->errors, &key, sizeof(key), count);
+      }
+      (*count)++;
+   }
+
+   path = record_path(process, r);
+   file = NULL;
+   if (path != NULL) {
+      file = htable_get_str(&stats->files, path);
+      if (file == NULL) {
+         file = calloc(1, sizeof(struct file_stats));
+         file->path = strdup(path);
+         htable_put_str(&stats->files, path, file);
+      }
+      file->ops++;
+      file->bytes += r->bytes_transferred;
+      file->time_ms += r->elapsed_time;
+   }
+   track_access(stats, file, r);
+}
+
+//*****************************************************************************
+
+static void flush_one(const void* key, size_t key_len, void* value, void* ctx)
+{
+   long pid;
+
+   memcpy(&pid, key, sizeof(pid));
+   print_report(process_table_lookup(pid), value);
+}
+
+void proc_report_flush()
+{
+   if (report_output == NULL) {
+      return;
+   }
+   htable_foreach(&all_stats, flush_one, NULL);
+   htable_destroy(&all_stats, free_proc_stats);
+}
+
+//*****************************************************************************
@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __PROC_REPORT_H
+#define __PROC_REPORT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// per-process summary, printed when the STOP of a process arrives:
+// operations/bytes/latency percentiles by op, error breakdown, top files
+// by bytes and by time with the access pattern of each file (sequential,
+// reverse, strided, random), and time blocked in I/O versus lifetime.
+
+void proc_report_init(FILE* output);
+void proc_report_record(const struct process_info* process,
+                        const struct monitor_record_t* monitor_record);
+
+// prints reports of processes that are still running (listener exit)
+void proc_report_flush();
+
+#endif //__PROC_REPORT_H
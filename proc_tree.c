@@ -0,0 +1,410 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// proc_tree.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "proc_tree.h"
+
+#define COMMAND_LEN 128
+
+// subtrees below this share of the total I/O time are folded into a
+// single "N more" line to keep the tree readable
+static const double MIN_SUBTREE_SHARE = 0.01;
+
+static const char* interpreters[] = {
+   "sh", "bash", "dash", "zsh", "python", "python2", "python3", "perl",
+   "ruby", "node", "java", NULL
+};
+
+struct io_totals {
+   unsigned long long ops;
+   unsigned long long bytes;
+   double time_ms;
+};
+
+struct tree_node {
+   int pid;
+   int monitored;            // 0 for placeholder parents never seen
+   int stopped;
+   int has_command;
+   char command[COMMAND_LEN];
+   struct io_totals own;
+   struct io_totals unattributed; // events seen before the first START
+   struct io_totals subtree;
+   int subtree_processes;
+   struct tree_node* parent;
+   struct tree_node* first_child;
+   struct tree_node* next_sibling;
+   struct tree_node* next_node;   // list of all nodes ever created
+};
+
+struct command_stats {
+   char command[COMMAND_LEN];
+   unsigned long long processes;
+   struct io_totals io;
+};
+
+static FILE* report_output = NULL;
+static struct htable live_nodes;    // pid -> struct tree_node* (latest)
+static struct htable commands;      // command -> struct command_stats*
+static struct tree_node* all_nodes = NULL;
+
+//*****************************************************************************
+
+void proc_tree_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&live_nodes);
+   htable_init(&commands);
+}
+
+//*****************************************************************************
+
+void normalize_command(const char* cmdline, char* out, size_t out_len)
+{
+   char program[COMMAND_LEN];
+   char script[COMMAND_LEN];
+   const char* base;
+   int i;
+
+   program[0] = '\0';
+   script[0] = '\0';
+   sscanf(cmdline, "%127s %127s", program, script);
+
+   base = strrchr(program, '/');
+   base = (base != NULL) ? base + 1 : program;
+   snprintf(out, out_len, "%s", base[0] ? base : "[unknown]");
+
+   if (script[0] == '\0' || script[0] == '-') {
+      return;
+   }
+   for (i = 0; interpreters[i] != NULL; ++i) {
+      if (!strcmp(base, interpreters[i])) {
+         const char* script_base = strrchr(script, '/');
+         script_base = (script_base != NULL) ? script_base + 1 : script;
+         snprintf(out, out_len, "%s %s", base, script_base);
+         return;
+      }
+   }
+}
+
+//*****************************************************************************
+
+static struct tree_node* new_node(int pid, int monitored)
+{
+   struct tree_node* node = calloc(1, sizeof(struct tree_node));
+
+   node->pid = pid;
+   node->monitored = monitored;
+   // monitored processes whose START was not seen (e.g., the listener
+   // was started later, or the message queue was full) keep this name
+   snprintf(node->command, COMMAND_LEN, monitored ? "[no START]" : "[not monitored]");
+   node->next_node = all_nodes;
+   all_nodes = node;
+   return node;
+}
+
+//*****************************************************************************
+
+static void set_parent(struct tree_node* node, int ppid)
+{
+   struct tree_node* parent;
+
+   if (node->parent != NULL || ppid <= 0) {
+      return;
+   }
+
+   // unmonitored parents (e.g., the shell that started a pipeline) get
+   // a placeholder node so that their children are grouped together
+   parent = htable_get_int(&live_nodes, ppid);
+   if (parent == NULL) {
+      parent = new_node(ppid, 0);
+      htable_put_int(&live_nodes, ppid, parent);
+   }
+
+   node->parent = parent;
+   node->next_sibling = parent->first_child;
+   parent->first_child = node;
+}
+
+//*****************************************************************************
+
+static struct command_stats* get_command(const char* command)
+{
+   struct command_stats* stats = htable_get_str(&commands, command);
+
+   if (stats == NULL) {
+      stats = calloc(1, sizeof(struct command_stats));
+      snprintf(stats->command, COMMAND_LEN, "%s", command);
+      htable_put_str(&commands, command, stats);
+   }
+   return stats;
+}
+
+//*****************************************************************************
+
+static void add_io(struct io_totals* totals, const struct io_totals* io)
+{
+   totals->ops += io->ops;
+   totals->bytes += io->bytes;
+   totals->time_ms += io->time_ms;
+}
+
+//*****************************************************************************
+
+void proc_tree_record(const struct process_info* process,
+                      const struct monitor_record_t* r)
+{
+   struct tree_node* node;
+   struct command_stats* command;
+   struct io_totals io;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   node = htable_get_int(&live_nodes, r->pid);
+   if (node != NULL && !node->monitored) {
+      // a placeholder for a parent that turns out to be monitored
+      node->monitored = 1;
+      snprintf(node->command, COMMAND_LEN, "[no START]");
+   } else if (node == NULL || node->stopped) {
+      // first event of this pid, or pid reuse
+      node = new_node(r->pid, 1);
+      htable_put_int(&live_nodes, r->pid, node);
+   }
+
+   if (r->op_type == START) {
+      // exec'ed processes send another START with the same pid; the
+      // node then takes the name of the new program, which also takes
+      // over the process count (its I/O so far stays with the old one).
+      // constructors of other libraries may do I/O before our START;
+      // credit that to the program as well.
+      if (node->has_command) {
+         command = get_command(node->command);
+         if (command->processes > 0) {
+            command->processes--;
+         }
+      }
+      normalize_command(r->s1, node->command, COMMAND_LEN);
+      command = get_command(node->command);
+      command->processes++;
+      add_io(&command->io, &node->unattributed);
+      memset(&node->unattributed, 0, sizeof(node->unattributed));
+      node->has_command = 1;
+      set_parent(node, process->ppid);
+      return;
+   }
+
+   if (r->op_type == STOP) {
+      node->stopped = 1;
+      return;
+   }
+
+   if (r->dom_type == START_STOP) {
+      return;
+   }
+
+   if (process->ppid > 0) {
+      set_parent(node, process->ppid);
+   }
+
+   io.ops = 1;
+   io.bytes = r->bytes_transferred;
+   io.time_ms = r->elapsed_time;
+
+   add_io(&node->own, &io);
+   if (node->has_command) {
+      add_io(&get_command(node->command)->io, &io);
+   } else {
+      add_io(&node->unattributed, &io);
+   }
+}
+
+//*****************************************************************************
+
+static void sum_subtree(struct tree_node* node)
+{
+   struct tree_node* child;
+
+   node->subtree = node->own;
+   node->subtree_processes = node->monitored ? 1 : 0;
+   for (child = node->first_child; child != NULL; child = child->next_sibling) {
+      sum_subtree(child);
+      node->subtree.ops += child->subtree.ops;
+      node->subtree.bytes += child->subtree.bytes;
+      node->subtree.time_ms += child->subtree.time_ms;
+      node->subtree_processes += child->subtree_processes;
+   }
+}
+
+//*****************************************************************************
+
+static int compare_nodes(const void* a, const void* b)
+{
+   const struct tree_node* na = *(struct tree_node* const*) a;
+   const struct tree_node* nb = *(struct tree_node* const*) b;
+
+   return (na->subtree.time_ms < nb->subtree.time_ms) -
+          (na->subtree.time_ms > nb->subtree.time_ms);
+}
+
+//*****************************************************************************
+
+static void print_node(const struct tree_node* node, int depth, double min_time_ms)
+{
+   struct tree_node** children;
+   const struct tree_node* child;
+   size_t num_children = 0;
+   size_t hidden = 0;
+   int hidden_processes = 0;
+   double hidden_time_ms = 0.0;
+   size_t i;
+
+   fprintf(report_output, "  %*s%-*s %7d %8d %10llu %14llu %12.3f %12.3f\n",
+           depth * 2, "", 40 - depth * 2 > 8 ? 40 - depth * 2 : 8, node->command,
+           node->pid, node->subtree_processes, node->subtree.ops,
+           node->subtree.bytes, node->own.time_ms, node->subtree.time_ms);
+
+   for (child = node->first_child; child != NULL; child = child->next_sibling) {
+      num_children++;
+   }
+   if (num_children == 0) {
+      return;
+   }
+
+   children = malloc(num_children * sizeof(struct tree_node*));
+   num_children = 0;
+   for (child = node->first_child; child != NULL; child = child->next_sibling) {
+      children[num_children++] = (struct tree_node*) child;
+   }
+   qsort(children, num_children, sizeof(struct tree_node*), compare_nodes);
+
+   for (i = 0; i < num_children; ++i) {
+      if (children[i]->subtree.time_ms >= min_time_ms) {
+         print_node(children[i], depth + 1, min_time_ms);
+      } else {
+         hidden++;
+         hidden_processes += children[i]->subtree_processes;
+         hidden_time_ms += children[i]->subtree.time_ms;
+      }
+   }
+   if (hidden > 0) {
+      fprintf(report_output, "  %*s... %zu more subtrees (%d processes, %.3f ms)\n",
+              (depth + 1) * 2, "", hidden, hidden_processes, hidden_time_ms);
+   }
+   free(children);
+}
+
+//*****************************************************************************
+
+static void collect_command(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct command_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_commands(const void* a, const void* b)
+{
+   const struct command_stats* ca = *(struct command_stats* const*) a;
+   const struct command_stats* cb = *(struct command_stats* const*) b;
+
+   return (ca->io.time_ms < cb->io.time_ms) - (ca->io.time_ms > cb->io.time_ms);
+}
+
+//*****************************************************************************
+
+void proc_tree_report()
+{
+   struct command_stats** command_list;
+   struct command_stats** cursor;
+   struct tree_node** roots;
+   struct tree_node* node;
+   size_t num_roots = 0;
+   double total_time_ms = 0.0;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   for (node = all_nodes; node != NULL; node = node->next_node) {
+      if (node->unattributed.ops > 0) {
+         add_io(&get_command(node->command)->io, &node->unattributed);
+      }
+   }
+
+   // commands, by I/O time
+   command_list = malloc((commands.count + 1) * sizeof(struct command_stats*));
+   cursor = command_list;
+   htable_foreach(&commands, collect_command, &cursor);
+   qsort(command_list, commands.count, sizeof(struct command_stats*), compare_commands);
+
+   fprintf(report_output, "\n===== I/O by command\n");
+   fprintf(report_output, "  %-40s %10s %10s %14s %12s\n",
+           "COMMAND", "PROCESSES", "OPS", "BYTES", "TIME(ms)");
+   for (i = 0; i < commands.count; ++i) {
+      fprintf(report_output, "  %-40s %10llu %10llu %14llu %12.3f\n",
+              command_list[i]->command, command_list[i]->processes,
+              command_list[i]->io.ops, command_list[i]->io.bytes,
+              command_list[i]->io.time_ms);
+      total_time_ms += command_list[i]->io.time_ms;
+   }
+   free(command_list);
+
+   // process tree, by subtree I/O time
+   for (node = all_nodes; node != NULL; node = node->next_node) {
+      if (node->parent == NULL) {
+         sum_subtree(node);
+         num_roots++;
+      }
+   }
+   roots = malloc((num_roots + 1) * sizeof(struct tree_node*));
+   num_roots = 0;
+   for (node = all_nodes; node != NULL; node = node->next_node) {
+      if (node->parent == NULL) {
+         roots[num_roots++] = node;
+      }
+   }
+   qsort(roots, num_roots, sizeof(struct tree_node*), compare_nodes);
+
+   fprintf(report_output, "\n===== process tree\n");
+   fprintf(report_output, "  %-40s %7s %8s %10s %14s %12s %12s\n",
+           "COMMAND", "PID", "PROCS", "OPS", "BYTES", "OWN(ms)", "SUBTREE(ms)");
+   for (i = 0; i < num_roots; ++i) {
+      print_node(roots[i], 0, total_time_ms * MIN_SUBTREE_SHARE);
+   }
+   free(roots);
+   fflush(report_output);
+
+   while (all_nodes != NULL) {
+      node = all_nodes->next_node;
+      free(all_nodes);
+      all_nodes = node;
+   }
+   htable_destroy(&live_nodes, NULL);
+   htable_destroy(&commands, free);
+}
+
+//*****************************************************************************
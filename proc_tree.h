@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __PROC_TREE_H
+#define __PROC_TREE_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// builds the tree of monitored processes from the ppid carried by START
+// and aggregates I/O per subtree and per normalized command (e.g., all
+// "gcc" processes of a build). meant for workloads that spawn thousands
+// of short-lived processes such as build systems and shell pipelines.
+
+void proc_tree_init(FILE* output);
+void proc_tree_record(const struct process_info* process,
+                      const struct monitor_record_t* monitor_record);
+void proc_tree_report();
+
+// normalized command of a command line: basename of the program, plus
+// the basename of the script for well-known interpreters
+void normalize_command(const char* cmdline, char* out, size_t out_len);
+
+#endif //__PROC_TREE_H
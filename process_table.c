@@ -0,0 +1,197 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// process_table.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "process_table.h"
+
+static struct htable processes;   // pid -> struct process_info*
+
+//*****************************************************************************
+
+static void free_process(void* value)
+{
+   struct process_info* process = value;
+
+   htable_destroy(&process->fd_paths, free);
+   htable_destroy(&process->thread_names, free);
+   free(process->cmdline);
+   free(process);
+}
+
+//*****************************************************************************
+
+void process_table_init()
+{
+   htable_init(&processes);
+}
+
+//*****************************************************************************
+
+void process_table_fini()
+{
+   htable_destroy(&processes, free_process);
+}
+
+//*****************************************************************************
+
+struct process_info* process_table_lookup(int pid)
+{
+   return htable_get_int(&processes, pid);
+}
+
+//*****************************************************************************
+
+struct process_info* process_table_update(const struct monitor_record_t* r)
+{
+   struct process_info* process = htable_get_int(&processes, r->pid);
+   const long long end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+
+   if (process == NULL || (r->op_type == START && process->stopped)) {
+      if (process != NULL) {
+         // pid reuse
+         htable_remove_int(&processes, r->pid);
+         free_process(process);
+      }
+      process = calloc(1, sizeof(struct process_info));
+      process->pid = r->pid;
+      process->ppid = -1;
+      process->start_usec = r->start_usec;
+      snprintf(process->facility, sizeof(process->facility), "%.*s",
+               (int) sizeof(process->facility) - 1, r->facility);
+      snprintf(process->container_id, sizeof(process->container_id), "%s", r->container_id);
+      htable_init(&process->fd_paths);
+      htable_init(&process->thread_names);
+      htable_put_int(&processes, r->pid, process);
+   }
+
+   if (r->op_type == START) {
+      free(process->cmdline);
+      process->cmdline = strdup(r->s1);
+      process->ppid = atoi(r->s2);
+   } else if (r->op_type == STOP) {
+      process->stopped = 1;
+   } else if (r->op_type == THREAD_START) {
+      const int tid = atoi(r->s2);
+      free(htable_remove_int(&process->thread_names, tid));
+      htable_put_int(&process->thread_names, tid, strdup(r->s1));
+   } else if (r->op_type == OPEN && r->fd >= 0 && r->error_code == 0 && r->s1[0]) {
+      free(htable_remove_int(&process->fd_paths, r->fd));
+      htable_put_int(&process->fd_paths, r->fd, strdup(r->s1));
+   }
+
+   if (end_usec > process->last_usec) {
+      process->last_usec = end_usec;
+   }
+
+   return process;
+}
+
+//*****************************************************************************
+
+void process_table_release(const struct monitor_record_t* r)
+{
+   struct process_info* process = htable_get_int(&processes, r->pid);
+
+   if (process == NULL) {
+      return;
+   }
+
+   if (r->op_type == STOP) {
+      htable_remove_int(&processes, r->pid);
+      free_process(process);
+   } else if (r->op_type == CLOSE && r->fd >= 0) {
+      free(htable_remove_int(&process->fd_paths, r->fd));
+   }
+}
+
+//*****************************************************************************
+
+const char* process_fd_path(const struct process_info* process, int fd)
+{
+   if (process == NULL || fd < 0) {
+      return NULL;
+   }
+   return htable_get_int(&process->fd_paths, fd);
+}
+
+//*****************************************************************************
+
+const char* record_path(const struct process_info* process,
+                        const struct monitor_record_t* r)
+{
+   if (r->fd >= 0) {
+      return process_fd_path(process, r->fd);
+   }
+
+   switch (r->dom_type) {
+      case FILE_OPEN_CLOSE:
+      case FILE_METADATA:
+      case FILE_SPACE:
+      case XATTRS:
+      case DIR_METADATA:
+      case DIRS:
+      case LINKS:
+         return r->s1[0] ? r->s1 : NULL;
+      default:
+         return NULL;
+   }
+}
+
+//*****************************************************************************
+
+size_t record_target_key(const struct monitor_record_t* r, const char* path, char* key)
+{
+   size_t path_len;
+
+   memcpy(key, &r->pid, sizeof(int));
+   if (path != NULL) {
+      // keep the end of long paths
+      path_len = strlen(path);
+      if (path_len >= RECORD_TARGET_LEN) {
+         path += path_len - (RECORD_TARGET_LEN - 1);
+      }
+      snprintf(key + sizeof(int), RECORD_TARGET_LEN, "%s", path);
+   } else {
+      snprintf(key + sizeof(int), RECORD_TARGET_LEN, "[fd %d]", r->fd);
+   }
+   return sizeof(int) + strlen(key + sizeof(int));
+}
+
+//*****************************************************************************
+
+const char* process_thread_name(const struct process_info* process, int tid)
+{
+   if (process == NULL) {
+      return NULL;
+   }
+   return htable_get_int(&process->thread_names, tid);
+}
+
+//*****************************************************************************
+
+double process_lifetime_ms(const struct process_info* process)
+{
+   return (process->last_usec - process->start_usec) / 1000.0;
+}
+
+//*****************************************************************************
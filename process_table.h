@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __PROCESS_TABLE_H
+#define __PROCESS_TABLE_H
+#include "htable.h"
+#include "monitor_record.h"
+
+// listener-side state of each monitored process from its START to its
+// STOP. every record is passed to process_table_update() before the
+// analysis modules see it and to process_table_release() afterwards, so
+// that modules can rely on the fd -> path mapping being current (e.g.,
+// the path of an fd is still known while its CLOSE is processed).
+
+#define PROCESS_FACILITY_LEN 8
+
+struct process_info {
+   int pid;
+   int ppid;                    // -1 if no START was seen (e.g., forked)
+   char facility[PROCESS_FACILITY_LEN];
+   char container_id[CONTAINER_ID_LEN];
+   char* cmdline;
+   long long start_usec;        // START, or first event seen
+   long long last_usec;         // end of the most recent event
+   int stopped;
+   struct htable fd_paths;      // fd -> path (char*)
+   struct htable thread_names;  // tid -> name (char*), from THREAD_START
+};
+
+void process_table_init();
+void process_table_fini();
+
+struct process_info* process_table_update(const struct monitor_record_t* monitor_record);
+void process_table_release(const struct monitor_record_t* monitor_record);
+
+struct process_info* process_table_lookup(int pid);
+
+// path of an open fd in the given process, or NULL if not known
+const char* process_fd_path(const struct process_info* process, int fd);
+
+// path the record refers to: the path of its fd if known, otherwise the
+// path argument of path-based calls (stat, access, open, ...)
+const char* record_path(const struct process_info* process,
+                        const struct monitor_record_t* monitor_record);
+
+// key for tables per process and file: the pid, followed by the path (its
+// last RECORD_TARGET_LEN - 1 characters if longer) or "[fd N]" if the path
+// is not known. key must hold RECORD_TARGET_KEY_LEN bytes; the target
+// starts at key + sizeof(int). returns the length of the key.
+#define RECORD_TARGET_LEN 64
+#define RECORD_TARGET_KEY_LEN (sizeof(int) + RECORD_TARGET_LEN)
+size_t record_target_key(const struct monitor_record_t* monitor_record, const char* path,
+                         char* key);
+
+// name of a thread of the process, or NULL if no THREAD_START was seen
+const char* process_thread_name(const struct process_info* process, int tid);
+
+// elapsed time of the process as seen from its events (milliseconds)
+double process_lifetime_ms(const struct process_info* process);
+
+#endif //__PROCESS_TABLE_H
@@ -0,0 +1,376 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// prom_metrics.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "domains.h"
+#include "ops.h"
+#include "ops_names.h"
+#include "domains_names.h"
+#include "htable.h"
+#include "histogram.h"
+#include "prom_metrics.h"
+
+static const int TEXTFILE_INTERVAL_SECS = 15;
+static const int HTTP_BACKLOG = 8;
+// a client that sends nothing (or stops reading) cannot hold up the server
+static const int HTTP_TIMEOUT_SECS = 5;
+
+// facility ids are at most 4 characters in the shim
+#define FACILITY_LEN 8
+
+struct series_key {
+   char facility[FACILITY_LEN];
+   char container[CONTAINER_ID_LEN];
+   int dom_type;
+   int op_type;
+   int error_code;
+};
+
+struct series {
+   struct series_key key;
+   unsigned long long operations;
+   unsigned long long bytes;
+   struct histogram latency_usec;
+};
+
+static struct htable all_series;
+static pthread_mutex_t series_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char* textfile_path = NULL;
+static time_t last_textfile_write = 0;
+static int http_fd = -1;
+static pthread_t http_thread;
+
+//*****************************************************************************
+
+void prom_metrics_record(const struct monitor_record_t* r)
+{
+   struct series_key key;
+   struct series* s;
+
+   if (http_fd < 0 && textfile_path == NULL) {
+      return;
+   }
+   // process and thread events (START, STOP, BLOCKED, ...) are not I/O;
+   // BLOCKED would add intervals of seconds to the latency histogram
+   if (r->dom_type == START_STOP) {
+      return;
+   }
+
+   memset(&key, 0, sizeof(key));
+   snprintf(key.facility, sizeof(key.facility), "%.*s", (int) sizeof(key.facility) - 1,
+            r->facility);
+   snprintf(key.container, sizeof(key.container), "%s", r->container_id);
+   key.dom_type = r->dom_type;
+   key.op_type = r->op_type;
+   key.error_code = r->error_code;
+
+   pthread_mutex_lock(&series_lock);
+   s = htable_get(&all_series, &key, sizeof(key));
+   if (s == NULL) {
+      s = calloc(1, sizeof(struct series));
+      s->key = key;
+      htable_put(&all_series, &key, sizeof(key), s);
+   }
+   s->operations++;
+   s->bytes += r->bytes_transferred;
+   histogram_add(&s->latency_usec, r->elapsed_time * 1000.0);
+   pthread_mutex_unlock(&series_lock);
+}
+
+//*****************************************************************************
+
+static void write_label_value(FILE* out, const char* value)
+{
+   const char* p;
+
+   for (p = value; *p; ++p) {
+      if (*p == '"' || *p == '\\') {
+         fputc('\\', out);
+      }
+      fputc(*p, out);
+   }
+}
+
+//*****************************************************************************
+
+static void write_labels(FILE* out, const struct series_key* key, int with_error)
+{
+   fputs("{facility=\"", out);
+   write_label_value(out, key->facility);
+   fputs("\",container=\"", out);
+   write_label_value(out, key->container);
+   fprintf(out, "\",domain=\"%s\",op=\"%s\"",
+           domains_names[key->dom_type], ops_names[key->op_type]);
+   if (with_error) {
+      fprintf(out, ",error=\"%d\"", key->error_code);
+   }
+}
+
+//*****************************************************************************
+
+static void write_operations(const void* k, size_t len, void* value, void* ctx)
+{
+   const struct series* s = value;
+
+   fputs("io_monitor_operations_total", ctx);
+   write_labels(ctx, &s->key, 1);
+   fprintf(ctx, "} %llu\n", s->operations);
+}
+
+static void write_bytes(const void* k, size_t len, void* value, void* ctx)
+{
+   const struct series* s = value;
+
+   fputs("io_monitor_bytes_total", ctx);
+   write_labels(ctx, &s->key, 1);
+   fprintf(ctx, "} %llu\n", s->bytes);
+}
+
+static void write_latency(const void* k, size_t len, void* value, void* ctx)
+{
+   const struct series* s = value;
+   unsigned long long cumulative = 0;
+   int i;
+
+   // log2 microsecond buckets; skip the sub-microsecond and the very
+   // long tail ones to keep the exposition compact
+   for (i = 0; i < HISTOGRAM_BUCKETS - 1; ++i) {
+      cumulative += s->latency_usec.counts[i];
+      if (i < 2 || i > 26) {
+         continue;
+      }
+      fputs("io_monitor_latency_seconds_bucket", ctx);
+      write_labels(ctx, &s->key, 1);
+      fprintf(ctx, ",le=\"%g\"} %llu\n",
+              histogram_bucket_upper(i) / 1000000.0, cumulative);
+   }
+   fputs("io_monitor_latency_seconds_bucket", ctx);
+   write_labels(ctx, &s->key, 1);
+   fprintf(ctx, ",le=\"+Inf\"} %llu\n", s->latency_usec.count);
+
+   fputs("io_monitor_latency_seconds_sum", ctx);
+   write_labels(ctx, &s->key, 1);
+   fprintf(ctx, "} %.9f\n", s->latency_usec.sum / 1000000.0);
+
+   fputs("io_monitor_latency_seconds_count", ctx);
+   write_labels(ctx, &s->key, 1);
+   fprintf(ctx, "} %llu\n", s->latency_usec.count);
+}
+
+//*****************************************************************************
+
+static void write_exposition(FILE* out)
+{
+   pthread_mutex_lock(&series_lock);
+
+   fputs("# HELP io_monitor_operations_total Intercepted operations.\n", out);
+   fputs("# TYPE io_monitor_operations_total counter\n", out);
+   htable_foreach(&all_series, write_operations, out);
+
+   fputs("# HELP io_monitor_bytes_total Bytes transferred by intercepted operations.\n", out);
+   fputs("# TYPE io_monitor_bytes_total counter\n", out);
+   htable_foreach(&all_series, write_bytes, out);
+
+   fputs("# HELP io_monitor_latency_seconds Latency of intercepted operations.\n", out);
+   fputs("# TYPE io_monitor_latency_seconds histogram\n", out);
+   htable_foreach(&all_series, write_latency, out);
+
+   pthread_mutex_unlock(&series_lock);
+}
+
+//*****************************************************************************
+
+static void write_textfile()
+{
+   char tmp_path[PATH_MAX];
+   FILE* out;
+
+   // write to a temporary file and rename so that the collector never
+   // sees a partially written file
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", textfile_path, getpid());
+   out = fopen(tmp_path, "w");
+   if (out == NULL) {
+      printf("error: unable to write metrics to '%s'\n", tmp_path);
+      return;
+   }
+   write_exposition(out);
+   fclose(out);
+   if (rename(tmp_path, textfile_path) != 0) {
+      printf("error: unable to rename '%s' to '%s'\n", tmp_path, textfile_path);
+      unlink(tmp_path);
+   }
+}
+
+//*****************************************************************************
+
+static void serve_request(int client_fd)
+{
+   static const char* not_found =
+      "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   char request[1024];
+   char* body = NULL;
+   size_t body_len = 0;
+   char header[256];
+   struct timeval timeout;
+   ssize_t n;
+   FILE* out;
+
+   timeout.tv_sec = HTTP_TIMEOUT_SECS;
+   timeout.tv_usec = 0;
+   setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+   n = read(client_fd, request, sizeof(request) - 1);
+   if (n <= 0) {
+      return;
+   }
+   request[n] = '\0';
+
+   if (strncmp(request, "GET /metrics", 12) && strncmp(request, "GET / ", 6)) {
+      write(client_fd, not_found, strlen(not_found));
+      return;
+   }
+
+   out = open_memstream(&body, &body_len);
+   if (out == NULL) {
+      return;
+   }
+   write_exposition(out);
+   fclose(out);
+
+   snprintf(header, sizeof(header),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", body_len);
+   if (write(client_fd, header, strlen(header)) > 0) {
+      size_t sent = 0;
+      while (sent < body_len) {
+         n = write(client_fd, body + sent, body_len - sent);
+         if (n <= 0) {
+            break;
+         }
+         sent += n;
+      }
+   }
+   free(body);
+}
+
+//*****************************************************************************
+
+static void* http_server(void* arg)
+{
+   int client_fd;
+
+   while (1) {
+      client_fd = accept(http_fd, NULL, NULL);
+      if (client_fd < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      serve_request(client_fd);
+      close(client_fd);
+   }
+   return NULL;
+}
+
+//*****************************************************************************
+
+int prom_metrics_init(int http_port, const char* path)
+{
+   struct sockaddr_in addr;
+   sigset_t blocked;
+   sigset_t previous;
+   int one = 1;
+
+   htable_init(&all_series);
+   textfile_path = path;
+
+   if (http_port <= 0) {
+      return 0;
+   }
+
+   http_fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (http_fd < 0) {
+      printf("error: unable to create metrics socket\n");
+      return -1;
+   }
+   setsockopt(http_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+   // metrics are exposed locally only; scrape via an exporter/proxy
+   // if they need to leave the host
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+   addr.sin_port = htons(http_port);
+
+   if (bind(http_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+       listen(http_fd, HTTP_BACKLOG) != 0) {
+      printf("error: unable to listen for metrics on port %d\n", http_port);
+      printf("errno: %d\n", errno);
+      close(http_fd);
+      http_fd = -1;
+      return -1;
+   }
+
+   // the main thread handles the listener's signals
+   sigfillset(&blocked);
+   pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+   if (pthread_create(&http_thread, NULL, http_server, NULL) != 0) {
+      printf("error: unable to start metrics thread\n");
+      close(http_fd);
+      http_fd = -1;
+   }
+   pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+   return (http_fd < 0) ? -1 : 0;
+}
+
+//*****************************************************************************
+
+void prom_metrics_tick(time_t now)
+{
+   if (textfile_path != NULL && now - last_textfile_write >= TEXTFILE_INTERVAL_SECS) {
+      write_textfile();
+      last_textfile_write = now;
+   }
+}
+
+//*****************************************************************************
+
+void prom_metrics_report()
+{
+   if (textfile_path != NULL) {
+      write_textfile();
+   }
+}
+
+//*****************************************************************************
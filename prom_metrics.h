@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __PROM_METRICS_H
+#define __PROM_METRICS_H
+#include <time.h>
+#include "monitor_record.h"
+
+// aggregated counters and latency histograms per facility/domain/op/error,
+// exposed in the Prometheus text format over a local HTTP endpoint and/or
+// written periodically to a node_exporter textfile-collector file.
+
+// http_port == 0 disables the HTTP endpoint; textfile_path == NULL
+// disables the textfile collector output.
+int prom_metrics_init(int http_port, const char* textfile_path);
+void prom_metrics_record(const struct monitor_record_t* monitor_record);
+void prom_metrics_tick(time_t now);
+void prom_metrics_report();
+
+#endif //__PROM_METRICS_H
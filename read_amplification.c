@@ -0,0 +1,324 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// read_amplification.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "read_amplification.h"
+
+// unique bytes are counted in blocks of this size, up to MAX_BLOCKS
+// (16 GiB) per file
+#define BLOCK_SHIFT 12
+static const long long BLOCK_SIZE = 1LL << BLOCK_SHIFT;
+static const long long MAX_BLOCKS = 1LL << 22;
+
+// a session that reads this share of the file is a full scan
+static const double FULL_SCAN_COVERAGE = 0.9;
+// files read at least this many times over their unique bytes are flagged
+static const double MIN_AMPLIFICATION = 2.0;
+// files at least this large that are scanned repeatedly want an index
+static const long long LARGE_FILE_SIZE = 1024 * 1024;
+// reads below this size into a large file are small random reads
+static const double SMALL_READ_SIZE = 16 * 1024;
+
+static const int TOP_FILES = 20;
+
+struct block_set {
+   unsigned char* bits;
+   long long num_blocks;      // capacity in blocks
+   long long count;           // blocks set
+};
+
+struct file_stats {
+   char* path;
+   unsigned long inode;
+   long long size;            // size at the latest open
+   unsigned long long sessions;
+   unsigned long long full_scans;
+   unsigned long long reads;
+   unsigned long long bytes_read;
+   double read_ms;
+   struct block_set read_blocks;
+};
+
+// an open fd of a regular file of known size
+struct session {
+   struct file_stats* file;
+   unsigned long inode;       // of the file opened
+   unsigned long long bytes_read;
+   struct block_set read_blocks;
+};
+
+static FILE* report_output = NULL;
+static struct htable files;       // path -> struct file_stats*
+static struct htable sessions;    // (pid, fd) -> struct session*
+
+//*****************************************************************************
+
+void read_amplification_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&files);
+   htable_init(&sessions);
+}
+
+//*****************************************************************************
+
+static void block_set_add(struct block_set* set, long long block)
+{
+   long long num_blocks;
+
+   if (block >= MAX_BLOCKS) {
+      return;
+   }
+   if (block >= set->num_blocks) {
+      num_blocks = set->num_blocks ? set->num_blocks : 64;
+      while (num_blocks <= block) {
+         num_blocks *= 2;
+      }
+      set->bits = realloc(set->bits, num_blocks / 8);
+      memset(set->bits + set->num_blocks / 8, 0, (num_blocks - set->num_blocks) / 8);
+      set->num_blocks = num_blocks;
+   }
+   if (!(set->bits[block / 8] & (1 << (block % 8)))) {
+      set->bits[block / 8] |= 1 << (block % 8);
+      set->count++;
+   }
+}
+
+//*****************************************************************************
+
+static void block_set_clear(struct block_set* set)
+{
+   free(set->bits);
+   memset(set, 0, sizeof(struct block_set));
+}
+
+//*****************************************************************************
+
+static long long block_set_bytes(const struct block_set* set, long long size)
+{
+   const long long bytes = set->count * BLOCK_SIZE;
+
+   return (size >= 0 && bytes > size) ? size : bytes;
+}
+
+//*****************************************************************************
+
+static long session_key(const struct monitor_record_t* r)
+{
+   return ((long) r->pid << 32) | (unsigned int) r->fd;
+}
+
+static void free_session(void* value)
+{
+   struct session* session = value;
+
+   block_set_clear(&session->read_blocks);
+   free(session);
+}
+
+static void free_file(void* value)
+{
+   struct file_stats* file = value;
+
+   block_set_clear(&file->read_blocks);
+   free(file->path);
+   free(file);
+}
+
+//*****************************************************************************
+
+static void end_session(struct session* session)
+{
+   struct file_stats* file = session->file;
+
+   if (session->inode == file->inode && file->size > 0 &&
+       block_set_bytes(&session->read_blocks, file->size) >= FULL_SCAN_COVERAGE * file->size) {
+      file->full_scans++;
+   }
+   free_session(session);
+}
+
+//*****************************************************************************
+
+static void record_open(const struct monitor_record_t* r)
+{
+   struct file_stats* file;
+   struct session* session;
+
+   session = htable_remove_int(&sessions, session_key(r));
+   if (session != NULL) {
+      end_session(session);
+   }
+   if (r->file_size < 0 || r->s1[0] == '\0') {
+      return;
+   }
+
+   file = htable_get_str(&files, r->s1);
+   if (file == NULL) {
+      file = calloc(1, sizeof(struct file_stats));
+      file->path = strdup(r->s1);
+      file->inode = r->inode;
+      htable_put_str(&files, r->s1, file);
+   } else if (file->inode != r->inode) {
+      // the file was replaced: everything counted so far was of another
+      // file, and fds still open on it no longer count
+      block_set_clear(&file->read_blocks);
+      file->sessions = 0;
+      file->full_scans = 0;
+      file->reads = 0;
+      file->bytes_read = 0;
+      file->read_ms = 0.0;
+      file->inode = r->inode;
+   }
+   file->size = r->file_size;
+   file->sessions++;
+
+   session = calloc(1, sizeof(struct session));
+   session->file = file;
+   session->inode = r->inode;
+   htable_put_int(&sessions, session_key(r), session);
+}
+
+//*****************************************************************************
+
+void read_amplification_record(const struct process_info* process,
+                               const struct monitor_record_t* r)
+{
+   struct session* session;
+   long long block;
+   long long last_block;
+
+   if (report_output == NULL || r->error_code != 0 || r->fd < 0) {
+      return;
+   }
+
+   if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE) {
+      record_open(r);
+      return;
+   }
+
+   session = htable_get_int(&sessions, session_key(r));
+   if (session == NULL) {
+      return;
+   }
+
+   if (r->op_type == READ && r->dom_type == FILE_READ) {
+      if (session->inode != session->file->inode) {
+         return;
+      }
+      session->bytes_read += r->bytes_transferred;
+      session->file->reads++;
+      session->file->bytes_read += r->bytes_transferred;
+      session->file->read_ms += r->elapsed_time;
+      if (r->offset >= 0 && r->bytes_transferred > 0) {
+         last_block = (r->offset + r->bytes_transferred - 1) >> BLOCK_SHIFT;
+         for (block = r->offset >> BLOCK_SHIFT; block <= last_block; ++block) {
+            block_set_add(&session->read_blocks, block);
+            block_set_add(&session->file->read_blocks, block);
+         }
+      }
+   } else if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE) {
+      htable_remove_int(&sessions, session_key(r));
+      end_session(session);
+   }
+}
+
+//*****************************************************************************
+
+static void collect_file(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct file_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_files(const void* a, const void* b)
+{
+   const struct file_stats* fa = *(struct file_stats* const*) a;
+   const struct file_stats* fb = *(struct file_stats* const*) b;
+
+   return (fa->bytes_read < fb->bytes_read) - (fa->bytes_read > fb->bytes_read);
+}
+
+//*****************************************************************************
+
+static const char* suggestion(const struct file_stats* file, double amplification)
+{
+   if (file->size >= LARGE_FILE_SIZE && file->full_scans >= 2) {
+      return "index";
+   }
+   if (amplification < MIN_AMPLIFICATION) {
+      return "-";
+   }
+   if (file->size >= LARGE_FILE_SIZE &&
+       (double) file->bytes_read / file->reads < SMALL_READ_SIZE) {
+      return "mmap";
+   }
+   return "cache";
+}
+
+//*****************************************************************************
+
+void read_amplification_report()
+{
+   struct file_stats** list;
+   struct file_stats** end;
+   size_t count;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((files.count + 1) * sizeof(struct file_stats*));
+   end = list;
+   htable_foreach(&files, collect_file, &end);
+   count = end - list;
+   qsort(list, count, sizeof(struct file_stats*), compare_files);
+
+   fprintf(report_output, "\n===== read amplification: top %d files by bytes read\n", TOP_FILES);
+   fprintf(report_output, "  %12s %8s %6s %9s %14s %14s %8s %8s %10s %-6s  %s\n",
+           "SIZE", "OPENS", "FULL", "READS", "READ(B)", "UNIQUE(B)",
+           "xSIZE", "xUNIQUE", "TIME(ms)", "HINT", "FILE");
+   for (i = 0; i < count && i < (size_t) TOP_FILES; ++i) {
+      const struct file_stats* f = list[i];
+      const long long unique = block_set_bytes(&f->read_blocks, f->size);
+      const double amplification = unique > 0 ? (double) f->bytes_read / unique : 0.0;
+
+      if (f->bytes_read == 0) {
+         break;
+      }
+      fprintf(report_output, "  %12lld %8llu %6llu %9llu %14llu %14lld %8.1f %8.1f %10.3f %-6s  %s\n",
+              f->size, f->sessions, f->full_scans, f->reads, f->bytes_read, unique,
+              f->size > 0 ? (double) f->bytes_read / f->size : 0.0, amplification,
+              f->read_ms, suggestion(f, amplification), f->path);
+   }
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&sessions, free_session);
+   htable_destroy(&files, free_file);
+}
+
+//*****************************************************************************
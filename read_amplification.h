@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __READ_AMPLIFICATION_H
+#define __READ_AMPLIFICATION_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// compares the bytes read from each file with its size and with the unique
+// bytes read, using the file size and inode recorded at open (STAT_ON_OPEN).
+// files read many times over, or large files scanned fully again and again,
+// are flagged as candidates for caching, mmap or an index.
+
+void read_amplification_init(FILE* output);
+void read_amplification_record(const struct process_info* process,
+                               const struct monitor_record_t* monitor_record);
+void read_amplification_report();
+
+#endif //__READ_AMPLIFICATION_H
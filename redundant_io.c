@@ -0,0 +1,441 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// redundant_io.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "redundant_io.h"
+
+// a lookup of a path is redundant when the process looked up the same
+// path within this time, and an open-read-close cycle when the previous
+// cycle of the same file ended within it
+static const long long REPEAT_WINDOW_USEC = 1000000;
+
+static const int TOP_PATTERNS = 30;
+
+enum pattern_kind {
+   KIND_STAT,      // successful stat/lstat of the same path
+   KIND_ACCESS,    // successful access/faccessat
+   KIND_OPEN,      // successful open
+   KIND_MISSING,   // any of them failing with ENOENT
+   KIND_REREAD,    // full read of a file that is unchanged since the last one
+   KIND_CYCLE,     // open, read only, close
+   NUM_KINDS
+};
+
+static const char* kind_names[NUM_KINDS] = {
+   "stat", "access", "open", "ENOENT", "re-read", "open-read-close"
+};
+
+struct pattern {
+   int pid;
+   int kind;
+   char* path;
+   unsigned long long count;     // redundant occurrences
+   unsigned long long bytes;     // re-read bytes
+   double ms;                    // time of the redundant occurrences
+   long long last_end_usec;
+   // full reads
+   unsigned long long full_reads;
+   unsigned long long last_full_bytes;
+   long last_generation;
+};
+
+// an open fd, from OPEN to CLOSE
+struct session {
+   char* path;
+   long long open_usec;
+   double open_ms;
+   struct pattern* counted_open; // the open was counted as redundant
+   double read_ms;
+   unsigned long long reads;
+   unsigned long long read_bytes;
+   int wrote;
+   int sequential;               // every read started where the last ended
+   int eof;                      // a read returned 0 bytes
+   long long next_offset;
+};
+
+struct process_totals {
+   int pid;
+   unsigned long long missing;   // lookups failing with ENOENT
+   double missing_ms;
+   unsigned long long redundant;
+   double redundant_ms;
+};
+
+static FILE* report_output = NULL;
+static struct htable patterns;     // (pid, kind, path) -> struct pattern*
+static struct htable sessions;     // (pid, fd) -> struct session*
+static struct htable generations;  // path -> number of writes/truncates seen
+static struct htable processes;    // pid -> struct process_totals*
+
+//*****************************************************************************
+
+void redundant_io_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&patterns);
+   htable_init(&sessions);
+   htable_init(&generations);
+   htable_init(&processes);
+}
+
+//*****************************************************************************
+
+static struct pattern* get_pattern(int pid, int kind, const char* path)
+{
+   char key[2 * sizeof(int) + PATH_MAX];
+   const size_t path_len = strnlen(path, PATH_MAX - 1);
+   const size_t key_len = 2 * sizeof(int) + path_len;
+   struct pattern* pattern;
+
+   memcpy(key, &pid, sizeof(int));
+   memcpy(key + sizeof(int), &kind, sizeof(int));
+   memcpy(key + 2 * sizeof(int), path, path_len);
+
+   pattern = htable_get(&patterns, key, key_len);
+   if (pattern == NULL) {
+      pattern = calloc(1, sizeof(struct pattern));
+      pattern->pid = pid;
+      pattern->kind = kind;
+      pattern->path = strndup(path, path_len);
+      pattern->last_end_usec = -1;
+      htable_put(&patterns, key, key_len, pattern);
+   }
+   return pattern;
+}
+
+//*****************************************************************************
+
+static struct process_totals* get_process(int pid)
+{
+   struct process_totals* totals = htable_get_int(&processes, pid);
+
+   if (totals == NULL) {
+      totals = calloc(1, sizeof(struct process_totals));
+      totals->pid = pid;
+      htable_put_int(&processes, pid, totals);
+   }
+   return totals;
+}
+
+//*****************************************************************************
+
+static long session_key(const struct monitor_record_t* r)
+{
+   return ((long) r->pid << 32) | (unsigned int) r->fd;
+}
+
+static void free_session(void* value)
+{
+   struct session* session = value;
+
+   free(session->path);
+   free(session);
+}
+
+static void free_pattern(void* value)
+{
+   struct pattern* pattern = value;
+
+   free(pattern->path);
+   free(pattern);
+}
+
+//*****************************************************************************
+
+// counts a lookup, returns the pattern if it repeats one within the window
+static struct pattern* record_lookup(const struct monitor_record_t* r, int kind,
+                                     long long end_usec)
+{
+   struct pattern* pattern = get_pattern(r->pid, kind, r->s1);
+   const long long last_end_usec = pattern->last_end_usec;
+
+   pattern->last_end_usec = end_usec;
+   if (last_end_usec < 0 || r->start_usec - last_end_usec > REPEAT_WINDOW_USEC) {
+      return NULL;
+   }
+   pattern->count++;
+   pattern->ms += r->elapsed_time;
+   return pattern;
+}
+
+//*****************************************************************************
+
+static void record_close(const struct monitor_record_t* r, struct session* session,
+                         long long end_usec)
+{
+   const double cycle_ms = session->open_ms + session->read_ms + r->elapsed_time;
+   struct pattern* pattern;
+   long generation;
+
+   if (session->reads == 0 || session->wrote) {
+      return;
+   }
+
+   // the open is accounted for by the cycle (or re-read) instead
+   if (session->counted_open != NULL) {
+      session->counted_open->count--;
+      session->counted_open->ms -= session->open_ms;
+   }
+
+   if (session->sequential && session->eof) {
+      pattern = get_pattern(r->pid, KIND_REREAD, session->path);
+      generation = (long) htable_get_str(&generations, session->path);
+      if (pattern->full_reads > 0 && pattern->last_full_bytes == session->read_bytes &&
+          pattern->last_generation == generation) {
+         pattern->count++;
+         pattern->bytes += session->read_bytes;
+         pattern->ms += cycle_ms;
+         pattern->last_end_usec = end_usec;
+         get_pattern(r->pid, KIND_CYCLE, session->path)->last_end_usec = end_usec;
+         return;
+      }
+      pattern->full_reads++;
+      pattern->last_full_bytes = session->read_bytes;
+      pattern->last_generation = generation;
+   }
+
+   // opening and closing the file again is the overhead of the cycle
+   pattern = get_pattern(r->pid, KIND_CYCLE, session->path);
+   if (pattern->last_end_usec >= 0 &&
+       session->open_usec - pattern->last_end_usec <= REPEAT_WINDOW_USEC) {
+      pattern->count++;
+      pattern->ms += session->open_ms + r->elapsed_time;
+   }
+   pattern->last_end_usec = end_usec;
+}
+
+//*****************************************************************************
+
+void redundant_io_record(const struct process_info* process,
+                         const struct monitor_record_t* r)
+{
+   const long long end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+   struct session* session;
+   struct session* old_session;
+   struct process_totals* totals;
+   struct pattern* pattern;
+   const char* path;
+   int kind;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   if ((r->op_type == STAT || r->op_type == ACCESS) && r->dom_type == FILE_METADATA) {
+      // only lookups by path; fstat of an open fd is cheap
+      if (r->s1[0] == '\0') {
+         return;
+      }
+      kind = r->op_type == STAT ? KIND_STAT : KIND_ACCESS;
+   } else if (r->op_type == OPEN && r->dom_type == FILE_OPEN_CLOSE) {
+      if (r->s1[0] == '\0') {
+         return;
+      }
+      kind = KIND_OPEN;
+   } else {
+      kind = -1;
+   }
+
+   if (kind >= 0) {
+      if (r->error_code == ENOENT) {
+         totals = get_process(r->pid);
+         totals->missing++;
+         totals->missing_ms += r->elapsed_time;
+         record_lookup(r, KIND_MISSING, end_usec);
+         return;
+      }
+      if (r->error_code != 0) {
+         return;
+      }
+      pattern = record_lookup(r, kind, end_usec);
+      if (kind == KIND_OPEN && r->fd >= 0) {
+         session = calloc(1, sizeof(struct session));
+         session->path = strdup(r->s1);
+         session->open_ms = r->elapsed_time;
+         session->counted_open = pattern;
+         session->open_usec = r->start_usec;
+         session->sequential = 1;
+         old_session = htable_remove_int(&sessions, session_key(r));
+         if (old_session != NULL) {
+            free_session(old_session);
+         }
+         htable_put_int(&sessions, session_key(r), session);
+      }
+      return;
+   }
+
+   if (r->error_code != 0) {
+      return;
+   }
+
+   if ((r->op_type == WRITE && r->dom_type == FILE_WRITE) ||
+       (r->op_type == TRUNCATE && r->dom_type == FILE_SPACE)) {
+      path = record_path(process, r);
+      if (path != NULL) {
+         htable_put_str(&generations, path,
+                        (void*) ((long) htable_get_str(&generations, path) + 1));
+      }
+   }
+
+   if (r->fd < 0) {
+      return;
+   }
+   session = htable_get_int(&sessions, session_key(r));
+   if (session == NULL) {
+      return;
+   }
+
+   if (r->op_type == READ && r->dom_type == FILE_READ) {
+      if (r->offset >= 0 && r->offset != session->next_offset) {
+         session->sequential = 0;
+      }
+      session->reads++;
+      session->read_bytes += r->bytes_transferred;
+      session->read_ms += r->elapsed_time;
+      session->next_offset += r->bytes_transferred;
+      if (r->bytes_transferred == 0) {
+         session->eof = 1;
+      }
+   } else if (r->op_type == WRITE && r->dom_type == FILE_WRITE) {
+      session->wrote = 1;
+   } else if (r->op_type == CLOSE && r->dom_type == FILE_OPEN_CLOSE) {
+      htable_remove_int(&sessions, session_key(r));
+      record_close(r, session, end_usec);
+      free_session(session);
+   }
+}
+
+//*****************************************************************************
+
+static void collect_pattern(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct pattern* pattern = value;
+   struct pattern*** cursor = ctx;
+   struct process_totals* totals;
+
+   if (pattern->count == 0) {
+      return;
+   }
+   totals = get_process(pattern->pid);
+   totals->redundant += pattern->count;
+   totals->redundant_ms += pattern->ms;
+   *(*cursor)++ = pattern;
+}
+
+static void collect_process(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct process_totals*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_patterns(const void* a, const void* b)
+{
+   const struct pattern* pa = *(struct pattern* const*) a;
+   const struct pattern* pb = *(struct pattern* const*) b;
+
+   return (pa->ms < pb->ms) - (pa->ms > pb->ms);
+}
+
+static int compare_processes(const void* a, const void* b)
+{
+   const struct process_totals* pa = *(struct process_totals* const*) a;
+   const struct process_totals* pb = *(struct process_totals* const*) b;
+   const double ta = pa->redundant_ms + pa->missing_ms;
+   const double tb = pb->redundant_ms + pb->missing_ms;
+
+   return (ta < tb) - (ta > tb);
+}
+
+//*****************************************************************************
+
+void redundant_io_report()
+{
+   struct pattern** pattern_list;
+   struct pattern** pattern_end;
+   struct process_totals** process_list;
+   struct process_totals** process_end;
+   unsigned long long kind_count[NUM_KINDS] = { 0 };
+   double kind_ms[NUM_KINDS] = { 0.0 };
+   size_t count;
+   size_t i;
+   int k;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   // collecting the patterns also fills in the process totals
+   pattern_list = malloc((patterns.count + 1) * sizeof(struct pattern*));
+   pattern_end = pattern_list;
+   htable_foreach(&patterns, collect_pattern, &pattern_end);
+   count = pattern_end - pattern_list;
+   qsort(pattern_list, count, sizeof(struct pattern*), compare_patterns);
+
+   process_list = malloc((processes.count + 1) * sizeof(struct process_totals*));
+   process_end = process_list;
+   htable_foreach(&processes, collect_process, &process_end);
+   qsort(process_list, processes.count, sizeof(struct process_totals*), compare_processes);
+
+   fprintf(report_output, "\n===== redundant I/O by process\n");
+   fprintf(report_output, "  %7s %10s %12s %10s %12s\n",
+           "PID", "ENOENT", "ENOENT(ms)", "REDUNDANT", "TIME(ms)");
+   for (i = 0; i < processes.count; ++i) {
+      const struct process_totals* p = process_list[i];
+      fprintf(report_output, "  %7d %10llu %12.3f %10llu %12.3f\n",
+              p->pid, p->missing, p->missing_ms, p->redundant, p->redundant_ms);
+   }
+
+   for (i = 0; i < count; ++i) {
+      kind_count[pattern_list[i]->kind] += pattern_list[i]->count;
+      kind_ms[pattern_list[i]->kind] += pattern_list[i]->ms;
+   }
+   fprintf(report_output, "\n===== redundant I/O by kind\n");
+   fprintf(report_output, "  %-16s %10s %12s\n", "KIND", "COUNT", "TIME(ms)");
+   for (k = 0; k < NUM_KINDS; ++k) {
+      fprintf(report_output, "  %-16s %10llu %12.3f\n", kind_names[k], kind_count[k], kind_ms[k]);
+   }
+
+   fprintf(report_output, "\n===== redundant I/O: top %d patterns by time\n", TOP_PATTERNS);
+   fprintf(report_output, "  %-16s %7s %8s %12s %12s  %s\n",
+           "KIND", "PID", "COUNT", "BYTES", "TIME(ms)", "PATH");
+   for (i = 0; i < count && i < (size_t) TOP_PATTERNS; ++i) {
+      const struct pattern* p = pattern_list[i];
+      fprintf(report_output, "  %-16s %7d %8llu %12llu %12.3f  %s\n",
+              kind_names[p->kind], p->pid, p->count, p->bytes, p->ms, p->path);
+   }
+   fflush(report_output);
+
+   free(pattern_list);
+   free(process_list);
+   htable_destroy(&patterns, free_pattern);
+   htable_destroy(&sessions, free_session);
+   htable_destroy(&generations, NULL);
+   htable_destroy(&processes, free);
+}
+
+//*****************************************************************************
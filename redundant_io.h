@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __REDUNDANT_IO_H
+#define __REDUNDANT_IO_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// finds work a process repeats for nothing: stat/access/open of a path it
+// looked up shortly before (including lookups of missing paths), full
+// re-reads of files that did not change in between, and open-read-close
+// cycles of the same file. patterns are ranked by the time they cost.
+
+void redundant_io_init(FILE* output);
+void redundant_io_record(const struct process_info* process,
+                         const struct monitor_record_t* monitor_record);
+void redundant_io_report();
+
+#endif //__REDUNDANT_IO_H
@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// residency.c
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "residency.h"
+
+//*****************************************************************************
+
+long long residency_bytes(int fd, long long size)
+{
+   unsigned char pages[4096];
+   const long long page_size = sysconf(_SC_PAGESIZE);
+   const long long chunk = sizeof(pages) * page_size;
+   long long resident = 0;
+   long long offset;
+   size_t len;
+   size_t i;
+   void* addr;
+   int rc;
+
+   // one mapping per chunk keeps the vector on the stack
+   for (offset = 0; offset < size; offset += chunk) {
+      len = (size - offset < chunk) ? size - offset : chunk;
+      addr = mmap(NULL, len, PROT_NONE, MAP_SHARED, fd, offset);
+      if (addr == MAP_FAILED) {
+         return -1;
+      }
+      rc = mincore(addr, len, pages);
+      munmap(addr, len);
+      if (rc != 0) {
+         return -1;
+      }
+      for (i = 0; i < (len + page_size - 1) / page_size; ++i) {
+         if (pages[i] & 1) {
+            resident += page_size;
+         }
+      }
+   }
+   return resident < size ? resident : size;
+}
+
+//*****************************************************************************
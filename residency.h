@@ -0,0 +1,29 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __RESIDENCY_H
+#define __RESIDENCY_H
+
+// page cache residency of a regular file (mincore), shared by the shim and
+// the listener. fd must be open for reading. the caller checks that it owns
+// or may write the file: since linux 5.2 mincore reports every page of
+// other files as resident.
+
+// bytes of the first size bytes of the file in the page cache, -1 if it
+// cannot be probed
+long long residency_bytes(int fd, long long size);
+
+#endif //__RESIDENCY_H
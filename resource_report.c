@@ -0,0 +1,219 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// resource_report.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "resource_report.h"
+
+struct process_resources {
+   int pid;
+   char command[40];
+   int stopped;
+   // logical I/O seen by the shim
+   unsigned long long file_read_bytes;
+   unsigned long long file_write_bytes;
+   unsigned long long read_bytes;       // any fd (files, pipes, sockets)
+   unsigned long long write_bytes;
+   // from STOP
+   double utime_ms;
+   double stime_ms;
+   double minflt;
+   double majflt;
+   double nvcsw;
+   double nivcsw;
+   double maxrss_kb;
+   double rchar;
+   double wchar;
+   double disk_read_bytes;
+   double disk_write_bytes;
+   double cancelled_write_bytes;
+};
+
+static FILE* report_output = NULL;
+static struct htable processes;   // pid -> struct process_resources*
+
+//*****************************************************************************
+
+void resource_report_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&processes);
+}
+
+//*****************************************************************************
+
+double resource_value(const struct monitor_record_t* r, const char* key)
+{
+   const size_t key_len = strlen(key);
+   const char* p = r->s1;
+
+   while ((p = strstr(p, key)) != NULL) {
+      if ((p == r->s1 || p[-1] == ' ') && p[key_len] == '=') {
+         return atof(p + key_len + 1);
+      }
+      p += key_len;
+   }
+   return -1.0;
+}
+
+//*****************************************************************************
+
+void resource_report_record(const struct process_info* process,
+                            const struct monitor_record_t* r)
+{
+   struct process_resources* p;
+   const int is_file = r->fd >= 0 && record_path(process, r) != NULL;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   p = htable_get_int(&processes, r->pid);
+   if (p == NULL) {
+      p = calloc(1, sizeof(struct process_resources));
+      p->pid = r->pid;
+      htable_put_int(&processes, r->pid, p);
+   }
+   if (p->command[0] == '\0' && process != NULL && process->cmdline != NULL) {
+      snprintf(p->command, sizeof(p->command), "%s", process->cmdline);
+   }
+
+   if (r->error_code != 0) {
+      return;
+   }
+   if (r->op_type == READ && r->dom_type == FILE_READ) {
+      p->read_bytes += r->bytes_transferred;
+      if (is_file) {
+         p->file_read_bytes += r->bytes_transferred;
+      }
+   } else if (r->op_type == WRITE && r->dom_type == FILE_WRITE) {
+      p->write_bytes += r->bytes_transferred;
+      if (is_file) {
+         p->file_write_bytes += r->bytes_transferred;
+      }
+   } else if (r->op_type == STOP && resource_value(r, "utime") >= 0.0) {
+      p->stopped = 1;
+      p->utime_ms = resource_value(r, "utime");
+      p->stime_ms = resource_value(r, "stime");
+      p->minflt = resource_value(r, "minflt");
+      p->majflt = resource_value(r, "majflt");
+      p->nvcsw = resource_value(r, "nvcsw");
+      p->nivcsw = resource_value(r, "nivcsw");
+      p->maxrss_kb = resource_value(r, "maxrss");
+      p->rchar = resource_value(r, "rchar");
+      p->wchar = resource_value(r, "wchar");
+      p->disk_read_bytes = resource_value(r, "read_bytes");
+      p->disk_write_bytes = resource_value(r, "write_bytes");
+      p->cancelled_write_bytes = resource_value(r, "cancelled_write_bytes");
+   }
+}
+
+//*****************************************************************************
+
+static void collect_process(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct process_resources*** cursor = ctx;
+   struct process_resources* p = value;
+
+   if (p->stopped) {
+      *(*cursor)++ = p;
+   }
+}
+
+static int compare_processes(const void* a, const void* b)
+{
+   const struct process_resources* pa = *(struct process_resources* const*) a;
+   const struct process_resources* pb = *(struct process_resources* const*) b;
+   const double ta = pa->utime_ms + pa->stime_ms;
+   const double tb = pb->utime_ms + pb->stime_ms;
+
+   return (ta < tb) - (ta > tb);
+}
+
+//*****************************************************************************
+
+// share of the file bytes read by the shim that the kernel did not read
+// from storage, i.e. that came from the page cache
+static void format_cache_hit(const struct process_resources* p, char* out, size_t out_len)
+{
+   double hit;
+
+   if (p->disk_read_bytes < 0.0 || p->file_read_bytes == 0) {
+      snprintf(out, out_len, "-");
+      return;
+   }
+   hit = 1.0 - p->disk_read_bytes / p->file_read_bytes;
+   snprintf(out, out_len, "%.1f", 100.0 * (hit < 0.0 ? 0.0 : hit));
+}
+
+//*****************************************************************************
+
+void resource_report_report()
+{
+   struct process_resources** list;
+   struct process_resources** end;
+   char cache_hit[16];
+   size_t count;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((processes.count + 1) * sizeof(struct process_resources*));
+   end = list;
+   htable_foreach(&processes, collect_process, &end);
+   count = end - list;
+   qsort(list, count, sizeof(struct process_resources*), compare_processes);
+
+   fprintf(report_output, "\n===== process resources (since START, from STOP)\n");
+   fprintf(report_output, "  %7s %10s %10s %10s %8s %10s %10s %11s  %s\n",
+           "PID", "USER(ms)", "SYS(ms)", "MINFLT", "MAJFLT", "VCSW", "IVCSW",
+           "MAXRSS(MB)", "COMMAND");
+   for (i = 0; i < count; ++i) {
+      const struct process_resources* p = list[i];
+      fprintf(report_output, "  %7d %10.1f %10.1f %10.0f %8.0f %10.0f %10.0f %11.1f  %s\n",
+              p->pid, p->utime_ms, p->stime_ms, p->minflt, p->majflt, p->nvcsw, p->nivcsw,
+              p->maxrss_kb / 1024.0, p->command);
+   }
+
+   // rchar/wchar count every read/write system call (pipes and sockets
+   // too); read_bytes/write_bytes what went to or came from storage
+   fprintf(report_output, "\n===== logical vs physical I/O (bytes)\n");
+   fprintf(report_output, "  %7s %14s %14s %14s %9s %14s %14s %14s %14s\n",
+           "PID", "SHIM READ", "RCHAR", "DISK READ", "CACHE%", "SHIM WRITE", "WCHAR",
+           "DISK WRITE", "CANCELLED");
+   for (i = 0; i < count; ++i) {
+      const struct process_resources* p = list[i];
+      format_cache_hit(p, cache_hit, sizeof(cache_hit));
+      fprintf(report_output, "  %7d %14llu %14.0f %14.0f %9s %14llu %14.0f %14.0f %14.0f\n",
+              p->pid, p->file_read_bytes, p->rchar, p->disk_read_bytes, cache_hit,
+              p->file_write_bytes, p->wchar, p->disk_write_bytes, p->cancelled_write_bytes);
+   }
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&processes, free);
+}
+
+//*****************************************************************************
@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __RESOURCE_REPORT_H
+#define __RESOURCE_REPORT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// resource usage of each process as sent with its STOP (getrusage and
+// /proc/self/io), and the logical I/O seen by the shim against the
+// physical I/O done by the kernel, to estimate how well the page cache
+// served each job.
+
+void resource_report_init(FILE* output);
+void resource_report_record(const struct process_info* process,
+                            const struct monitor_record_t* monitor_record);
+void resource_report_report();
+
+// value of a "key=value" counter in a STOP record, or -1 if not present
+double resource_value(const struct monitor_record_t* monitor_record, const char* key);
+
+#endif //__RESOURCE_REPORT_H
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// small_io.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "small_io.h"
+
+#define BUFFERING_LEN 16
+
+// requests below this size are small
+static const size_t SMALL_REQUEST_BYTES = 4096;
+
+// fds with fewer small system calls than this are not reported
+static const unsigned long long MIN_SMALL_CALLS = 100;
+
+// a write is back-to-back with the previous one on the same fd if it
+// starts within this time after that one ended, where it ended
+static const long long COALESCE_GAP_USEC = 100;
+
+// suggested buffer size: this, or less if all the data fits
+static const unsigned long long SUGGESTED_BUFFER_BYTES = 64 * 1024;
+static const unsigned long long MIN_BUFFER_BYTES = 4096;
+
+static const int TOP_ENTRIES = 20;
+
+enum { DIRECTION_READ, DIRECTION_WRITE, NUM_DIRECTIONS };
+
+static const char* direction_names[NUM_DIRECTIONS] = { "read", "write" };
+
+struct direction_stats {
+   unsigned long long calls;
+   unsigned long long small_calls;   // small system calls
+   unsigned long long small_bytes;
+   double small_time_ms;
+   long long first_usec;
+   long long last_usec;
+};
+
+struct small_io_stats {
+   int pid;
+   char target[RECORD_TARGET_LEN];   // path, or "[fd N]"
+   char buffering[BUFFERING_LEN];    // "-" for system calls, else stdio buffering
+   struct direction_stats directions[NUM_DIRECTIONS];
+   // back-to-back writes
+   int last_tid;
+   int last_was_write;
+   long long last_end_usec;
+   long long last_end_offset;
+   unsigned long long back_to_back;
+};
+
+struct small_io_entry {
+   struct small_io_stats* stats;
+   int direction;
+   double saved_ms;
+   unsigned long long buffer_bytes;
+};
+
+static FILE* report_output = NULL;
+static struct htable entries;   // (pid, target) -> struct small_io_stats*
+
+//*****************************************************************************
+
+void small_io_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&entries);
+}
+
+//*****************************************************************************
+
+static struct small_io_stats* get_stats(const struct process_info* process,
+                                        const struct monitor_record_t* r)
+{
+   char key[RECORD_TARGET_KEY_LEN];
+   const char* path = record_path(process, r);
+   struct small_io_stats* stats;
+   const size_t key_len = record_target_key(r, path, key);
+
+   stats = htable_get(&entries, key, key_len);
+   if (stats == NULL) {
+      stats = calloc(1, sizeof(struct small_io_stats));
+      stats->pid = r->pid;
+      memcpy(stats->target, key + sizeof(int), key_len - sizeof(int));
+      snprintf(stats->buffering, BUFFERING_LEN, "-");
+      htable_put(&entries, key, key_len, stats);
+   }
+   return stats;
+}
+
+//*****************************************************************************
+
+// stdio calls carry their stream's buffering in s2 ("fwrite buf=line");
+// returns 1 if the call is a system call of its own
+static int is_system_call(const struct monitor_record_t* r, struct small_io_stats* stats)
+{
+   const char* buffering = strstr(r->s2, "buf=");
+
+   if (buffering == NULL) {
+      return 1;
+   }
+   buffering += strlen("buf=");
+   if (strcmp(buffering, "none") && strcmp(buffering, "line")) {
+      return 0;
+   }
+   snprintf(stats->buffering, BUFFERING_LEN, "%s", buffering);
+   return 1;
+}
+
+//*****************************************************************************
+
+void small_io_record(const struct process_info* process,
+                     const struct monitor_record_t* r)
+{
+   struct small_io_stats* stats;
+   struct direction_stats* direction;
+   const long long end_usec = r->start_usec + (long long) (r->elapsed_time * 1000.0);
+   int is_write;
+
+   if (report_output == NULL || r->fd < 0 || r->error_code != 0 ||
+       (r->op_type != READ && r->op_type != WRITE) ||
+       (r->dom_type != FILE_READ && r->dom_type != FILE_WRITE)) {
+      return;
+   }
+
+   is_write = (r->op_type == WRITE);
+   stats = get_stats(process, r);
+   direction = &stats->directions[is_write ? DIRECTION_WRITE : DIRECTION_READ];
+
+   direction->calls++;
+   if (direction->calls == 1) {
+      direction->first_usec = r->start_usec;
+   }
+   direction->last_usec = end_usec;
+
+   if (!is_system_call(r, stats)) {
+      stats->last_was_write = 0;
+      return;
+   }
+
+   if (r->bytes_transferred < SMALL_REQUEST_BYTES) {
+      direction->small_calls++;
+      direction->small_bytes += r->bytes_transferred;
+      direction->small_time_ms += r->elapsed_time;
+   }
+
+   if (is_write && stats->last_was_write && stats->last_tid == r->tid &&
+       r->start_usec - stats->last_end_usec <= COALESCE_GAP_USEC &&
+       (r->offset < 0 || stats->last_end_offset < 0 || r->offset == stats->last_end_offset)) {
+      stats->back_to_back++;
+   }
+   stats->last_was_write = is_write;
+   stats->last_tid = r->tid;
+   stats->last_end_usec = end_usec;
+   stats->last_end_offset = (r->offset >= 0) ? r->offset + (long long) r->bytes_transferred : -1;
+}
+
+//*****************************************************************************
+
+// the small system calls are replaced by one call per buffer of data;
+// each call saved saves the mean time of a small call
+static void estimate_savings(struct small_io_entry* entry)
+{
+   const struct direction_stats* d = &entry->stats->directions[entry->direction];
+   unsigned long long calls_after;
+
+   entry->buffer_bytes = SUGGESTED_BUFFER_BYTES;
+   if (d->small_bytes < SUGGESTED_BUFFER_BYTES) {
+      entry->buffer_bytes = MIN_BUFFER_BYTES;
+      while (entry->buffer_bytes < d->small_bytes) {
+         entry->buffer_bytes *= 2;
+      }
+   }
+
+   calls_after = (d->small_bytes + entry->buffer_bytes - 1) / entry->buffer_bytes;
+   if (calls_after == 0) {
+      calls_after = 1;
+   }
+   entry->saved_ms = (d->small_calls > calls_after) ?
+                     (d->small_calls - calls_after) * d->small_time_ms / d->small_calls : 0.0;
+}
+
+//*****************************************************************************
+
+static void collect_entries(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct small_io_entry** cursor = ctx;
+   struct small_io_stats* stats = value;
+   int d;
+
+   for (d = 0; d < NUM_DIRECTIONS; ++d) {
+      if (stats->directions[d].small_calls >= MIN_SMALL_CALLS) {
+         (*cursor)->stats = stats;
+         (*cursor)->direction = d;
+         estimate_savings(*cursor);
+         (*cursor)++;
+      }
+   }
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+   const struct small_io_entry* ea = a;
+   const struct small_io_entry* eb = b;
+
+   return (ea->saved_ms < eb->saved_ms) - (ea->saved_ms > eb->saved_ms);
+}
+
+//*****************************************************************************
+
+void small_io_report()
+{
+   struct small_io_entry* list;
+   struct small_io_entry* cursor;
+   size_t num_entries;
+   double total_saved_ms = 0.0;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((entries.count * NUM_DIRECTIONS + 1) * sizeof(struct small_io_entry));
+   cursor = list;
+   htable_foreach(&entries, collect_entries, &cursor);
+   num_entries = cursor - list;
+   qsort(list, num_entries, sizeof(struct small_io_entry), compare_entries);
+
+   fprintf(report_output, "\n===== small I/O (system calls below %zu bytes)\n",
+           SMALL_REQUEST_BYTES);
+   fprintf(report_output, "  %7s %-5s %10s %6s %8s %9s %5s %8s %10s %10s %7s  %s\n",
+           "PID", "DIR", "SMALL", "SMALL%", "AVG(B)", "CALLS/S", "STDIO", "B2B",
+           "TIME(ms)", "SAVED(ms)", "BUFFER", "FILE");
+   for (i = 0; i < num_entries; ++i) {
+      const struct small_io_stats* stats = list[i].stats;
+      const struct direction_stats* d = &stats->directions[list[i].direction];
+      double span_secs = (d->last_usec - d->first_usec) / 1e6;
+
+      total_saved_ms += list[i].saved_ms;
+      if (i >= (size_t) TOP_ENTRIES) {
+         continue;
+      }
+      if (span_secs < 0.001) {
+         span_secs = 0.001;
+      }
+      fprintf(report_output,
+              "  %7d %-5s %10llu %5.1f%% %8.1f %9.0f %5s %8llu %10.3f %10.3f %6lluK  %s\n",
+              stats->pid, direction_names[list[i].direction], d->small_calls,
+              100.0 * d->small_calls / d->calls, (double) d->small_bytes / d->small_calls,
+              d->small_calls / span_secs, stats->buffering,
+              list[i].direction == DIRECTION_WRITE ? stats->back_to_back : 0,
+              d->small_time_ms, list[i].saved_ms, list[i].buffer_bytes / 1024,
+              stats->target);
+   }
+   if (num_entries > (size_t) TOP_ENTRIES) {
+      fprintf(report_output, "  ... %zu more\n", num_entries - TOP_ENTRIES);
+   }
+   fprintf(report_output, "  estimated time saved by buffering: %.3f ms\n", total_saved_ms);
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&entries, free);
+}
+
+//*****************************************************************************
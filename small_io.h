@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __SMALL_IO_H
+#define __SMALL_IO_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// finds files and fds with many small reads or writes that each cost a
+// system call (plain read/write, or stdio on unbuffered and line-buffered
+// streams) and back-to-back writes that could have been one writev, and
+// estimates the time that buffering would save.
+
+void small_io_init(FILE* output);
+void small_io_record(const struct process_info* process,
+                     const struct monitor_record_t* monitor_record);
+void small_io_report();
+
+#endif //__SMALL_IO_H
@@ -0,0 +1,449 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// symbolizer.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "htable.h"
+#include "symbolizer.h"
+
+struct symbol {
+   unsigned long address;
+   unsigned long size;
+   const char* name;
+};
+
+struct load_segment {
+   unsigned long file_offset;
+   unsigned long vaddr;
+   unsigned long file_size;
+};
+
+// symbols and loadable segments of one ELF file (shared by all pids)
+struct module {
+   char* path;
+   const char* base_name;
+   struct symbol* symbols;
+   size_t num_symbols;
+   char* names;
+   struct load_segment* segments;
+   size_t num_segments;
+};
+
+struct mapping {
+   unsigned long start;
+   unsigned long end;
+   unsigned long file_offset;
+   struct module* module;
+};
+
+struct process_map {
+   struct mapping* mappings;
+   size_t num_mappings;
+   time_t loaded;             // maps are re-read on a miss at most once a second
+};
+
+static struct htable modules;
+static struct htable process_maps;
+static struct htable failed_pids;   // pid -> 1 if its maps could not be read
+
+//*****************************************************************************
+
+static int compare_symbols(const void* a, const void* b)
+{
+   const struct symbol* sa = a;
+   const struct symbol* sb = b;
+
+   if (sa->address < sb->address) {
+      return -1;
+   }
+   return (sa->address > sb->address) ? 1 : 0;
+}
+
+//*****************************************************************************
+
+static void load_elf(struct module* module, const unsigned char* image, size_t size)
+{
+   const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*) image;
+   const Elf64_Shdr* shdrs;
+   const Elf64_Phdr* phdrs;
+   size_t names_len = 0;
+   size_t names_used = 0;
+   int pass;
+   int i;
+
+   if (size < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+       ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
+      return;
+   }
+   if (ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > size ||
+       ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > size) {
+      return;
+   }
+
+   phdrs = (const Elf64_Phdr*) (image + ehdr->e_phoff);
+   module->segments = calloc(ehdr->e_phnum + 1, sizeof(struct load_segment));
+   for (i = 0; i < ehdr->e_phnum; ++i) {
+      if (phdrs[i].p_type == PT_LOAD) {
+         struct load_segment* seg = &module->segments[module->num_segments++];
+         seg->file_offset = phdrs[i].p_offset;
+         seg->vaddr = phdrs[i].p_vaddr;
+         seg->file_size = phdrs[i].p_filesz;
+      }
+   }
+
+   // gather function symbols from both .symtab (if not stripped) and
+   // .dynsym. first pass sizes the buffers, second pass fills them.
+   shdrs = (const Elf64_Shdr*) (image + ehdr->e_shoff);
+   for (pass = 0; pass < 2; ++pass) {
+      for (i = 0; i < ehdr->e_shnum; ++i) {
+         const Elf64_Shdr* sh = &shdrs[i];
+         const Elf64_Sym* syms;
+         const char* strtab;
+         size_t num_syms;
+         size_t j;
+
+         if ((sh->sh_type != SHT_SYMTAB && sh->sh_type != SHT_DYNSYM) ||
+             sh->sh_link >= ehdr->e_shnum ||
+             sh->sh_offset + sh->sh_size > size ||
+             shdrs[sh->sh_link].sh_offset + shdrs[sh->sh_link].sh_size > size) {
+            continue;
+         }
+
+         syms = (const Elf64_Sym*) (image + sh->sh_offset);
+         num_syms = sh->sh_size / sizeof(Elf64_Sym);
+         strtab = (const char*) (image + shdrs[sh->sh_link].sh_offset);
+
+         for (j = 0; j < num_syms; ++j) {
+            const char* name;
+            size_t len;
+
+            if (ELF64_ST_TYPE(syms[j].st_info) != STT_FUNC ||
+                syms[j].st_shndx == SHN_UNDEF || syms[j].st_value == 0 ||
+                syms[j].st_name >= shdrs[sh->sh_link].sh_size) {
+               continue;
+            }
+            name = strtab + syms[j].st_name;
+            len = strnlen(name, shdrs[sh->sh_link].sh_size - syms[j].st_name) + 1;
+
+            if (pass == 0) {
+               module->num_symbols++;
+               names_len += len;
+            } else {
+               struct symbol* sym = &module->symbols[module->num_symbols++];
+               sym->address = syms[j].st_value;
+               sym->size = syms[j].st_size;
+               memcpy(module->names + names_used, name, len - 1);
+               module->names[names_used + len - 1] = '\0';
+               sym->name = module->names + names_used;
+               names_used += len;
+            }
+         }
+      }
+
+      if (pass == 0) {
+         if (module->num_symbols == 0) {
+            return;
+         }
+         module->symbols = calloc(module->num_symbols, sizeof(struct symbol));
+         module->names = malloc(names_len);
+         if (module->symbols == NULL || module->names == NULL) {
+            free(module->symbols);
+            free(module->names);
+            module->symbols = NULL;
+            module->names = NULL;
+            module->num_symbols = 0;
+            return;
+         }
+         module->num_symbols = 0;
+      }
+   }
+
+   qsort(module->symbols, module->num_symbols, sizeof(struct symbol),
+         compare_symbols);
+}
+
+//*****************************************************************************
+
+static struct module* get_module(const char* path)
+{
+   struct module* module = htable_get_str(&modules, path);
+   struct stat st;
+   void* image;
+   int fd;
+
+   if (module != NULL) {
+      return module;
+   }
+
+   module = calloc(1, sizeof(struct module));
+   module->path = strdup(path);
+   module->base_name = strrchr(module->path, '/');
+   module->base_name = (module->base_name != NULL) ? module->base_name + 1 :
+                                                     module->path;
+
+   fd = open(path, O_RDONLY);
+   if (fd >= 0) {
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+         image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (image != MAP_FAILED) {
+            load_elf(module, image, st.st_size);
+            munmap(image, st.st_size);
+         }
+      }
+      close(fd);
+   }
+
+   htable_put_str(&modules, path, module);
+   return module;
+}
+
+//*****************************************************************************
+
+static void free_module(void* value)
+{
+   struct module* module = value;
+
+   free(module->path);
+   free(module->symbols);
+   free(module->names);
+   free(module->segments);
+   free(module);
+}
+
+//*****************************************************************************
+
+static void free_process_map(void* value)
+{
+   struct process_map* map = value;
+
+   free(map->mappings);
+   free(map);
+}
+
+//*****************************************************************************
+
+void symbolizer_init()
+{
+   htable_init(&modules);
+   htable_init(&process_maps);
+   htable_init(&failed_pids);
+}
+
+//*****************************************************************************
+
+void symbolizer_fini()
+{
+   htable_destroy(&process_maps, free_process_map);
+   htable_destroy(&failed_pids, NULL);
+   htable_destroy(&modules, free_module);
+}
+
+//*****************************************************************************
+
+static struct process_map* load_failed(int pid)
+{
+   if (htable_get_int(&failed_pids, pid) == NULL) {
+      htable_put_int(&failed_pids, pid, (void*) 1);
+   }
+   return htable_get_int(&process_maps, pid);
+}
+
+//*****************************************************************************
+
+// the map of pid, re-read. if /proc/<pid>/maps cannot be read, or is empty
+// because the process is exiting, pid is remembered so that symbolize does
+// not try again, and the map read before (if any) is kept.
+static struct process_map* load_maps(int pid)
+{
+   char maps_path[64];
+   char line[PATH_MAX + 128];
+   struct process_map* map;
+   size_t capacity = 0;
+   FILE* maps;
+
+   snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid);
+   maps = fopen(maps_path, "r");
+   if (maps == NULL) {
+      return load_failed(pid);
+   }
+
+   map = calloc(1, sizeof(struct process_map));
+   map->loaded = time(NULL);
+
+   while (fgets(line, sizeof(line), maps) != NULL) {
+      unsigned long start;
+      unsigned long end;
+      unsigned long offset;
+      char perms[8];
+      int path_pos = 0;
+      char* path;
+
+      if (sscanf(line, "%lx-%lx %7s %lx %*s %*s %n",
+                 &start, &end, perms, &offset, &path_pos) < 4 ||
+          perms[2] != 'x' || path_pos == 0) {
+         continue;
+      }
+      path = line + path_pos;
+      path[strcspn(path, "\n")] = '\0';
+      if (path[0] != '/') {
+         // anonymous, [vdso], [stack], etc.
+         continue;
+      }
+
+      if (map->num_mappings == capacity) {
+         capacity = capacity ? capacity * 2 : 16;
+         map->mappings = realloc(map->mappings, capacity * sizeof(struct mapping));
+      }
+      map->mappings[map->num_mappings].start = start;
+      map->mappings[map->num_mappings].end = end;
+      map->mappings[map->num_mappings].file_offset = offset;
+      map->mappings[map->num_mappings].module = get_module(path);
+      map->num_mappings++;
+   }
+   fclose(maps);
+
+   if (map->num_mappings == 0) {
+      free_process_map(map);
+      return load_failed(pid);
+   }
+   symbolizer_forget_pid(pid);
+   htable_put_int(&process_maps, pid, map);
+   return map;
+}
+
+//*****************************************************************************
+
+void symbolizer_load_pid(int pid)
+{
+   load_maps(pid);
+}
+
+//*****************************************************************************
+
+void symbolizer_forget_pid(int pid)
+{
+   struct process_map* map = htable_remove_int(&process_maps, pid);
+
+   if (map != NULL) {
+      free_process_map(map);
+   }
+   htable_remove_int(&failed_pids, pid);
+}
+
+//*****************************************************************************
+
+static const struct symbol* find_symbol(const struct module* module,
+                                        unsigned long vaddr)
+{
+   size_t lo = 0;
+   size_t hi = module->num_symbols;
+
+   // find last symbol with address <= vaddr
+   while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (module->symbols[mid].address <= vaddr) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   if (lo == 0) {
+      return NULL;
+   }
+
+   const struct symbol* sym = &module->symbols[lo - 1];
+   if (sym->size != 0 && vaddr >= sym->address + sym->size) {
+      return NULL;
+   }
+   return sym;
+}
+
+//*****************************************************************************
+
+static const struct mapping* find_mapping(const struct process_map* map,
+                                          unsigned long address)
+{
+   size_t i;
+
+   if (map == NULL) {
+      return NULL;
+   }
+   for (i = 0; i < map->num_mappings; ++i) {
+      if (address >= map->mappings[i].start && address < map->mappings[i].end) {
+         return &map->mappings[i];
+      }
+   }
+   return NULL;
+}
+
+//*****************************************************************************
+
+void symbolize(int pid, unsigned long address, char* out, size_t out_len)
+{
+   struct process_map* map = htable_get_int(&process_maps, pid);
+   const int failed = htable_get_int(&failed_pids, pid) != NULL;
+   const struct mapping* mapping;
+   const struct symbol* sym = NULL;
+   unsigned long file_offset;
+   size_t i;
+
+   if (map == NULL && !failed) {
+      // process may have been forked without a START of its own
+      map = load_maps(pid);
+   }
+
+   mapping = find_mapping(map, address);
+   if (mapping == NULL && map != NULL && !failed && map->loaded != time(NULL)) {
+      // mapped since START (dlopen)
+      map = load_maps(pid);
+      mapping = find_mapping(map, address);
+   }
+
+   if (mapping == NULL) {
+      snprintf(out, out_len, "[unknown]");
+      return;
+   }
+
+   file_offset = mapping->file_offset + (address - mapping->start);
+   for (i = 0; i < mapping->module->num_segments; ++i) {
+      const struct load_segment* seg = &mapping->module->segments[i];
+      if (file_offset >= seg->file_offset &&
+          file_offset < seg->file_offset + seg->file_size) {
+         sym = find_symbol(mapping->module,
+                           seg->vaddr + (file_offset - seg->file_offset));
+         break;
+      }
+   }
+
+   if (sym != NULL) {
+      snprintf(out, out_len, "%s", sym->name);
+   } else {
+      snprintf(out, out_len, "%s+0x%lx", mapping->module->base_name, file_offset);
+   }
+}
+
+//*****************************************************************************
@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __SYMBOLIZER_H
+#define __SYMBOLIZER_H
+#include <stddef.h>
+
+// resolves code addresses captured by the shim into function names.
+// this runs in the listener (off the hot path of the monitored process)
+// using /proc/<pid>/maps and the ELF symbol tables of mapped modules.
+
+void symbolizer_init();
+void symbolizer_fini();
+
+// (re)read the memory map of a process. should be called as early as
+// possible (e.g., on START) since the process may exit at any time.
+// symbolize re-reads it when an address is outside all mappings.
+void symbolizer_load_pid(int pid);
+void symbolizer_forget_pid(int pid);
+
+// writes "function", "module+0xoffset" or "[unknown]" into out
+void symbolize(int pid, unsigned long address, char* out, size_t out_len);
+
+#endif //__SYMBOLIZER_H
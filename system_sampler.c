@@ -0,0 +1,680 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// system_sampler.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "mounts.h"
+#include "system_sampler.h"
+
+static const char* DISKSTATS_PATH = "/proc/diskstats";
+static const char* PRESSURE_IO_PATH = "/proc/pressure/io";
+static const char* MEMINFO_PATH = "/proc/meminfo";
+
+// calls at least this slow are the ones to explain
+static const double SLOW_CALL_MS = 10.0;
+// a device busy this share of a second is saturated
+static const double SATURATED_UTIL = 0.9;
+// share of a second in which some task stalled on I/O
+static const double PRESSURE_STALL = 0.1;
+// records arrive when calls end; a second is evaluated this much later
+static const time_t EVALUATION_LAG_SECS = 2;
+
+static const int TOP_DEVICES = 10;
+
+// ring of the latest seconds, application calls and host samples
+#define NUM_SECONDS 16
+// devices whose slow calls are told apart within a second
+#define MAX_SLOW_DEVICES 8
+
+enum { CAUSE_DEVICE, CAUSE_PRESSURE, CAUSE_WRITEBACK, CAUSE_NONE, NUM_CAUSES };
+static const char* cause_names[NUM_CAUSES] = {
+   "device saturated", "I/O pressure stall", "writeback throttling", "none of these"
+};
+
+struct slow_device {
+   unsigned long dev;         // st_dev of the files
+   unsigned long long slow_calls;
+};
+
+struct second_stats {
+   time_t second;
+   // file reads, writes and syncs that ended in the second
+   unsigned long long calls;
+   unsigned long long slow_calls;
+   double ms;
+   // slow calls by device; calls on other or unknown devices are only in
+   // slow_calls
+   struct slow_device slow_devices[MAX_SLOW_DEVICES];
+   int num_slow_devices;
+   // host sample covering the second
+   int sampled;
+   double max_util;           // of whole disks, not partitions
+   char busiest[32];
+   double psi_some;           // share of the interval, -1 if unavailable
+   double psi_full;
+   long long dirty_kb;
+   long long writeback_kb;
+   int throttling;
+};
+
+struct disk_stats {
+   char name[32];
+   unsigned long dev;
+   unsigned long parent_dev;         // disk of a partition, 0 for a disk
+   // utilization of the latest seconds
+   time_t util_seconds[NUM_SECONDS];
+   double util[NUM_SECONDS];
+   // counters at the previous sample
+   unsigned long long sectors_read;
+   unsigned long long sectors_written;
+   unsigned long long io_ticks;      // msec with I/O in flight
+   // totals over the run
+   unsigned long long samples;
+   double util_sum;
+   unsigned long long saturated_secs;
+   unsigned long long bytes_read;
+   unsigned long long bytes_written;
+};
+
+static FILE* report_output = NULL;
+static FILE* series = NULL;
+static struct second_stats seconds[NUM_SECONDS];
+static struct htable disks;           // dev -> struct disk_stats*
+static struct htable fds;             // (pid, fd) -> st_dev recorded at open
+static time_t last_sample = 0;
+static time_t last_evaluated = 0;
+static unsigned long long psi_some_usec = 0;
+static unsigned long long psi_full_usec = 0;
+static int have_psi = 0;
+
+// totals over the evaluated seconds
+static unsigned long long evaluated_secs = 0;
+static unsigned long long slow_secs = 0;
+static unsigned long long total_calls = 0;
+static unsigned long long total_slow_calls = 0;
+static unsigned long long cause_secs[NUM_CAUSES];
+static unsigned long long cause_slow_calls[NUM_CAUSES];
+static unsigned long long system_secs[NUM_CAUSES];   // regardless of the application
+static double max_psi_some = 0.0;
+static double max_psi_full = 0.0;
+static long long max_dirty_kb = 0;
+static long long max_writeback_kb = 0;
+
+//*****************************************************************************
+
+int system_sampler_init(FILE* output, const char* series_path)
+{
+   report_output = output;
+   htable_init(&disks);
+   htable_init(&fds);
+   if (series_path != NULL) {
+      series = fopen(series_path, "w");
+      if (series == NULL) {
+         printf("error: unable to write system samples to '%s'\n", series_path);
+         return -1;
+      }
+      fprintf(series, "second,calls,slow_calls,call_ms,busiest_device,util_pct,"
+                      "psi_some_pct,psi_full_pct,dirty_kb,writeback_kb,throttling\n");
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+// slot of the given second, reset if it held an older one; NULL if the
+// second is too old to be kept
+static struct second_stats* get_second(time_t second)
+{
+   struct second_stats* s = &seconds[second % NUM_SECONDS];
+
+   if (s->second != second) {
+      if (s->second > second) {
+         return NULL;
+      }
+      memset(s, 0, sizeof(struct second_stats));
+      s->second = second;
+      s->psi_some = -1.0;
+      s->psi_full = -1.0;
+   }
+   return s;
+}
+
+//*****************************************************************************
+
+static long fd_key(const struct monitor_record_t* r)
+{
+   return ((long) r->pid << 32) | (unsigned int) r->fd;
+}
+
+//*****************************************************************************
+
+// device of the file a call was made on (st_dev from the open, with
+// STAT_ON_OPEN, else the mount holding its path), 0 if unknown
+static unsigned long call_device(const struct process_info* process,
+                                 const struct monitor_record_t* r)
+{
+   const struct mount_info* mount;
+   unsigned long dev;
+
+   if (r->fd < 0) {
+      return 0;
+   }
+   dev = (unsigned long) (uintptr_t) htable_get_int(&fds, fd_key(r));
+   if (dev != 0) {
+      return dev;
+   }
+   mount = mounts_find(record_path(process, r));
+   return mount != NULL ? mount->dev : 0;
+}
+
+//*****************************************************************************
+
+static void add_slow_call(struct second_stats* s, unsigned long dev)
+{
+   int i;
+
+   s->slow_calls++;
+   if (dev == 0) {
+      return;
+   }
+   for (i = 0; i < s->num_slow_devices; ++i) {
+      if (s->slow_devices[i].dev == dev) {
+         s->slow_devices[i].slow_calls++;
+         return;
+      }
+   }
+   if (s->num_slow_devices < MAX_SLOW_DEVICES) {
+      s->slow_devices[s->num_slow_devices].dev = dev;
+      s->slow_devices[s->num_slow_devices].slow_calls = 1;
+      s->num_slow_devices++;
+   }
+}
+
+//*****************************************************************************
+
+void system_sampler_record(const struct process_info* process,
+                           const struct monitor_record_t* r)
+{
+   struct second_stats* s;
+   time_t end_second;
+
+   if (report_output == NULL && series == NULL) {
+      return;
+   }
+   if (r->dom_type == FILE_OPEN_CLOSE && r->fd >= 0) {
+      if (r->op_type == OPEN) {
+         htable_remove_int(&fds, fd_key(r));
+         if (r->error_code == 0 && r->dev != 0) {
+            htable_put_int(&fds, fd_key(r), (void*) (uintptr_t) r->dev);
+         }
+      } else if (r->op_type == CLOSE) {
+         htable_remove_int(&fds, fd_key(r));
+      }
+      return;
+   }
+   if (!(r->dom_type == FILE_READ && r->op_type == READ && r->fd >= 0) &&
+       !(r->dom_type == FILE_WRITE && r->op_type == WRITE && r->fd >= 0) &&
+       !(r->dom_type == SYNCS && (r->op_type == SYNC || r->op_type == FLUSH))) {
+      return;
+   }
+   // pipes and sockets have no known path
+   if (r->fd >= 0 && record_path(process, r) == NULL) {
+      return;
+   }
+
+   end_second = (time_t) ((r->start_usec + (long long) (r->elapsed_time * 1000.0)) / 1000000);
+   if (end_second <= last_evaluated) {
+      return;
+   }
+   s = get_second(end_second);
+   if (s == NULL) {
+      return;
+   }
+   s->calls++;
+   s->ms += r->elapsed_time;
+   if (r->elapsed_time >= SLOW_CALL_MS) {
+      add_slow_call(s, call_device(process, r));
+   }
+}
+
+//*****************************************************************************
+
+// the disk holding a partition (from sysfs), 0 if dev is not a partition
+static unsigned long parent_disk(unsigned int major_id, unsigned int minor_id)
+{
+   char path[64];
+   char real_path[PATH_MAX];
+   char dev_path[PATH_MAX + 8];
+   unsigned int parent_major;
+   unsigned int parent_minor;
+   char* slash;
+   FILE* file;
+   int found;
+
+   snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/partition", major_id, minor_id);
+   if (access(path, F_OK) != 0) {
+      return 0;
+   }
+   // the partition's directory is inside that of its disk
+   snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", major_id, minor_id);
+   if (realpath(path, real_path) == NULL || (slash = strrchr(real_path, '/')) == NULL) {
+      return 0;
+   }
+   *slash = '\0';
+   snprintf(dev_path, sizeof(dev_path), "%s/dev", real_path);
+   file = fopen(dev_path, "r");
+   if (file == NULL) {
+      return 0;
+   }
+   found = (fscanf(file, "%u:%u", &parent_major, &parent_minor) == 2);
+   fclose(file);
+   return found ? makedev(parent_major, parent_minor) : 0;
+}
+
+//*****************************************************************************
+
+// utilization of a device in the given second, -1 if not sampled
+static double disk_util(unsigned long dev, time_t second)
+{
+   const struct disk_stats* disk = htable_get_int(&disks, dev);
+   const int slot = second % NUM_SECONDS;
+
+   if (disk == NULL || disk->util_seconds[slot] != second) {
+      return -1.0;
+   }
+   return disk->util[slot];
+}
+
+// whether the device of a filesystem, or the disk it is a partition of,
+// was saturated in the given second
+static int device_saturated(unsigned long dev, time_t second)
+{
+   const struct disk_stats* disk = htable_get_int(&disks, dev);
+
+   if (disk == NULL) {
+      return 0;   // not a block device (tmpfs, nfs) or not sampled
+   }
+   if (disk_util(dev, second) >= SATURATED_UTIL) {
+      return 1;
+   }
+   return disk->parent_dev != 0 && disk_util(disk->parent_dev, second) >= SATURATED_UTIL;
+}
+
+//*****************************************************************************
+
+static void sample_disks(struct second_stats* s, time_t interval)
+{
+   char line[512];
+   char name[32];
+   unsigned int major_id;
+   unsigned int minor_id;
+   unsigned long dev;
+   unsigned long long v[11];
+   struct disk_stats* disk;
+   FILE* file;
+   double util;
+   int slot;
+
+   file = fopen(DISKSTATS_PATH, "r");
+   if (file == NULL) {
+      return;
+   }
+   while (fgets(line, sizeof(line), file) != NULL) {
+      if (sscanf(line, "%u %u %31s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                 &major_id, &minor_id, name, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+                 &v[6], &v[7], &v[8], &v[9], &v[10]) != 14) {
+         continue;
+      }
+      // fields: reads, merged, sectors read, ms reading, writes, merged,
+      // sectors written, ms writing, in flight, io ticks, weighted ms
+      dev = makedev(major_id, minor_id);
+      disk = htable_get_int(&disks, dev);
+      if (disk == NULL) {
+         disk = calloc(1, sizeof(struct disk_stats));
+         snprintf(disk->name, sizeof(disk->name), "%s", name);
+         disk->dev = dev;
+         disk->parent_dev = parent_disk(major_id, minor_id);
+         htable_put_int(&disks, dev, disk);
+      } else if (interval > 0) {
+         util = (v[9] - disk->io_ticks) / (interval * 1000.0);
+         if (util > 1.0) {
+            util = 1.0;
+         }
+         disk->samples++;
+         disk->util_sum += util;
+         if (util >= SATURATED_UTIL) {
+            disk->saturated_secs++;
+         }
+         disk->bytes_read += (v[2] - disk->sectors_read) * 512;
+         disk->bytes_written += (v[6] - disk->sectors_written) * 512;
+         slot = s->second % NUM_SECONDS;
+         disk->util_seconds[slot] = s->second;
+         disk->util[slot] = util;
+         // a partition's I/O is also counted by its disk
+         if (disk->parent_dev == 0 && util > s->max_util) {
+            s->max_util = util;
+            snprintf(s->busiest, sizeof(s->busiest), "%s", name);
+         }
+      }
+      disk->sectors_read = v[2];
+      disk->sectors_written = v[6];
+      disk->io_ticks = v[9];
+   }
+   fclose(file);
+}
+
+//*****************************************************************************
+
+static void sample_pressure(struct second_stats* s, time_t interval)
+{
+   char line[256];
+   char kind[8];
+   unsigned long long total;
+   FILE* file;
+
+   file = fopen(PRESSURE_IO_PATH, "r");
+   if (file == NULL) {
+      return;
+   }
+   while (fgets(line, sizeof(line), file) != NULL) {
+      const char* total_text = strstr(line, "total=");
+
+      if (sscanf(line, "%7s", kind) != 1 || total_text == NULL) {
+         continue;
+      }
+      total = strtoull(total_text + 6, NULL, 10);
+      if (!strcmp(kind, "some")) {
+         if (have_psi && interval > 0) {
+            s->psi_some = (total - psi_some_usec) / (interval * 1000000.0);
+         }
+         psi_some_usec = total;
+      } else if (!strcmp(kind, "full")) {
+         if (have_psi && interval > 0) {
+            s->psi_full = (total - psi_full_usec) / (interval * 1000000.0);
+         }
+         psi_full_usec = total;
+      }
+   }
+   fclose(file);
+   have_psi = 1;
+}
+
+//*****************************************************************************
+
+static long long read_vm_setting(const char* name)
+{
+   char path[64];
+   long long value = 0;
+   FILE* file;
+
+   snprintf(path, sizeof(path), "/proc/sys/vm/%s", name);
+   file = fopen(path, "r");
+   if (file != NULL) {
+      if (fscanf(file, "%lld", &value) != 1) {
+         value = 0;
+      }
+      fclose(file);
+   }
+   return value;
+}
+
+//*****************************************************************************
+
+// the kernel starts throttling writers when dirty and writeback pages pass
+// the midpoint between the background and the dirty threshold (both
+// relative to the memory that can hold dirty pages)
+static void sample_memory(struct second_stats* s)
+{
+   char line[256];
+   char key[64];
+   long long value;
+   long long dirtyable_kb = 0;
+   long long background_kb;
+   long long limit_kb;
+   long long bytes;
+   FILE* file;
+
+   file = fopen(MEMINFO_PATH, "r");
+   if (file == NULL) {
+      return;
+   }
+   while (fgets(line, sizeof(line), file) != NULL) {
+      if (sscanf(line, "%63[^:]: %lld", key, &value) != 2) {
+         continue;
+      }
+      if (!strcmp(key, "Dirty")) {
+         s->dirty_kb = value;
+      } else if (!strcmp(key, "Writeback")) {
+         s->writeback_kb = value;
+      } else if (!strcmp(key, "MemFree") || !strcmp(key, "Active(file)") ||
+                 !strcmp(key, "Inactive(file)")) {
+         dirtyable_kb += value;
+      }
+   }
+   fclose(file);
+
+   bytes = read_vm_setting("dirty_background_bytes");
+   background_kb = bytes > 0 ? bytes / 1024 :
+                   dirtyable_kb * read_vm_setting("dirty_background_ratio") / 100;
+   bytes = read_vm_setting("dirty_bytes");
+   limit_kb = bytes > 0 ? bytes / 1024 : dirtyable_kb * read_vm_setting("dirty_ratio") / 100;
+   s->throttling = limit_kb > 0 &&
+                   s->dirty_kb + s->writeback_kb > (background_kb + limit_kb) / 2;
+}
+
+//*****************************************************************************
+
+static void evaluate(const struct second_stats* s)
+{
+   // host-wide conditions. a saturated disk only explains the slow calls
+   // on its own filesystems.
+   const int causes[NUM_CAUSES - 1] = {
+      s->max_util >= SATURATED_UTIL,
+      s->psi_some >= PRESSURE_STALL,
+      s->throttling
+   };
+   const int system_wide = causes[CAUSE_PRESSURE] || causes[CAUSE_WRITEBACK];
+   unsigned long long device_slow_calls = 0;
+   int i;
+
+   evaluated_secs++;
+   total_calls += s->calls;
+   total_slow_calls += s->slow_calls;
+   if (s->psi_some > max_psi_some) {
+      max_psi_some = s->psi_some;
+   }
+   if (s->psi_full > max_psi_full) {
+      max_psi_full = s->psi_full;
+   }
+   if (s->dirty_kb > max_dirty_kb) {
+      max_dirty_kb = s->dirty_kb;
+   }
+   if (s->writeback_kb > max_writeback_kb) {
+      max_writeback_kb = s->writeback_kb;
+   }
+
+   for (i = 0; i < s->num_slow_devices; ++i) {
+      if (device_saturated(s->slow_devices[i].dev, s->second)) {
+         device_slow_calls += s->slow_devices[i].slow_calls;
+      }
+   }
+   if (device_slow_calls > 0) {
+      cause_secs[CAUSE_DEVICE]++;
+      cause_slow_calls[CAUSE_DEVICE] += device_slow_calls;
+   }
+   for (i = 0; i < NUM_CAUSES - 1; ++i) {
+      if (causes[i]) {
+         system_secs[i]++;
+         if (i != CAUSE_DEVICE && s->slow_calls > 0) {
+            cause_secs[i]++;
+            cause_slow_calls[i] += s->slow_calls;
+         }
+      }
+   }
+   if (s->slow_calls > 0) {
+      slow_secs++;
+      if (!system_wide && s->slow_calls > device_slow_calls) {
+         cause_secs[CAUSE_NONE]++;
+         cause_slow_calls[CAUSE_NONE] += s->slow_calls - device_slow_calls;
+      }
+   }
+
+   if (series != NULL) {
+      fprintf(series, "%ld,%llu,%llu,%.3f,%s,%.1f,", (long) s->second, s->calls,
+              s->slow_calls, s->ms, s->busiest, 100.0 * s->max_util);
+      if (s->psi_some >= 0.0) {
+         fprintf(series, "%.1f,%.1f", 100.0 * s->psi_some, 100.0 * s->psi_full);
+      } else {
+         fprintf(series, ",");
+      }
+      fprintf(series, ",%lld,%lld,%d\n", s->dirty_kb, s->writeback_kb, s->throttling);
+   }
+}
+
+//*****************************************************************************
+
+void system_sampler_tick(time_t now)
+{
+   struct second_stats* s;
+   time_t second;
+
+   if ((report_output == NULL && series == NULL) || now <= last_sample) {
+      return;
+   }
+
+   s = get_second(now);
+   if (s != NULL) {
+      sample_disks(s, last_sample > 0 ? now - last_sample : 0);
+      sample_pressure(s, last_sample > 0 ? now - last_sample : 0);
+      sample_memory(s);
+      // the first sample only sets the baseline of the counters
+      s->sampled = (last_sample > 0);
+   }
+   if (last_evaluated == 0) {
+      last_evaluated = now;
+   }
+   last_sample = now;
+
+   for (second = last_evaluated + 1; second <= now - EVALUATION_LAG_SECS; ++second) {
+      s = &seconds[second % NUM_SECONDS];
+      if (s->second == second && s->sampled) {
+         evaluate(s);
+      }
+      last_evaluated = second;
+   }
+   if (series != NULL) {
+      fflush(series);
+   }
+}
+
+//*****************************************************************************
+
+static void collect_disk(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct disk_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_disks(const void* a, const void* b)
+{
+   const struct disk_stats* da = *(struct disk_stats* const*) a;
+   const struct disk_stats* db = *(struct disk_stats* const*) b;
+
+   return (da->util_sum < db->util_sum) - (da->util_sum > db->util_sum);
+}
+
+//*****************************************************************************
+
+void system_sampler_report()
+{
+   struct disk_stats** list;
+   struct disk_stats** end;
+   size_t count;
+   size_t printed;
+   size_t i;
+
+   if (report_output == NULL && series == NULL) {
+      return;
+   }
+
+   if (report_output != NULL) {
+      fprintf(report_output, "\n===== system correlation: %llu seconds sampled, "
+              "%llu file I/O calls, %llu at least %.0f ms in %llu seconds\n",
+              evaluated_secs, total_calls, total_slow_calls, SLOW_CALL_MS, slow_secs);
+      fprintf(report_output, "  %-22s %10s %12s %12s %12s\n",
+              "CONDITION", "SECONDS", "SLOW SECS", "SLOW CALLS", "SLOW CALLS%");
+      // SECONDS: the host was in the condition, slow calls or not. a
+      // second can be in more than one condition.
+      for (i = 0; i < NUM_CAUSES; ++i) {
+         char secs[24];
+
+         snprintf(secs, sizeof(secs), i < CAUSE_NONE ? "%llu" : "-", system_secs[i]);
+         fprintf(report_output, "  %-22s %10s %12llu %12llu %12.1f\n", cause_names[i],
+                 secs, cause_secs[i], cause_slow_calls[i],
+                 total_slow_calls > 0 ? 100.0 * cause_slow_calls[i] / total_slow_calls : 0.0);
+      }
+      fprintf(report_output, "  peak I/O pressure: some %.1f%% full %.1f%%%s\n",
+              100.0 * max_psi_some, 100.0 * max_psi_full,
+              have_psi ? "" : " (no /proc/pressure/io)");
+      fprintf(report_output, "  peak Dirty %lld KiB, Writeback %lld KiB\n",
+              max_dirty_kb, max_writeback_kb);
+
+      list = malloc((disks.count + 1) * sizeof(struct disk_stats*));
+      end = list;
+      htable_foreach(&disks, collect_disk, &end);
+      count = end - list;
+      qsort(list, count, sizeof(struct disk_stats*), compare_disks);
+      fprintf(report_output, "  %-16s %8s %10s %14s %14s\n",
+              "DEVICE", "UTIL%", "SAT SECS", "READ(B)", "WRITTEN(B)");
+      // whole disks only; their counters include their partitions
+      for (i = 0, printed = 0; i < count && printed < (size_t) TOP_DEVICES; ++i) {
+         const struct disk_stats* d = list[i];
+
+         if (d->bytes_read == 0 && d->bytes_written == 0 && d->util_sum == 0.0) {
+            break;
+         }
+         if (d->parent_dev != 0) {
+            continue;
+         }
+         fprintf(report_output, "  %-16s %8.1f %10llu %14llu %14llu\n", d->name,
+                 d->samples > 0 ? 100.0 * d->util_sum / d->samples : 0.0,
+                 d->saturated_secs, d->bytes_read, d->bytes_written);
+         printed++;
+      }
+      free(list);
+      fflush(report_output);
+   }
+   if (series != NULL) {
+      fclose(series);
+      series = NULL;
+   }
+   htable_destroy(&disks, free);
+   htable_destroy(&fds, NULL);
+}
+
+//*****************************************************************************
@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __SYSTEM_SAMPLER_H
+#define __SYSTEM_SAMPLER_H
+#include <stdio.h>
+#include <time.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// samples the state of the host every second (/proc/diskstats,
+// /proc/pressure/io, /proc/meminfo) and lines it up with the file I/O calls
+// that ended in the same second, to tell whether slow calls coincide with a
+// saturated device, I/O pressure stalls or writeback throttling. needs no
+// privileges; the listener must run on the same host.
+
+// returns -1 if the series file cannot be created
+int system_sampler_init(FILE* output, const char* series_path);
+void system_sampler_record(const struct process_info* process,
+                           const struct monitor_record_t* monitor_record);
+void system_sampler_tick(time_t now);
+void system_sampler_report();
+
+#endif //__SYSTEM_SAMPLER_H
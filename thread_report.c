@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// thread_report.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "domains.h"
+#include "ops.h"
+#include "htable.h"
+#include "histogram.h"
+#include "thread_report.h"
+
+#define POOL_NAME_LEN 32
+
+struct pool_stats {
+   char name[POOL_NAME_LEN];
+   unsigned long long threads;
+   unsigned long long bytes;
+   struct histogram latency_usec;
+};
+
+struct thread_key {
+   int pid;
+   int tid;
+   char pool[POOL_NAME_LEN];
+};
+
+static FILE* report_output = NULL;
+static struct htable pools;         // pool name -> struct pool_stats*
+static struct htable seen_threads;  // struct thread_key -> (marker)
+
+//*****************************************************************************
+
+void thread_report_init(FILE* output)
+{
+   report_output = output;
+   htable_init(&pools);
+   htable_init(&seen_threads);
+}
+
+//*****************************************************************************
+
+void thread_pool_name(const char* thread_name, char* out, size_t out_len)
+{
+   size_t len;
+
+   snprintf(out, out_len, "%s", thread_name);
+   len = strlen(out);
+   while (len > 0 && isdigit((unsigned char) out[len - 1])) {
+      len--;
+   }
+   while (len > 0 && strchr("-_:.# ", out[len - 1]) != NULL) {
+      len--;
+   }
+   // names that are all digits stay as they are
+   if (len > 0) {
+      out[len] = '\0';
+   }
+}
+
+//*****************************************************************************
+
+void thread_report_record(const struct process_info* process,
+                          const struct monitor_record_t* r)
+{
+   struct thread_key key;
+   struct pool_stats* pool;
+   const char* name;
+
+   if (report_output == NULL || r->dom_type == START_STOP) {
+      return;
+   }
+
+   memset(&key, 0, sizeof(key));
+   key.pid = r->pid;
+   key.tid = r->tid;
+
+   // threads without a THREAD_START: the main thread, and threads started
+   // before the monitor was loaded or without pthread_create
+   name = process_thread_name(process, r->tid);
+   if (name != NULL) {
+      thread_pool_name(name, key.pool, POOL_NAME_LEN);
+   } else {
+      snprintf(key.pool, POOL_NAME_LEN, "%s", (r->tid == r->pid) ? "[main]" : "[unnamed]");
+   }
+
+   pool = htable_get_str(&pools, key.pool);
+   if (pool == NULL) {
+      pool = calloc(1, sizeof(struct pool_stats));
+      memcpy(pool->name, key.pool, POOL_NAME_LEN);
+      htable_put_str(&pools, key.pool, pool);
+   }
+
+   if (htable_get(&seen_threads, &key, sizeof(key)) == NULL) {
+      htable_put(&seen_threads, &key, sizeof(key), pool);
+      pool->threads++;
+   }
+
+   pool->bytes += r->bytes_transferred;
+   histogram_add(&pool->latency_usec, r->elapsed_time * 1000.0);
+}
+
+//*****************************************************************************
+
+static void collect_pool(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct pool_stats*** cursor = ctx;
+
+   *(*cursor)++ = value;
+}
+
+static int compare_pools(const void* a, const void* b)
+{
+   const struct pool_stats* pa = *(struct pool_stats* const*) a;
+   const struct pool_stats* pb = *(struct pool_stats* const*) b;
+
+   return (pa->latency_usec.sum < pb->latency_usec.sum) -
+          (pa->latency_usec.sum > pb->latency_usec.sum);
+}
+
+//*****************************************************************************
+
+void thread_report_report()
+{
+   struct pool_stats** list;
+   struct pool_stats** cursor;
+   size_t i;
+
+   if (report_output == NULL) {
+      return;
+   }
+
+   list = malloc((pools.count + 1) * sizeof(struct pool_stats*));
+   cursor = list;
+   htable_foreach(&pools, collect_pool, &cursor);
+   qsort(list, pools.count, sizeof(struct pool_stats*), compare_pools);
+
+   fprintf(report_output, "\n===== I/O by thread pool\n");
+   fprintf(report_output, "  %-32s %8s %10s %14s %12s %10s %10s %10s\n",
+           "POOL", "THREADS", "OPS", "BYTES", "TIME(ms)", "AVG(ms)", "P99(ms)", "MAX(ms)");
+   for (i = 0; i < pools.count; ++i) {
+      const struct histogram* h = &list[i]->latency_usec;
+      fprintf(report_output, "  %-32s %8llu %10llu %14llu %12.3f %10.4f %10.4f %10.4f\n",
+              list[i]->name, list[i]->threads, h->count, list[i]->bytes,
+              h->sum / 1000.0, h->sum / h->count / 1000.0,
+              histogram_percentile(h, 99.0) / 1000.0, h->max / 1000.0);
+   }
+   fflush(report_output);
+
+   free(list);
+   htable_destroy(&seen_threads, NULL);
+   htable_destroy(&pools, free);
+}
+
+//*****************************************************************************
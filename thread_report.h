@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __THREAD_REPORT_H
+#define __THREAD_REPORT_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// aggregates I/O per thread pool: threads are named by THREAD_START and
+// numbered members of a pool ("rocksdb:bg0", "rocksdb:bg1") are counted
+// together, to localize I/O contention inside large services.
+
+void thread_report_init(FILE* output);
+void thread_report_record(const struct process_info* process,
+                          const struct monitor_record_t* monitor_record);
+void thread_report_report();
+
+// pool of a thread name: the name without its trailing number and
+// separator (e.g., "http-worker-3" -> "http-worker")
+void thread_pool_name(const char* thread_name, char* out, size_t out_len);
+
+#endif //__THREAD_REPORT_H
@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// working_set.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "domains.h"
+#include "htable.h"
+#include "histogram.h"
+#include "working_set.h"
+
+static const long long BLOCK_SIZE = 4096;
+static const long long WINDOW_SECS = 10;
+static const long long HEATMAP_REGION_SIZE = 1024 * 1024;
+static const int TOP_FILES = 10;
+// unique and re-read blocks are tracked up to MAX_BLOCKS (16 GiB) per file;
+// accesses past it only count as reads and writes
+static const long long MAX_BLOCKS = 1LL << 22;
+
+struct heat_key {
+   long long window;
+   long long region;
+};
+
+struct heat_cell {
+   unsigned long long reads;          // block accesses
+   unsigned long long writes;
+   unsigned long long unique_blocks;  // first access of a block in the window
+};
+
+struct file_map {
+   char* path;
+   int* last_window;           // block -> window it was last touched in + 1, 0 if never
+   unsigned char* read_bits;   // block -> read at least once
+   long long num_blocks;       // capacity of both
+   unsigned long long unique_blocks;
+   struct htable cells;        // struct heat_key -> struct heat_cell*
+   unsigned long long block_reads;
+   unsigned long long block_rereads;
+   unsigned long long block_writes;
+   unsigned long long peak_window_blocks;   // filled in by the report
+};
+
+struct window_totals {
+   long long window;
+   unsigned long long unique_blocks;
+   unsigned long long reads;
+   unsigned long long writes;
+};
+
+static FILE* report_output = NULL;
+static const char* heatmap_path = NULL;
+static struct htable files;   // path -> struct file_map*
+
+//*****************************************************************************
+
+void working_set_init(FILE* output, const char* path)
+{
+   report_output = output;
+   heatmap_path = path;
+   htable_init(&files);
+}
+
+//*****************************************************************************
+
+static struct file_map* get_file(const char* path)
+{
+   struct file_map* file = htable_get_str(&files, path);
+
+   if (file == NULL) {
+      file = calloc(1, sizeof(struct file_map));
+      file->path = strdup(path);
+      htable_init(&file->cells);
+      htable_put_str(&files, path, file);
+   }
+   return file;
+}
+
+//*****************************************************************************
+
+static struct heat_cell* get_cell(struct file_map* file, long long window,
+                                  long long region)
+{
+   struct heat_key key;
+   struct heat_cell* cell;
+
+   memset(&key, 0, sizeof(key));
+   key.window = window;
+   key.region = region;
+   cell = htable_get(&file->cells, &key, sizeof(key));
+   if (cell == NULL) {
+      cell = calloc(1, sizeof(struct heat_cell));
+      htable_put(&file->cells, &key, sizeof(key), cell);
+   }
+   return cell;
+}
+
+//*****************************************************************************
+
+// 0 if the state of block is tracked
+static int reserve_block(struct file_map* file, long long block)
+{
+   long long num_blocks;
+
+   if (block >= MAX_BLOCKS) {
+      return -1;
+   }
+   if (block >= file->num_blocks) {
+      num_blocks = file->num_blocks ? file->num_blocks : 64;
+      while (num_blocks <= block) {
+         num_blocks *= 2;
+      }
+      file->last_window = realloc(file->last_window, num_blocks * sizeof(int));
+      memset(file->last_window + file->num_blocks, 0,
+             (num_blocks - file->num_blocks) * sizeof(int));
+      file->read_bits = realloc(file->read_bits, num_blocks / 8);
+      memset(file->read_bits + file->num_blocks / 8, 0, (num_blocks - file->num_blocks) / 8);
+      file->num_blocks = num_blocks;
+   }
+   return 0;
+}
+
+//*****************************************************************************
+
+void working_set_record(const struct process_info* process,
+                        const struct monitor_record_t* r)
+{
+   const int is_read = (r->dom_type == FILE_READ);
+   struct file_map* file;
+   struct heat_cell* cell = NULL;
+   long long region = -1;
+   long long window;
+   long long block;
+   long long last_block;
+   const char* path;
+
+   if (report_output == NULL && heatmap_path == NULL) {
+      return;
+   }
+   if ((r->dom_type != FILE_READ && r->dom_type != FILE_WRITE) ||
+       r->offset < 0 || r->bytes_transferred == 0 || r->error_code != 0) {
+      return;
+   }
+   path = record_path(process, r);
+   if (path == NULL) {
+      return;
+   }
+
+   file = get_file(path);
+   window = r->start_usec / 1000000LL / WINDOW_SECS;
+   last_block = (r->offset + (long long) r->bytes_transferred - 1) / BLOCK_SIZE;
+
+   for (block = r->offset / BLOCK_SIZE; block <= last_block; ++block) {
+      if (block * BLOCK_SIZE / HEATMAP_REGION_SIZE != region) {
+         region = block * BLOCK_SIZE / HEATMAP_REGION_SIZE;
+         cell = get_cell(file, window, region);
+      }
+      if (is_read) {
+         file->block_reads++;
+         cell->reads++;
+      } else {
+         file->block_writes++;
+         cell->writes++;
+      }
+      if (reserve_block(file, block) != 0) {
+         continue;
+      }
+
+      if (file->last_window[block] == 0) {
+         file->unique_blocks++;
+      }
+      if (file->last_window[block] != window + 1) {
+         file->last_window[block] = window + 1;
+         cell->unique_blocks++;
+      }
+      if (is_read) {
+         if (file->read_bits[block / 8] & (1 << (block % 8))) {
+            file->block_rereads++;
+         } else {
+            file->read_bits[block / 8] |= 1 << (block % 8);
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+
+struct report_context {
+   struct file_map* file;
+   struct htable* windows;     // window -> struct window_totals* (all files)
+   struct htable file_windows; // window -> unique blocks of this file
+   FILE* csv;
+};
+
+static void add_cell(const void* key, size_t key_len, void* value, void* ctx)
+{
+   const struct heat_key* heat_key = key;
+   const struct heat_cell* cell = value;
+   struct report_context* context = ctx;
+   struct window_totals* totals;
+   unsigned long long* file_blocks;
+
+   totals = htable_get_int(context->windows, heat_key->window);
+   if (totals == NULL) {
+      totals = calloc(1, sizeof(struct window_totals));
+      totals->window = heat_key->window;
+      htable_put_int(context->windows, heat_key->window, totals);
+   }
+   totals->unique_blocks += cell->unique_blocks;
+   totals->reads += cell->reads;
+   totals->writes += cell->writes;
+
+   file_blocks = htable_get_int(&context->file_windows, heat_key->window);
+   if (file_blocks == NULL) {
+      file_blocks = calloc(1, sizeof(*file_blocks));
+      htable_put_int(&context->file_windows, heat_key->window, file_blocks);
+   }
+   *file_blocks += cell->unique_blocks;
+   if (*file_blocks > context->file->peak_window_blocks) {
+      context->file->peak_window_blocks = *file_blocks;
+   }
+
+   if (context->csv != NULL) {
+      fprintf(context->csv, "\"%s\",%lld,%lld,%llu,%llu,%llu\n",
+              context->file->path, heat_key->window * WINDOW_SECS,
+              heat_key->region * HEATMAP_REGION_SIZE,
+              cell->reads * BLOCK_SIZE, cell->writes * BLOCK_SIZE,
+              cell->unique_blocks * BLOCK_SIZE);
+   }
+}
+
+static void add_file(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct report_context* context = ctx;
+
+   context->file = value;
+   htable_init(&context->file_windows);
+   htable_foreach(&context->file->cells, add_cell, context);
+   htable_destroy(&context->file_windows, free);
+}
+
+//*****************************************************************************
+
+struct collect_cursor {
+   void** items;
+   size_t count;
+};
+
+static void collect(const void* key, size_t key_len, void* value, void* ctx)
+{
+   struct collect_cursor* cursor = ctx;
+
+   cursor->items[cursor->count++] = value;
+}
+
+static int compare_windows(const void* a, const void* b)
+{
+   const struct window_totals* wa = *(struct window_totals* const*) a;
+   const struct window_totals* wb = *(struct window_totals* const*) b;
+
+   return (wa->window > wb->window) - (wa->window < wb->window);
+}
+
+static int compare_files(const void* a, const void* b)
+{
+   const struct file_map* fa = *(struct file_map* const*) a;
+   const struct file_map* fb = *(struct file_map* const*) b;
+
+   return (fa->unique_blocks < fb->unique_blocks) - (fa->unique_blocks > fb->unique_blocks);
+}
+
+//*****************************************************************************
+
+static void free_file(void* value)
+{
+   struct file_map* file = value;
+
+   free(file->last_window);
+   free(file->read_bits);
+   htable_destroy(&file->cells, free);
+   free(file->path);
+   free(file);
+}
+
+//*****************************************************************************
+
+static void print_report(struct htable* windows)
+{
+   struct collect_cursor cursor;
+   struct histogram window_bytes;
+   unsigned long long total_blocks = 0;
+   unsigned long long total_reads = 0;
+   unsigned long long total_rereads = 0;
+   const struct window_totals* peak = NULL;
+   char peak_time[32] = "-";
+   size_t i;
+
+   memset(&window_bytes, 0, sizeof(window_bytes));
+   cursor.items = malloc((windows->count + 1) * sizeof(void*));
+   cursor.count = 0;
+   htable_foreach(windows, collect, &cursor);
+   qsort(cursor.items, cursor.count, sizeof(void*), compare_windows);
+   for (i = 0; i < cursor.count; ++i) {
+      const struct window_totals* totals = cursor.items[i];
+      histogram_add(&window_bytes, totals->unique_blocks * BLOCK_SIZE);
+      if (peak == NULL || totals->unique_blocks > peak->unique_blocks) {
+         peak = totals;
+      }
+   }
+   if (peak != NULL) {
+      const time_t start = peak->window * WINDOW_SECS;
+      strftime(peak_time, sizeof(peak_time), "%Y-%m-%d %H:%M:%S", localtime(&start));
+   }
+   free(cursor.items);
+
+   cursor.items = malloc((files.count + 1) * sizeof(void*));
+   cursor.count = 0;
+   htable_foreach(&files, collect, &cursor);
+   qsort(cursor.items, cursor.count, sizeof(void*), compare_files);
+   for (i = 0; i < cursor.count; ++i) {
+      const struct file_map* file = cursor.items[i];
+      total_blocks += file->unique_blocks;
+      total_reads += file->block_reads;
+      total_rereads += file->block_rereads;
+   }
+
+   fprintf(report_output, "\n===== working set (%lld byte blocks, %lld s windows)\n",
+           BLOCK_SIZE, WINDOW_SECS);
+   fprintf(report_output, "  unique bytes touched  %llu\n", total_blocks * BLOCK_SIZE);
+   fprintf(report_output, "  windows               %zu\n", windows->count);
+   fprintf(report_output, "  working set mean      %.0f\n",
+           window_bytes.count > 0 ? window_bytes.sum / window_bytes.count : 0.0);
+   fprintf(report_output, "  working set p95       %.0f\n",
+           histogram_percentile(&window_bytes, 95.0));
+   fprintf(report_output, "  working set peak      %llu (window starting %s)\n",
+           peak != NULL ? peak->unique_blocks * BLOCK_SIZE : 0ULL, peak_time);
+   fprintf(report_output, "  re-read ratio         %.1f%%\n",
+           total_reads > 0 ? 100.0 * total_rereads / total_reads : 0.0);
+
+   fprintf(report_output, "\n  %14s %14s %14s %8s %14s  %s\n",
+           "UNIQUE BYTES", "READ BYTES", "WRITE BYTES", "RE-READ%", "PEAK WINDOW", "PATH");
+   for (i = 0; i < cursor.count && i < TOP_FILES; ++i) {
+      const struct file_map* file = cursor.items[i];
+      fprintf(report_output, "  %14llu %14llu %14llu %8.1f %14llu  %s\n",
+              file->unique_blocks * BLOCK_SIZE, file->block_reads * BLOCK_SIZE,
+              file->block_writes * BLOCK_SIZE,
+              file->block_reads > 0 ? 100.0 * file->block_rereads / file->block_reads : 0.0,
+              file->peak_window_blocks * BLOCK_SIZE, file->path);
+   }
+   fflush(report_output);
+   free(cursor.items);
+}
+
+//*****************************************************************************
+
+void working_set_report()
+{
+   struct report_context context;
+   struct htable windows;
+
+   if (report_output == NULL && heatmap_path == NULL) {
+      return;
+   }
+
+   memset(&context, 0, sizeof(context));
+   htable_init(&windows);
+   context.windows = &windows;
+   if (heatmap_path != NULL) {
+      context.csv = fopen(heatmap_path, "w");
+      if (context.csv == NULL) {
+         printf("error: unable to write heatmap to '%s'\n", heatmap_path);
+      } else {
+         fprintf(context.csv, "path,window_start,offset,read_bytes,write_bytes,unique_bytes\n");
+      }
+   }
+
+   htable_foreach(&files, add_file, &context);
+   if (context.csv != NULL) {
+      fclose(context.csv);
+   }
+   if (report_output != NULL) {
+      print_report(&windows);
+   }
+
+   htable_destroy(&windows, free);
+   htable_destroy(&files, free_file);
+}
+
+//*****************************************************************************
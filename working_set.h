@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __WORKING_SET_H
+#define __WORKING_SET_H
+#include <stdio.h>
+#include "monitor_record.h"
+#include "process_table.h"
+
+// per-file block access map built from reads and writes at known offsets
+// (4 KiB blocks, the page cache granularity). from it:
+//   - the working set: unique bytes touched per time window
+//   - the re-read ratio: block reads of blocks that were read before
+//   - an offset heatmap over time, exported as CSV for plotting
+// the maps are kept per path across processes, as the page cache is.
+
+void working_set_init(FILE* report_output, const char* heatmap_path);
+void working_set_record(const struct process_info* process,
+                        const struct monitor_record_t* monitor_record);
+void working_set_report();
+
+#endif //__WORKING_SET_H